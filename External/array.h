@@ -118,6 +118,8 @@ public:
     Value_T         Norm      () const;                            ///< Calculate the norm value (Value_T must have addition operators)
     void            SetValues (Value_T const & V);                 ///< Set all values to be equal to V
     void            Clear     () { Resize(0); }                    ///< Clear array
+    void            Reset     ();                                  ///< Clear array keeping its memory (buffers refilled with Push)
+    void            Reserve   (size_t Space);                      ///< Make room for Space values keeping the current ones (never shrinks)
     void            DelItem   (size_t i);                          ///< Delete item i from array (not efficient)
     void            DelItems  (Array<int> const & Idxs);           ///< Delete items from array (not efficient)
     void            DelVal    (Value_T const & Value);             ///< Delete Value from array (not efficient)
@@ -556,6 +558,31 @@ inline void Array<Value_T>::Resize (size_t Size)
 #endif
 }
 
+template<typename Value_T>
+inline void Array<Value_T>::Reset ()
+{
+#ifdef USE_STDVECTOR
+    std::vector<Value_T>::clear ();
+#else
+    _size = 0;
+#endif
+}
+
+template<typename Value_T>
+inline void Array<Value_T>::Reserve (size_t Space)
+{
+#ifdef USE_STDVECTOR
+    std::vector<Value_T>::reserve (Space);
+#else
+    if (Space<=_space) return;
+    Value_T * tmp = new Value_T [Space];
+    for (size_t i=0; i<_size; ++i) tmp[i] = _values[i];
+    if (_values!=NULL) delete [] _values;
+    _values = tmp;
+    _space  = Space;
+#endif
+}
+
 template<typename Value_T>
 inline void Array<Value_T>::Push (Value_T const & Value)
 {
@@ -2039,4 +2039,103 @@ void ToFlatAntiSymNullDiagPtr(const Mat3_t &m_data, double *flat, int initial){
   flat [initial + 2] = m_data(0,2);
 }
 
+////// SYMMETRIC AND ANTISYMMETRIC 3x3 TENSORS, STORED FLAT
+////// Sym3_t:  6 components, same order as ToFlatSym (00,11,22,01,12,02)
+////// Skew3_t: 3 components, same order as ToFlatSymNullDiag (01,12,02)
+////// (i,j) access keeps the Mat3_t syntax for element operations
+static const int SYM3_IDX[3][3] = {{0,3,5},{3,1,4},{5,4,2}};
+
+class Sym3_t {
+public:
+  double d[6];
+  
+  Sym3_t(){}
+  explicit Sym3_t(const double &v)  { for (int k=0;k<6;k++) d[k] = v; }
+  explicit Sym3_t(const Mat3_t &m)  { ToFlatSym(m,d); } //Symmetric part is assumed
+  Sym3_t(const double &xx, const double &yy, const double &zz, const double &xy, const double &yz, const double &xz){
+    d[0] = xx; d[1] = yy; d[2] = zz; d[3] = xy; d[4] = yz; d[5] = xz;
+  }
+  
+  Sym3_t & operator= (const double &v)  { for (int k=0;k<6;k++) d[k] = v; return *this; }
+  Sym3_t & operator= (const Mat3_t &m)  { ToFlatSym(m,d); return *this; }
+  
+  inline double &       operator()(const int &i, const int &j)       { return d[SYM3_IDX[i][j]]; }
+  inline const double & operator()(const int &i, const int &j) const { return d[SYM3_IDX[i][j]]; }
+  
+  inline Sym3_t & operator+= (const Sym3_t &b)  { for (int k=0;k<6;k++) d[k] += b.d[k]; return *this; }
+  inline Sym3_t & operator-= (const Sym3_t &b)  { for (int k=0;k<6;k++) d[k] -= b.d[k]; return *this; }
+  inline Sym3_t & operator*= (const double &f)  { for (int k=0;k<6;k++) d[k] *= f;      return *this; }
+  
+  inline double Trace() const { return d[0] + d[1] + d[2]; }
+  inline Mat3_t ToMat() const { return FromFlatSym(const_cast<double*>(d)); }
+};
+
+class Skew3_t {
+public:
+  double d[3];
+  
+  Skew3_t(){}
+  explicit Skew3_t(const double &v) { d[0] = d[1] = d[2] = v; }
+  explicit Skew3_t(const Mat3_t &m) { ToFlatSymNullDiag(m,d); } //Upper part
+  Skew3_t(const double &xy, const double &yz, const double &xz){ d[0] = xy; d[1] = yz; d[2] = xz; }
+  
+  Skew3_t & operator= (const double &v) { d[0] = d[1] = d[2] = v; return *this; }
+  Skew3_t & operator= (const Mat3_t &m) { ToFlatSymNullDiag(m,d); return *this; }
+  
+  //Read only, lower components are the negated upper ones
+  inline double operator()(const int &i, const int &j) const {
+    if      (i < j) return  d[SYM3_IDX[i][j]-3];
+    else if (i > j) return -d[SYM3_IDX[i][j]-3];
+    return 0.;
+  }
+  
+  inline Skew3_t & operator+= (const Skew3_t &b) { for (int k=0;k<3;k++) d[k] += b.d[k]; return *this; }
+  inline Skew3_t & operator-= (const Skew3_t &b) { for (int k=0;k<3;k++) d[k] -= b.d[k]; return *this; }
+  inline Skew3_t & operator*= (const double &f)  { for (int k=0;k<3;k++) d[k] *= f;      return *this; }
+  
+  inline Mat3_t ToMat() const { return FromFlatAntiSymNullDiag(const_cast<double*>(d)); }
+};
+
+inline Sym3_t operator+ (const Sym3_t &a, const Sym3_t &b) { Sym3_t r; for (int k=0;k<6;k++) r.d[k] = a.d[k] + b.d[k]; return r; }
+inline Sym3_t operator- (const Sym3_t &a, const Sym3_t &b) { Sym3_t r; for (int k=0;k<6;k++) r.d[k] = a.d[k] - b.d[k]; return r; }
+inline Sym3_t operator- (const Sym3_t &a)                  { Sym3_t r; for (int k=0;k<6;k++) r.d[k] = -a.d[k];         return r; }
+inline Sym3_t operator* (const double &f, const Sym3_t &a) { Sym3_t r; for (int k=0;k<6;k++) r.d[k] = f*a.d[k];        return r; }
+inline Sym3_t operator* (const Sym3_t &a, const double &f) { return f*a; }
+
+inline Skew3_t operator+ (const Skew3_t &a, const Skew3_t &b) { return Skew3_t(a.d[0]+b.d[0], a.d[1]+b.d[1], a.d[2]+b.d[2]); }
+inline Skew3_t operator- (const Skew3_t &a, const Skew3_t &b) { return Skew3_t(a.d[0]-b.d[0], a.d[1]-b.d[1], a.d[2]-b.d[2]); }
+inline Skew3_t operator- (const Skew3_t &a)                   { return Skew3_t(-a.d[0], -a.d[1], -a.d[2]); }
+inline Skew3_t operator* (const double &f, const Skew3_t &a)  { return Skew3_t(f*a.d[0], f*a.d[1], f*a.d[2]); }
+inline Skew3_t operator* (const Skew3_t &a, const double &f)  { return f*a; }
+
+inline void set_to_zero (Sym3_t  & S) { S = 0.; }
+inline void set_to_zero (Skew3_t & W) { W = 0.; }
+
+/** s * I */
+inline Sym3_t SymIdentity (const double &s = 1.0) { return Sym3_t(s,s,s,0.,0.,0.); }
+
+/** Deviatoric part, A - 1/3 tr(A) I */
+inline Sym3_t Deviator (const Sym3_t &A) {
+  double p = A.Trace()/3.0;
+  return Sym3_t(A.d[0]-p, A.d[1]-p, A.d[2]-p, A.d[3], A.d[4], A.d[5]);
+}
+
+/** Double contraction A:B */
+inline double DoubleDot (const Sym3_t &A, const Sym3_t &B) {
+  return  A.d[0]*B.d[0] + A.d[1]*B.d[1] + A.d[2]*B.d[2] + 
+          2.0*(A.d[3]*B.d[3] + A.d[4]*B.d[4] + A.d[5]*B.d[5]);
+}
+
+/** Jaumann rate terms S.W^T + W.S (symmetric, since W is antisymmetric) */
+inline Sym3_t Jaumann (const Sym3_t &S, const Skew3_t &W) {
+  Sym3_t r;
+  for (int i=0;i<3;i++)
+    for (int j=i;j<3;j++){
+      double v = 0.;
+      for (int k=0;k<3;k++) v += W(i,k)*S(k,j) + W(j,k)*S(k,i);
+      r(i,j) = v;
+    }
+  return r;
+}
+
 #endif // MECHSYS_MATVEC_H
@@ -50,6 +50,7 @@ ADD_DEFINITIONS(-fpermissive)       # New C++ standard
 
 INCLUDE      ($ENV{SPH}/Modules/FindHDF5.cmake)
 INCLUDE      (FindOpenMP)
+INCLUDE      (FindThreads)
 INCLUDE      (FindLAPACK)
 
 set(GSL_GLOB_PATH ${CMAKE_ROOT}/Modules)
@@ -78,6 +79,8 @@ else(OPENMP_FOUND)
         SET (MISSING "${MISSING} OpenMP")
 endif(OPENMP_FOUND)
 
+SET (LIBS ${LIBS} ${CMAKE_THREAD_LIBS_INIT}) # Output writer thread
+
 
 # if(LAPACK_FOUND)
     # SET (LIBS ${LIBS} ${LAPACK_LIBRARIES})
@@ -37,21 +37,66 @@ void Domain::AddTrimeshParticles(TriMesh *mesh, const float &hfac, const int &id
   meshcount++;
 }
 
+inline void Domain::UpdateContactParticle(const int &m, const int &e){
+  Vec3_t v = 0.;
+  for (int en = 0;en<trimesh[m]->dimension;en++)
+    v += *trimesh[m] -> node_v[trimesh[m]->element[e] ->node[en]];
+  Particle *P = Particles[first_fem_particle_idx[m] + e];
+  P -> v = P -> va = P -> vb = v/trimesh[m]->dimension;
+  P -> a = 0.; 
+  P -> normal  = trimesh[m]->element[e] -> normal;
+  if (trimesh[m]->rigid_frame)
+    P -> x = trimesh[m]->element[e] -> centroid;
+}
+
 //PARTICLES POSITIONS IS USED IN MOVE!
+//Rigid frame meshes searched with bvh_contact are left to UpdateContactPairElements, with SDF they are not used
 inline void Domain::UpdateContactParticles(){
   for (int m=0; m<trimesh.size();m++){
-    for ( int e = 0; e < trimesh[m]->element.Size(); e++ ){
-      Vec3_t v = 0.;
-      for (int en = 0;en<trimesh[m]->dimension;en++)
-        v += *trimesh[m] -> node_v[trimesh[m]->element[e] ->node[en]];
-      Particles[first_fem_particle_idx[m] + e] -> v = 
-      Particles[first_fem_particle_idx[m] + e] -> va = 
-      Particles[first_fem_particle_idx[m] + e] -> vb = v/trimesh[m]->dimension;
-      Particles[first_fem_particle_idx[m] + e] -> a = 0.; 
-      Particles[first_fem_particle_idx[m] + e] -> normal  = trimesh[m]->element[e] -> normal;
-      //cout << "v "<< v/3.<<", n "<<Particles[first_fem_particle_idx + e] -> normal<<endl;
-    } 
+    if (trimesh[m]->rigid_frame){
+      if (bvh_contact || contact_alg == SDF) continue;
+      trimesh[m]->TouchAll();
+    }
+    for ( int e = 0; e < trimesh[m]->element.Size(); e++ )
+      UpdateContactParticle(m, e);
+  }
+}
+
+//Serial since elements share nodes, the cost is the contact pair count
+inline void Domain::UpdateContactPairElements(){
+  for (int k=0; k<Nproc;k++)
+    for (size_t a = 0; a < ContPairs[k].Size();a++) {
+      Particle *P = Particles[ContPairs[k][a].second]; //Contact particle (ContactBVHSearch order)
+      int m = P->mesh;
+      if (trimesh[m]->rigid_frame && trimesh[m]->TouchElement(P->element))
+        UpdateContactParticle(m, P->element);
+    }
+}
+
+inline void Domain::ZeroContactAccum(){
+  if (cacc.size() < Nproc) cacc.resize(Nproc);
+  for (int k=0; k<Nproc;k++) cacc[k].Zero(meshcount);
+}
+
+//Totals of the current step
+inline void Domain::MergeContactAccum(){
+  contact_force_sum = contact_reaction_sum = ext_forces_work_step = 0.;
+  double min_ts = 1000.;
+  for (int m=0;m<meshcount;m++) {
+    m_contact_force[m] = 0.;
+    tot_cont_heat_cond[m] = 0.;
+  }
+  for (int k=0; k<Nproc;k++) {
+    contact_force_sum     += cacc[k].force_sum;
+    contact_reaction_sum  += cacc[k].reaction_sum;
+    ext_forces_work_step  += cacc[k].work;
+    if (cacc[k].min_ts < min_ts) min_ts = cacc[k].min_ts;
+    for (int m=0;m<meshcount;m++) {
+      m_contact_force[m]    += cacc[k].mesh_force[m];
+      tot_cont_heat_cond[m] += cacc[k].heat_cond[m];
+    }
   }
+  if (min_ts < 1000.) min_force_ts = min_ts;
 }
 
 inline void Domain::ContactNbSearch(){
@@ -123,12 +168,142 @@ inline void Domain::ContactNbSearch(){
   
   	#pragma omp parallel for schedule (dynamic) num_threads(Nproc)
     for (int i=0 ; i<Nproc ; i++)  //In the original version this was calculated after
-		RIGPairs[i].Clear();
+		RIGPairs[i].Reset(); //Memory kept for the next search
     
 	// cout << "Contact Pairs Count"<<endl;
 	// for (int k=0; k<Nproc;k++) 
 		// cout << ContPairs[k].Size()<<", ";
 	 // cout <<endl;
+  BuildContactCandidates();
+}
+
+//Contact pairs without contact particles in the cell grid: each free surface particle
+//queries the element hierarchy of every mesh, so the cost follows the surface particle
+//count and not the mesh density. Pairs are the same the grid gives (ContactNbSearch)
+inline void Domain::ContactBVHSearch(){
+  if (meshcount == 0) return;
+  for (int m=0;m<meshcount;m++){
+    if (trimesh[m]->bvh == NULL) { //Boxes grown by the contact particle radius
+      std::vector <double> pad(trimesh[m]->element.Size());
+      for (int e=0;e<pad.size();e++)
+        pad[e] = Particles[first_fem_particle_idx[m] + e]->h;
+      trimesh[m]->BuildBVH(pad);
+    }
+  }
+  size_t nsolid = first_fem_particle_idx[0];
+  size_t chunk = (nsolid + Nproc - 1) / Nproc;
+  
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	#ifdef __GNUC__
+	for (size_t k=0; k<Nproc;k++) 
+	#else
+	for (int k=0; k<Nproc;k++) 
+	#endif	
+	{
+    std::vector <int> found;
+    ContPairs[k].Reset();
+    size_t end = std::min(nsolid, (k+1)*chunk);
+    for (size_t i=k*chunk; i<end; i++){
+      if (Particles[i]->ID != id_free_surf) continue;
+      for (int m=0;m<meshcount;m++){
+        found.clear();
+        if (trimesh[m]->rigid_frame) { //Query and distance in the body frame, mesh is not moved
+          Vec3_t x0;
+          trimesh[m]->ToBody(Particles[i]->x, x0);
+          trimesh[m]->bvh->Query(x0, Particles[i]->h, found);
+          for (size_t f=0;f<found.size();f++){
+            size_t j = first_fem_particle_idx[m] + found[f];
+            if ( norm (x0 - trimesh[m]->centroid0[found[f]]) < ( Particles[i]->h + Particles[j]->h ) )
+              ContPairs[k].Push(std::make_pair(i, j));
+          }
+        } else {
+          trimesh[m]->bvh->Query(Particles[i]->x, Particles[i]->h, found);
+          for (size_t f=0;f<found.size();f++){
+            size_t j = first_fem_particle_idx[m] + found[f];
+            if ( norm (Particles[i]->x - Particles[j]->x) < ( Particles[i]->h + Particles[j]->h ) )
+              ContPairs[k].Push(std::make_pair(i, j));
+          }
+        }
+      }
+    }
+  }
+  
+  cont_pairs = 0;
+  for (int k=0; k<Nproc;k++) cont_pairs += ContPairs[k].Size();
+  
+  UpdateContactPairElements();
+  BuildContactCandidates();
+}
+
+//Contact pairs grouped by SPH particle: cont_part holds each particle once and its candidate
+//contact (element) particles are cont_elem[cont_elem_start[c] ... cont_elem_start[c+1]-1].
+//Pairs are sorted, so the candidate order does not depend on the thread pair lists
+inline void Domain::BuildContactCandidates(){
+  std::vector <std::pair<int,int> > pairs;
+  pairs.reserve(cont_pairs);
+  for (int k=0; k<Nproc;k++)
+    for (size_t a = 0; a < ContPairs[k].Size();a++) {
+      int P1 = ContPairs[k][a].first, P2 = ContPairs[k][a].second;
+      bool is_first = false;
+      for (int m=0;m<meshcount;m++)
+        if (Particles[P1]->ID == contact_surf_id[m]) is_first = true;
+      if (is_first) pairs.push_back(std::make_pair(P2, P1)); //P1 is SPH particle
+      else          pairs.push_back(std::make_pair(P1, P2));
+    }
+  std::sort(pairs.begin(), pairs.end());
+  
+  cont_part.clear();
+  cont_elem.resize(pairs.size());
+  cont_elem_start.clear();
+  for (size_t a = 0; a < pairs.size();a++){
+    if (a == 0 || pairs[a].first != pairs[a-1].first) {
+      cont_part.push_back(pairs[a].first);
+      cont_elem_start.push_back(a);
+    }
+    cont_elem[a] = pairs[a].second;
+  }
+  cont_elem_start.push_back(pairs.size());
+}
+
+//Fraser 3-147, qj is the projection of the SPH particle on the element plane
+inline bool Domain::InsideContactElement(const int &P2, const Vec3_t &qj){
+  int m = Particles[P2]->mesh;
+  Element *e = trimesh[m]-> element[Particles[P2]->element];
+  int nn = trimesh[m]->dimension;
+  for (int i=0;i<nn;i++){
+    int j = i+1;	if (j>nn-1) j = 0;
+    double crit;
+    if (nn == 3)
+      crit = dot (cross ( *trimesh[m]->node[e -> node[j]] - *trimesh[m]->node[e -> node[i]],
+                          qj  - *trimesh[m]->node[e -> node[i]]),
+                  Particles[P2]->normal);
+    else //MESH DIMENSION = 2
+      crit = dot ( *trimesh[m]->node[e -> node[j]] - *trimesh[m]->node[e -> node[i]],
+                   qj  - *trimesh[m]->node[e -> node[i]]);
+    if (crit < 0.0) return false;
+  }
+  return true;
+}
+
+//Active element of contact candidate c on mesh m: among the candidates of that mesh closer than h
+//to the element plane (at the predicted position) and whose projection is inside the element, the
+//closest one. Returns its contact particle and plane distance, or -1 if not in contact with mesh m
+inline int Domain::ActiveContactElement(const int &c, const int &m, const Vec3_t &x_pred, double &dist){
+  int P1 = cont_part[c];
+  int act = -1;
+  for (int a = cont_elem_start[c]; a < cont_elem_start[c+1]; a++){
+    int P2 = cont_elem[a];
+    if (Particles[P2]->mesh != m) continue;
+    double d = dot (Particles[P2]->normal, x_pred ) - trimesh[m]-> element[Particles[P2]->element] -> pplane;
+    if (d >= Particles[P1]->h) continue;
+    if (act >= 0 && fabs(d) >= fabs(dist)) continue;
+    Vec3_t qj = Particles[P1]->x - d * Particles[P2]->normal;
+    if (InsideContactElement(P2, qj)) {
+      act = P2;
+      dist = d;
+    }
+  }
+  return act;
 }
 
 inline void Domain::CalcContactInitialGap(){
@@ -279,7 +454,7 @@ inline void Domain::CalcContactForces(){
   double normal_cf;
   Vec3_t atg;
   bool end;
-  contact_force_sum = 0.;
+  ZeroContactAccum();
   double delta;
   Vec3_t delta_tg;
   int max_reached_part = 0; //TEST
@@ -432,9 +607,7 @@ inline void Domain::CalcContactForces(){
             Particles[P1] -> delta_cont = delta;
 						omp_unset_lock(&Particles[P1]->my_lock);
 
-            omp_set_lock(&dom_lock);            
-              contact_force_sum += norm(Particles[P1] ->contforce);
-            omp_unset_lock(&dom_lock);	
+            cacc[k].force_sum += norm(Particles[P1] ->contforce);
             
 						force2 = dot(Particles[P1] -> contforce,Particles[P1] -> contforce);
 						
@@ -453,11 +626,7 @@ inline void Domain::CalcContactForces(){
 							// Particles[P1] -> contforce = 1.e5;
 						dt_fext = contact_force_factor * (Particles[P1]->Mass * 2. * norm(Particles[P1]->v) / norm (Particles[P1] -> contforce));
 
-						if (dt_fext < min_force_ts_){
-							min_force_ts_ = dt_fext;
-							if (dt_fext > 0)
-								this -> min_force_ts = min_force_ts_;
-						}
+						cacc[k].MinTS(dt_fext);
             //Acceleration is summed up on integration
 						// omp_set_lock(&Particles[P1]->my_lock);
 						// Particles[P1] -> a += Particles[P1] -> contforce / Particles[P1] -> Mass; 
@@ -526,6 +695,7 @@ inline void Domain::CalcContactForces(){
         // end=true;
     }//Contact Pairs
 	}//Nproc
+  MergeContactAccum();
   //cout << "END CONTACT----------------------"<<endl;
 	max_contact_force = sqrt (max_contact_force);
   //cout << "contact_force_sum "<<contact_force_sum<<endl;
@@ -616,7 +786,7 @@ inline void Domain::CalcContactForces2(){
  
   Vec3_t atg;
   bool end;
-  contact_force_sum = 0.;
+  ZeroContactAccum();
   double dist;
   int max_reached_part = 0; //TEST
   int sta_frict_particles = 0;
@@ -710,9 +880,7 @@ inline void Domain::CalcContactForces2(){
             Particles[P1] -> delta_cont = delta;
 						omp_unset_lock(&Particles[P1]->my_lock);
 
-            omp_set_lock(&dom_lock);            
-              contact_force_sum += norm(Particles[P1] ->contforce);
-            omp_unset_lock(&dom_lock);	
+            cacc[k].force_sum += norm(Particles[P1] ->contforce);
             //inside_pairs++;
 						
 						// TANGENTIAL COMPONENNT DIRECTION
@@ -728,11 +896,7 @@ inline void Domain::CalcContactForces2(){
 
 						dt_fext = contact_force_factor * (Particles[P1]->Mass * 2. * norm(Particles[P1]->v) / norm (Particles[P1] -> contforce));
 
-						if (dt_fext < min_force_ts_){
-							min_force_ts_ = dt_fext;
-							if (dt_fext > 0)
-								this -> min_force_ts = min_force_ts_;
-						}
+						cacc[k].MinTS(dt_fext);
 						// omp_set_lock(&Particles[P1]->my_lock);
 						// Particles[P1] -> a += Particles[P1] -> contforce / Particles[P1] -> Mass; 
 						// omp_unset_lock(&Particles[P1]->my_lock);
@@ -778,6 +942,7 @@ inline void Domain::CalcContactForces2(){
         } //If distance is less than h
     }//Contact Pairs
 	}//Nproc
+  MergeContactAccum();
   //cout << "END CONTACT----------------------"<<endl;
 	max_contact_force = sqrt (max_contact_force);
 	//min_contact_force = sqrt (min_contact_force);
@@ -951,3 +1116,4 @@ inline void Domain::CalcContactForcesAnalytic(){
 }; //SPH
 
 #include "Contact_Wang.cpp"
+#include "Contact_SDF.cpp"
@@ -0,0 +1,213 @@
+#ifndef _CONTACT_SDF_H_
+#define _CONTACT_SDF_H_
+
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <iostream>
+
+namespace SPH{
+
+//////////////////////////////////////////////////////////////////////////////
+// Signed distance field of a rigid tool, in the tool body frame (see        //
+// TriMesh::SetRigidFrame). Sample gives distance and outer normal in O(1):  //
+// analytic for planar meshes and cylinders, otherwise trilinear in a        //
+// sparse grid of SDF_BLOCK^3 node blocks, allocated only within band of the //
+// surface. Outside the band Sample returns false (no contact).              //
+//////////////////////////////////////////////////////////////////////////////
+#define SDF_BLOCK 8
+
+enum SDF_Type { SDF_Grid=0, SDF_Plane, SDF_Cylinder };
+
+class SignedDistField{
+public:
+  SDF_Type  type;
+  int       dim;              //2: field in the xy plane
+  //Analytic
+  Vec3_t    p, axis;          //Plane: point and outer normal; Cylinder: point on axis and axis direction
+  double    radius;           //Cylinder
+  double    zmin, zmax;       //Cylinder: end faces, axial coordinates from p
+  Vec3_t    bmin, bmax;       //Plane: mesh extent
+  //Sparse grid
+  Vec3_t    origin;
+  double    cell, band;
+  int       nn[3], nb[3];     //Nodes and blocks per direction
+  std::vector <int>   block;  //[nb] first value of each block, -1 if not allocated
+  std::vector <float> val;
+
+  SignedDistField():type(SDF_Grid),dim(3),radius(0.),zmin(0.),zmax(0.),cell(0.),band(0.){}
+
+  inline void SetPlane(const Vec3_t &p_, const Vec3_t &n, const Vec3_t &bmin_, const Vec3_t &bmax_){
+    type = SDF_Plane; p = p_; axis = n/norm(n); bmin = bmin_; bmax = bmax_;
+  }
+  //Capped cylinder, zmin and zmax are the end faces along the axis measured from p
+  inline void SetCylinder(const Vec3_t &p_, const Vec3_t &ax, const double &r, const double &zmin_, const double &zmax_){
+    type = SDF_Cylinder; p = p_; axis = ax/norm(ax); radius = r; zmin = zmin_; zmax = zmax_;
+  }
+
+  //Mesh nodes and normals are taken from the body frame (node0, normal0)
+  inline void BuildGrid(const TriMesh &mesh, const double &cell_, const double &band_){
+    type = SDF_Grid; dim = mesh.dimension;
+    cell = cell_; band = band_;
+    Vec3_t xmin = mesh.node0[0], xmax = xmin;
+    for (size_t n=1;n<mesh.node0.size();n++)
+      for (int d=0;d<3;d++){
+        if (mesh.node0[n](d) < xmin(d)) xmin(d) = mesh.node0[n](d);
+        if (mesh.node0[n](d) > xmax(d)) xmax(d) = mesh.node0[n](d);
+      }
+    for (int d=0;d<3;d++){
+      origin(d) = xmin(d) - band - cell;
+      nn[d] = int(ceil((xmax(d) - xmin(d) + 2.*(band+cell))/cell)) + 1;
+    }
+    if (dim == 2) { origin(2) = 0.; nn[2] = 1; }
+    for (int d=0;d<3;d++) nb[d] = (nn[d] + SDF_BLOCK - 1)/SDF_BLOCK;
+    block.assign(nb[0]*nb[1]*nb[2], -1);
+    val.clear();
+    std::vector <float> align;   //Normal alignment of the closest element, breaks sign ties at edges
+
+    for (int e=0;e<mesh.element.Size();e++){
+      const Element *el = mesh.element[e];
+      Vec3_t a = mesh.node0[el->node[0]], b = mesh.node0[el->node[1]];
+      Vec3_t c = (dim == 3) ? mesh.node0[el->node[2]] : b;
+      int lo[3], hi[3];
+      for (int d=0;d<3;d++){
+        double emin = std::min(a(d),std::min(b(d),c(d))) - band;
+        double emax = std::max(a(d),std::max(b(d),c(d))) + band;
+        lo[d] = std::max(0,       int(floor((emin - origin(d))/cell)));
+        hi[d] = std::min(nn[d]-1, int(ceil ((emax - origin(d))/cell)));
+      }
+      if (dim == 2) lo[2] = hi[2] = 0;
+      for (int k=lo[2];k<=hi[2];k++)
+      for (int j=lo[1];j<=hi[1];j++)
+      for (int i=lo[0];i<=hi[0];i++){
+        Vec3_t x = origin + Vec3_t(i*cell, j*cell, k*cell);
+        Vec3_t q = (dim == 3) ? ClosestOnTriangle(x,a,b,c) : ClosestOnSegment(x,a,b);
+        Vec3_t r = x - q;
+        double dist = norm(r);
+        if (dist > band) continue;
+        double s  = dot(r, mesh.normal0[e]);
+        double al = dist > 0. ? fabs(s)/dist : 1.;
+        int v = Alloc(i,j,k, align);
+        double cur = fabs(val[v]);
+        double tol = 1.0e-6*cell;
+        if (dist < cur - tol || (dist <= cur + tol && al > align[v])){
+          val[v]   = float(s < 0. ? -dist : dist);
+          align[v] = float(al);
+        }
+      }
+    }
+    std::cout << "SDF grid "<<nn[0]<<"x"<<nn[1]<<"x"<<nn[2]<<" nodes, "<<val.size()/(SDF_BLOCK*SDF_BLOCK*SDF_BLOCK)<<" blocks allocated"<<std::endl;
+  }
+
+  //x in body frame, n is the outer normal (body frame)
+  inline bool Sample(const Vec3_t &x, double &d, Vec3_t &n) const{
+    if (type == SDF_Plane) {
+      d = dot(x - p, axis);
+      Vec3_t q = x - d * axis;
+      for (int c=0;c<3;c++)
+        if (q(c) < bmin(c) - 1.0e-10 || q(c) > bmax(c) + 1.0e-10) return false;
+      n = axis;
+      return true;
+    } else if (type == SDF_Cylinder) {
+      double z  = dot(x - p, axis);
+      Vec3_t r  = x - p - z * axis;
+      double rn = norm(r);
+      Vec3_t er = rn > 0. ? Vec3_t(r / rn) : Vec3_t(0.,0.,0.);
+      double dr = rn - radius;                    //Lateral face
+      double dz = std::max(zmin - z, z - zmax);   //End faces
+      Vec3_t ez = (z - zmax > zmin - z) ? axis : Vec3_t(-axis);
+      if (dr <= 0. && dz <= 0.) {                 //Inside, closest face
+        if (dr > dz) { d = dr; n = er; }
+        else         { d = dz; n = ez; }
+      } else {                                    //Outside, face or rim
+        double a = std::max(dr, 0.), b = std::max(dz, 0.);
+        d = sqrt(a*a + b*b);
+        n = (a * er + b * ez) / d;
+      }
+      return norm(n) > 0.;
+    }
+    double f[3]; int i[3];
+    for (int c=0;c<3;c++){
+      if (c == 2 && dim == 2) { i[2] = 0; f[2] = 0.; continue; }
+      double t = (x(c) - origin(c))/cell;
+      i[c] = int(floor(t));
+      if (i[c] < 0 || i[c] >= nn[c]-1) return false;
+      f[c] = t - i[c];
+    }
+    double v[2][2][2];
+    for (int kk=0;kk<2;kk++)
+    for (int jj=0;jj<2;jj++)
+    for (int ii=0;ii<2;ii++){
+      int k = (dim == 2) ? 0 : i[2]+kk;
+      int idx = Index(i[0]+ii, i[1]+jj, k);
+      if (idx < 0 || fabs(val[idx]) >= FLT_MAX) return false;
+      v[ii][jj][kk] = val[idx];
+    }
+    double gx = 0., gy = 0., gz = 0.;
+    d = 0.;
+    for (int kk=0;kk<2;kk++)
+    for (int jj=0;jj<2;jj++)
+    for (int ii=0;ii<2;ii++){
+      double wx = ii ? f[0] : 1.-f[0], wy = jj ? f[1] : 1.-f[1], wz = kk ? f[2] : 1.-f[2];
+      double sx = ii ? 1. : -1.,       sy = jj ? 1. : -1.,       sz = kk ? 1. : -1.;
+      d  += wx*wy*wz * v[ii][jj][kk];
+      gx += sx*wy*wz * v[ii][jj][kk];
+      gy += wx*sy*wz * v[ii][jj][kk];
+      gz += wx*wy*sz * v[ii][jj][kk];
+    }
+    if (dim == 2) gz = 0.;
+    n = Vec3_t(gx, gy, gz);
+    double gn = norm(n);
+    if (gn <= 0.) return false;
+    n /= gn;
+    return true;
+  }
+
+private:
+  inline int Index(const int &i, const int &j, const int &k) const{
+    int b = block[(i/SDF_BLOCK) + nb[0]*((j/SDF_BLOCK) + nb[1]*(k/SDF_BLOCK))];
+    if (b < 0) return -1;
+    return b + (i%SDF_BLOCK) + SDF_BLOCK*((j%SDF_BLOCK) + SDF_BLOCK*(k%SDF_BLOCK));
+  }
+  inline int Alloc(const int &i, const int &j, const int &k, std::vector<float> &align){
+    int &b = block[(i/SDF_BLOCK) + nb[0]*((j/SDF_BLOCK) + nb[1]*(k/SDF_BLOCK))];
+    if (b < 0) {
+      b = val.size();
+      val.resize  (val.size()   + SDF_BLOCK*SDF_BLOCK*SDF_BLOCK, FLT_MAX);
+      align.resize(align.size() + SDF_BLOCK*SDF_BLOCK*SDF_BLOCK, 0.f);
+    }
+    return Index(i,j,k);
+  }
+
+  //Ericson, Real-Time Collision Detection 5.1.5
+  inline Vec3_t ClosestOnTriangle(const Vec3_t &x, const Vec3_t &a, const Vec3_t &b, const Vec3_t &c) const{
+    Vec3_t ab = b - a, ac = c - a, ax = x - a;
+    double d1 = dot(ab,ax), d2 = dot(ac,ax);
+    if (d1 <= 0. && d2 <= 0.) return a;
+    Vec3_t bx = x - b;
+    double d3 = dot(ab,bx), d4 = dot(ac,bx);
+    if (d3 >= 0. && d4 <= d3) return b;
+    double vc = d1*d4 - d3*d2;
+    if (vc <= 0. && d1 >= 0. && d3 <= 0.) return a + d1/(d1-d3) * ab;
+    Vec3_t cx = x - c;
+    double d5 = dot(ab,cx), d6 = dot(ac,cx);
+    if (d6 >= 0. && d5 <= d6) return c;
+    double vb = d5*d2 - d1*d6;
+    if (vb <= 0. && d2 >= 0. && d6 <= 0.) return a + d2/(d2-d6) * ac;
+    double va = d3*d6 - d5*d4;
+    if (va <= 0. && (d4-d3) >= 0. && (d5-d6) >= 0.) return b + (d4-d3)/((d4-d3)+(d5-d6)) * (c - b);
+    double den = 1./(va+vb+vc);
+    return a + ab*(vb*den) + ac*(vc*den);
+  }
+  inline Vec3_t ClosestOnSegment(const Vec3_t &x, const Vec3_t &a, const Vec3_t &b) const{
+    Vec3_t ab = b - a;
+    double t = dot(x - a, ab)/dot(ab,ab);
+    if (t < 0.) t = 0.; else if (t > 1.) t = 1.;
+    return a + t * ab;
+  }
+};
+
+};
+
+#endif
@@ -38,6 +38,7 @@ inline void Domain::CalcContactForcesLS(){
     Particles[i] -> q_cont_conv = 0.;
     Particles[i] -> friction_hfl = 0.;
   }
+  ZeroContactAccum();
 
   for (int m=0;m<meshcount;m++) tot_cont_heat_cond[m] = 0.;
   
@@ -88,191 +89,87 @@ inline void Domain::CalcContactForcesLS(){
   Vec3_t ref_tg;
   double dS2;
 
-	#pragma omp parallel for schedule (static) private(P1,P2,end,vr,dist, delta_tg, delta_,delta, abs_fv, x_pred, imp_force, fr_sta, fr_dyn, ref_tg, vr_pred, du, m, inside,i,j,crit,dt_fext,kij,omega,psi_cont,e,tgforce,tgforce_dyn,tgvr,norm_tgvr,tgdir,atg, dS2) num_threads(Nproc)
-  //tgforce
-	#ifdef __GNUC__
-	for (size_t k=0; k<Nproc;k++) 
-	#else
-	for (int k=0; k<Nproc;k++) 
-	#endif	
-	{
-		Vec3_t xij, qj;
-		double h,K;
-		// Summing the smoothed pressure, velocity and stress for fixed particles from neighbour particles
-		//IT IS CONVENIENT TO FIX SINCE FSMPairs are significantly smaller
-		//cout << "Contact pair size: "<<ContPairs[k].Size()<<endl;
-		for (size_t a = 0; a < ContPairs[k].Size();a++) {
-    // TODO: DO THIS ONCE PER PARTICLE
-    // int a = 0;
-    // end = false;
-    // while (!end){ //Per particle
-    
+	//One iteration per SPH particle with contact candidates, the closest active element of each mesh
+	//is resolved first and the particle is written by this iteration only (no locks)
+	#pragma omp parallel for schedule (dynamic,64) private(P1,P2,vr,dist, delta_,delta, x_pred, fr_sta, fr_dyn, m,dt_fext,kij,omega,psi_cont,tgvr,norm_tgvr,tgdir) num_threads(Nproc)
+	for (int c = 0; c < cont_part.size(); c++) {
+    ContactAccum &acc = cacc[omp_get_thread_num()];
     //P1 is SPH particle, P2 is CONTACT SURFACE (FEM) Particle
-      bool is_first = false;
-      for (int m=0;m<meshcount;m++){
-        if (Particles[ContPairs[k][a].first]->ID == contact_surf_id[m])
-          is_first = true;
-      }
-      
-
-      if (is_first) 	{ 	//Cont Surf is partcicles from FEM
-        P1 = ContPairs[k][a].second; P2 = ContPairs[k][a].first; 	}
-      else {
-        P1 = ContPairs[k][a].first; P2 = ContPairs[k][a].second; } 
-      
-			vr = Particles[P1]->v - Particles[P2]->v;		//Fraser 3-137
-			//cout << "Particle P1v: "<<Particles[P1]->v<<endl;
-			//cout << "Particle P2v: "<<Particles[P2]->v<<endl;
-			//ok, FEM Particles normals can be calculated by two ways, the one used to
-			//calculate SPH ones, and could be given by mesh input
-			//delta_ Is the projection of relative velocity 
-			delta_ = - dot( Particles[P2]->normal , vr);	//Penetration rate, Fraser 3-138
-      
-      //cout << "p1 vel "<<Particles[P1]->v << "p2 vel "<< Particles[P2]->v <<endl;
-      // cout << "distance "<< Particles[P1]->x - Particles[P2]->x<<endl;
-			//Check if SPH and fem particles are approaching each other
-			//if (delta_ > 0 ){
-        m = Particles[P2]->mesh;
-        //cout << "particle Mesh "<< m<<", " <<"particle " << P2<<endl;
-				e = trimesh[m]-> element[Particles[P2]->element];
-        
-        x_pred = Particles[P1]->x + Particles[P1]->v * deltat + Particles[P1]->a * deltat * deltat/2.0;
-        vr_pred = Particles[P1]->v + Particles[P1]->a * deltat - Particles[P2]->v;
-        
-        dist =  dot (Particles[P2]->normal, x_pred ) - trimesh[m]-> element[Particles[P2]->element] -> pplane;
-        //cout << "dist "<<dist<<", h "<<Particles[P1]->h<<endl;
-        if( dist  < Particles[P1]->h) {
-
-          qj = Particles[P1]->x - dist * Particles[P2]->normal;
-                                 //Check if it is inside triangular element
-					//Find a vector 
-					//Fraser 3-147
-					inside = true;
-          if (trimesh[m]->dimension == 3){
-            i=0;		
-            while (i<3 && inside){
-              j = i+1;	if (j>2) j = 0;
-              crit = dot (cross ( *trimesh[m]->node[e -> node[j]] 
-                                          - *trimesh[m]->node[e -> node[i]],
-                                          qj  - *trimesh[m]->node[e -> node[i]]),
-                                Particles[P2]->normal);
-              if (crit < 0.0) inside = false;
-              i++;
-            }
-          } else { //MESH DIMENSION = 2
-            i=0;
-            while (i<2 && inside){
-              j = i+1;	if (j>1) j = 0;
-              crit = dot ( *trimesh[m]->node[e -> node[j]] 
-                                          - *trimesh[m]->node[e -> node[i]],
-                                          qj  - *trimesh[m]->node[e -> node[i]]);
-              if (crit < 0.0) inside = false;
-              i++;
-            }
-          }
-					
-					if (inside ) { //Contact point inside element, contact proceeds
-            inside_geom++;
-            end=true;
-
-            delta = Particles[P1]->h - dist;
-            //cout << "dist "<<dist<<", h "<<Particles[P1]->h<< ", delta "<<delta<<endl;
-						// DAMPING
-						//Calculate SPH and FEM elements stiffness (series)
-						//Since FEM is assumed as rigid, stiffness is simply the SPH one 
-            // if (!gradKernelCorr)
-              kij = 2.0 * Particles[P1]->Mass / (deltat * deltat) * PFAC;
-            // else //TESTING PHASE
-              // kij = Particles[P1]->Mass / (deltat * deltat);
-						
-            //kij = PFAC * Particles[P1]-> cont_stiff;
-						omega = sqrt (kij/Particles[P1]->Mass);
-						psi_cont = 2. * Particles[P1]->Mass * omega * DFAC; // Fraser Eqn 3-158
-
-						omp_set_lock(&Particles[P1]->my_lock);
-              Particles[P1] -> contforce = (kij * delta - psi_cont * delta_) * Particles[P2]->normal; // NORMAL DIRECTION, Fraser 3-159    
-              //Particles[P1] -> delta_cont = delta;
-						omp_unset_lock(&Particles[P1]->my_lock);
-            
-            //removed if, this is calculated always
-            tgvr = vr + delta_ * Particles[P2]->normal;  // -dot(vr,normal) * normal, FRASER 3-168
-            norm_tgvr = norm(tgvr);  
-            tgdir = tgvr / norm_tgvr;              
-            atg = Particles[P1] -> a - dot (Particles[P1] -> a,Particles[P2]->normal)*Particles[P2]->normal;
-            //ONCE SAVED atg, now can change acceleration by contact!
-
-						dt_fext = contact_force_factor * (Particles[P1]->Mass * 2. * norm(Particles[P1]->v) / norm (Particles[P1] -> contforce));
-
-						if (dt_fext < min_force_ts_){
-							min_force_ts_ = dt_fext;
-							if (dt_fext > 0)
-                omp_set_lock(&dom_lock);
-								this -> min_force_ts = min_force_ts_;
-                omp_unset_lock(&dom_lock);
-						}
-						// omp_set_lock(&Particles[P1]->my_lock);
-            // Particles[P1] -> a += Particles[P1] -> contforce / Particles[P1] -> Mass; 
-						// omp_unset_lock(&Particles[P1]->my_lock);
-
-            
-            fr_sta = friction_sta;
-            fr_dyn = friction_dyn;
-            if (friction_function == Linear)
-              fr_sta = fr_dyn = friction_m * Particles[P1] ->T + friction_b;
-            
-            Vec3_t fT(0.,0.,0.);
-            
-            if (fr_sta > 0.) { 
-              Vec3_t fricold = Particles[P1] -> tgforce;
-              
-              Vec3_t kdeltae = PFAC * Particles[P1]->Mass*vr/deltat;
-              
-              //double fy = friction_mu*glm::length(fN);	//coulomb friction
-              double fy = fr_sta * norm(Particles[P1] -> contforce);  
-              Vec3_t fstar = fricold - kdeltae;
-
-              if (norm(fstar) > fy) {
-                fT  = fy*fstar/norm(fstar);
-              } else {
-                fT = fstar;
-              }
-              
-              //Particles[P1] -> tgforce = fT;
-              
-            omp_set_lock(&Particles[P1]->my_lock);
-              Particles[P1] -> contforce += fT; // NORMAL DIRECTION, Fraser 3-159    
-						omp_unset_lock(&Particles[P1]->my_lock);
-
-						// omp_set_lock(&Particles[P1]->my_lock);
-						// //Particles[P1] -> a += Particles[P1] -> contforce / Particles[P1] -> Mass; 
-            // Particles[P1] -> a += Particles[P1] -> tgforce / Particles[P1] -> Mass; 
-						// omp_unset_lock(&Particles[P1]->my_lock);  
-
-
-            }//friction
-            
-            omp_set_lock(&dom_lock);            
-              contact_force_sum += norm(Particles[P1] ->contforce);
-              //contact_force_sum_v += Particles[P1] ->contforce;
-              contact_reaction_sum += dot (Particles[P1] -> a,Particles[P2]->normal)* Particles[P1]->Mass;
-              //ext_forces_work_step += dot (Particles[P1] -> contforce,//Particles[P2]->v);
-              //ext_forces_work_step += /*dot(*/Particles[P1] -> contforce/*,1./norm(Particles[P2]->v)*Particles[P2]->v)*/ * Particles[P2]->v; //Assuming v2 and forces are parallel
-              ext_forces_work_step += dot(Particles[P1] -> contforce,Particles[P2]->v);
-            omp_unset_lock(&dom_lock);	
-
-            
-					}// if inside
-        } //If distance is less than h
-    }//Contact Pairs
-    
-    //contact_force_sum = norm (contact_force_sum_v);
-	}//Nproc
+    P1 = cont_part[c];
+    x_pred = Particles[P1]->x + Particles[P1]->v * deltat + Particles[P1]->a * deltat * deltat/2.0;
+    for (m=0;m<meshcount;m++){
+      P2 = ActiveContactElement(c, m, x_pred, dist);
+      if (P2 < 0) continue;
+
+      vr = Particles[P1]->v - Particles[P2]->v;		//Fraser 3-137
+      //delta_ Is the projection of relative velocity 
+      delta_ = - dot( Particles[P2]->normal , vr);	//Penetration rate, Fraser 3-138
+
+      delta = Particles[P1]->h - dist;
+      //cout << "dist "<<dist<<", h "<<Particles[P1]->h<< ", delta "<<delta<<endl;
+      // DAMPING
+      //Calculate SPH and FEM elements stiffness (series)
+      //Since FEM is assumed as rigid, stiffness is simply the SPH one 
+      // if (!gradKernelCorr)
+        kij = 2.0 * Particles[P1]->Mass / (deltat * deltat) * PFAC;
+      // else //TESTING PHASE
+        // kij = Particles[P1]->Mass / (deltat * deltat);
+
+      //kij = PFAC * Particles[P1]-> cont_stiff;
+      omega = sqrt (kij/Particles[P1]->Mass);
+      psi_cont = 2. * Particles[P1]->Mass * omega * DFAC; // Fraser Eqn 3-158
+
+      Vec3_t cf = (kij * delta - psi_cont * delta_) * Particles[P2]->normal; // NORMAL DIRECTION, Fraser 3-159    
+      double cf_norm = norm(cf);
+
+      //removed if, this is calculated always
+      tgvr = vr + delta_ * Particles[P2]->normal;  // -dot(vr,normal) * normal, FRASER 3-168
+      norm_tgvr = norm(tgvr);  
+      tgdir = tgvr / norm_tgvr;              
+
+      dt_fext = contact_force_factor * (Particles[P1]->Mass * 2. * norm(Particles[P1]->v) / cf_norm);
+      acc.MinTS(dt_fext);
+
+      fr_sta = friction_sta;
+      fr_dyn = friction_dyn;
+      if (friction_function == Linear)
+        fr_sta = fr_dyn = friction_m * Particles[P1] ->T + friction_b;
+
+      Vec3_t fT(0.,0.,0.);
+
+      if (fr_sta > 0.) { 
+        Vec3_t fricold = Particles[P1] -> tgforce;
+
+        Vec3_t kdeltae = PFAC * Particles[P1]->Mass*vr/deltat;
+
+        //double fy = friction_mu*glm::length(fN);	//coulomb friction
+        double fy = fr_sta * cf_norm;  
+        Vec3_t fstar = fricold - kdeltae;
+
+        if (norm(fstar) > fy) {
+          fT  = fy*fstar/norm(fstar);
+        } else {
+          fT = fstar;
+        }
+        cf += fT;
+        //Particles[P1] -> tgforce = fT;
+      }//friction
+
+      Particles[P1] -> contforce += cf; //Sum of the meshes in contact
+
+      acc.force_sum     += norm(cf);
+      acc.mesh_force[m] += cf;
+      acc.reaction_sum  += dot (Particles[P1] -> a,Particles[P2]->normal)* Particles[P1]->Mass;
+      acc.work          += dot(cf,Particles[P2]->v);
+    }//mesh
+	}//Contact particles
   //cout << "END CONTACT----------------------"<<endl;
 	max_contact_force = sqrt (max_contact_force);
 	//min_contact_force = sqrt (min_contact_force);
 	//cout << "Inside pairs count: "<<inside_geom<<", Inside time: "<<inside_time<<", statically restricted " << stra_restr<<endl;
 	int cont_force_count = 0;
 	
+  MergeContactAccum();
   ext_forces_work += ext_forces_work_step * deltat;
 	//if (max_contact_force > 0.){
     //cout << "particles surpassed max fr force"<<max_reached_part<< ", below force: " <<sta_frict_particles<<endl;
@@ -0,0 +1,113 @@
+#include "matvec.h"
+
+namespace SPH {
+
+//Fields are built once, in the body frame of each mesh (meshes are set to rigid frame here if they are not)
+inline void Domain::BuildContactSDF(){
+  if (mesh_sdf.size() < meshcount) mesh_sdf.resize(meshcount, NULL);
+  double hmin = 1000., hmax_ = 0.;
+  for (int i=0; i<first_fem_particle_idx[0]; i++){
+    if (Particles[i]->h < hmin)  hmin  = Particles[i]->h;
+    if (Particles[i]->h > hmax_) hmax_ = Particles[i]->h;
+  }
+  for (int m=0;m<meshcount;m++){
+    if (!trimesh[m]->rigid_frame) trimesh[m]->SetRigidFrame();
+    if (mesh_sdf[m] != NULL) continue; //Given (cylinder) or already built
+    mesh_sdf[m] = new SignedDistField;
+    TriMesh *tm = trimesh[m];
+
+    //Planar meshes are analytic
+    bool planar = true;
+    Vec3_t xmin = tm->node0[0], xmax = xmin;
+    for (int n=1;n<tm->node0.size();n++)
+      for (int d=0;d<3;d++){
+        if (tm->node0[n](d) < xmin(d)) xmin(d) = tm->node0[n](d);
+        if (tm->node0[n](d) > xmax(d)) xmax(d) = tm->node0[n](d);
+      }
+    double tol = 1.0e-6 * norm(xmax - xmin);
+    for (int e=1;e<tm->element.Size() && planar;e++)
+      if (norm(tm->normal0[e] - tm->normal0[0]) > 1.0e-6) planar = false;
+    for (int n=0;n<tm->node0.size() && planar;n++)
+      if (fabs(dot(tm->node0[n] - tm->node0[0], tm->normal0[0])) > tol) planar = false;
+
+    if (planar) {
+      mesh_sdf[m]->dim = tm->dimension;
+      mesh_sdf[m]->SetPlane(tm->node0[0], tm->normal0[0], xmin, xmax);
+      cout << "Mesh "<<m<<": planar, analytic distance field"<<endl;
+    } else {
+      double cell = sdf_cell > 0. ? sdf_cell : 0.5 * hmin;
+      mesh_sdf[m]->BuildGrid(*tm, cell, 2.*hmax_ + cell);
+    }
+  }
+}
+
+//p and axis are given in the current (world) position of the mesh. They are taken to the body frame,
+//which is set here if it was not, and the end faces are the axial extent of the mesh nodes
+inline void Domain::SetContactSDFCylinder(const int &m, const Vec3_t &p, const Vec3_t &axis, const double &r){
+  if (mesh_sdf.size() <= m) mesh_sdf.resize(m+1, NULL);
+  if (mesh_sdf[m] == NULL) mesh_sdf[m] = new SignedDistField;
+  TriMesh *tm = trimesh[m];
+  if (!tm->rigid_frame) tm->SetRigidFrame();
+  Vec3_t p0, ax0;
+  tm->ToBody(p, p0);
+  Mult(axis, tm->m_R, ax0); //R^T axis
+  ax0 /= norm(ax0);
+  double zmin = 1.e10, zmax = -1.e10;
+  for (int n=0;n<tm->node0.size();n++){
+    double z = dot(tm->node0[n] - p0, ax0);
+    if (z < zmin) zmin = z;
+    if (z > zmax) zmax = z;
+  }
+  mesh_sdf[m]->SetCylinder(p0, ax0, r, zmin, zmax);
+  cout << "Mesh "<<m<<": cylinder distance field, radius "<<r<<", length "<<zmax-zmin<<endl;
+}
+
+////////////////////////////////
+//// Penalty contact of CalcContactForcesWang (ContactForceWang), but distance and normal are sampled from
+//// the tool signed distance field for each free surface particle. There are no contact
+//// pairs and no inside triangle tests, each particle is visited once so it is not locked
+////////////////////////////////
+inline void Domain::CalcContactForcesSDF(){
+  if (meshcount == 0) return;
+  bool built = mesh_sdf.size() >= meshcount;
+  for (int m=0;m<meshcount && built;m++)
+    if (mesh_sdf[m] == NULL || !trimesh[m]->rigid_frame) built = false;
+  if (!built) BuildContactSDF();
+
+  #pragma omp parallel for num_threads(Nproc)
+  for (int i = 0;i<Particles.Size();i++){
+		Particles[i] -> contforce = 0.; //RESET
+		Particles[i] -> delta_cont = 0.; //RESET
+    Particles[i] -> q_fric_work = 0.;
+    Particles[i] -> cshearabs = 0.; //cshear module
+    Particles[i] -> q_cont_conv = 0.;
+    Particles[i] -> friction_hfl = 0.;
+  }
+	max_contact_force = 0.;
+  ZeroContactAccum();
+  int nsolid = first_fem_particle_idx[0];
+
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+  for (int p=0; p<nsolid; p++){
+    if (Particles[p]->ID != id_free_surf) continue;
+    ContactAccum &acc = cacc[omp_get_thread_num()];
+    Particle *P = Particles[p];
+    Vec3_t x_pred = P->x + P->v * deltat + P->a * deltat * deltat/2.0;
+
+    for (int m=0;m<meshcount;m++){
+      TriMesh *tm = trimesh[m];
+      Vec3_t x0, n0, n;
+      double dist;
+      tm->ToBody(x_pred, x0);
+      if (!mesh_sdf[m]->Sample(x0, dist, n0) || dist >= P->h) continue;
+      Mult(tm->m_R, n0, n);
+      Vec3_t vt = tm->m_v + cross(tm->m_w, P->x);   //Tool velocity at the particle
+      ContactForceWang(P, n, dist, vt, tm->T, x_pred, m, acc);
+    }//mesh
+  }//particle
+
+  MergeContactAccum();
+  ext_forces_work += ext_forces_work_step * deltat;
+}
+
+}; //SPH
@@ -7,6 +7,75 @@
 
 namespace SPH {
 
+//////////////////////////////// 
+//// Penalty force, friction and contact heat of one SPH particle against a rigid surface (Wang/Fraser).
+//// n is the outer surface normal, dist the particle distance to it, vt and Ttool the surface velocity
+//// and temperature at the contact. Called once per particle and surface, so the particle is not locked
+////////////////////////////////
+inline void Domain::ContactForceWang(Particle *P, const Vec3_t &n, const double &dist, const Vec3_t &vt, const double &Ttool,
+                                     const Vec3_t &x_pred, const int &m, ContactAccum &acc){
+  Vec3_t vr = P->v - vt;                  //Fraser 3-137
+  double delta_ = - dot(n, vr);           //Penetration rate, Fraser 3-138
+  double delta  = P->h - dist;
+  //Since FEM is assumed as rigid, stiffness is simply the SPH one 
+  double kij = 2.0 * P->Mass / (deltat * deltat);
+  double omega = sqrt (kij/P->Mass);
+  double psi_cont = 2. * P->Mass * omega * DFAC; // Fraser Eqn 3-158
+
+  Vec3_t cf = (kij * delta - psi_cont * delta_) * n; // NORMAL DIRECTION, Fraser 3-159    
+  double cf_norm = norm(cf);
+
+  double dt_fext = contact_force_factor * (P->Mass * 2. * norm(P->v) / cf_norm);
+  acc.MinTS(dt_fext);
+
+  double fr_sta = friction_sta, fr_dyn = friction_dyn;
+  if (friction_function == Linear)
+    fr_sta = fr_dyn = friction_m * P->T + friction_b;
+
+  double dens = P->Density;
+  double dS2;
+  if (Dimension==3)
+    dS2 = pow(P->Mass/dens,2.0/3.0); //Fraser 3-119
+  else if (dom_bid_type == AxiSymmetric){
+    // m= 2.0*pi*r *(s)*(s) , dens(ax) = 2. pi * r rho --> m/rho = 
+    //BEFORE CONVERTING rho!!
+    dS2 = sqrt(P->Mass/dens)*2.0*M_PI*P->x[0]; 
+    dens /= 2.0*M_PI* P->x[0]; //USED AFTER FOR FRICTION AND CONDUCTION (CALLED CONV)
+  } else
+    dS2 = pow(P->Mass/dens,1.0/3.0); //PLANE STRAIN
+
+  if (fr_sta > 0.) { 
+    ////// DISPLACEMENT CRITERIA
+    //Wang2013, but applied to current step
+    Vec3_t du = x_pred - P->x - vt * deltat;
+    Vec3_t delta_tg = du - dot(du, n)*n;
+    Vec3_t tgforce = kij * delta_tg;
+    if (norm(tgforce) < fr_sta * cf_norm ){ //STATIC; NO SLIP
+      cf -= tgforce;
+    } else if (norm(tgforce) > 0.) {
+      Vec3_t tgforce_dyn = fr_dyn * cf_norm * tgforce/norm(tgforce);
+      cf -= tgforce_dyn;
+      if (cont_heat_fric){
+        double abs_fv = fabs(dot(tgforce_dyn,vr));
+        P->q_fric_work  =  abs_fv * dens / P->Mass; //J/(m3.s)
+        P->cshearabs    = norm(tgforce_dyn) / dS2;
+        P->friction_hfl = abs_fv / dS2; //J/(m3.s)
+      }
+    }
+  }//friction
+
+  P -> contforce += cf;
+  P -> delta_cont = delta;
+  P -> a += cf / P->Mass;
+  if (cont_heat_cond) //Contact thermal Conductance, Fraser Eq 3.121
+    P->q_cont_conv = dens * contact_hc * dS2 * (Ttool - P->T) / P->Mass; //J/[m3.s]
+
+  acc.force_sum     += norm(cf);
+  acc.mesh_force[m] += cf;
+  acc.reaction_sum  += dot (P -> a, n) * P->Mass;
+  acc.work          += dot(cf, vt);
+}
+
 //////////////////////////////// 
 //// From Wang: Simulating frictional contact in smoothed particle hydrodynamics
 //// https://link.springer.com/article/10.1007/s11431-013-5262-x
@@ -37,9 +106,8 @@ inline void Domain::CalcContactForcesWang(){
 		inside_time=inside_geom=0;
     Particles[i] -> q_cont_conv = 0.;
     Particles[i] -> friction_hfl = 0.;
-    for (int m=0;m<meshcount;m++)
-      m_contact_force[m]=0.0;
   }
+  ZeroContactAccum();
 
   for (int m=0;m<meshcount;m++) tot_cont_heat_cond[m] = 0.;
   
@@ -91,256 +159,28 @@ inline void Domain::CalcContactForcesWang(){
   double dS2;
 
     
-	#pragma omp parallel for schedule (static) private(P1,P2,end,vr,dist, delta_tg, delta_,delta, abs_fv, x_pred, imp_force, fr_sta, fr_dyn, ref_tg, vr_pred, du, m, inside,i,j,crit,dt_fext,kij,omega,psi_cont,e,tgforce,tgforce_dyn,tgvr,norm_tgvr,tgdir,atg, dS2) num_threads(Nproc)
-  //tgforce
-	#ifdef __GNUC__
-	for (size_t k=0; k<Nproc;k++) 
-	#else
-	for (int k=0; k<Nproc;k++) 
-	#endif	
-	{
-		Vec3_t xij, qj;
-		double h,K;
-		// Summing the smoothed pressure, velocity and stress for fixed particles from neighbour particles
-		//IT IS CONVENIENT TO FIX SINCE FSMPairs are significantly smaller
-		//cout << "Contact pair size: "<<ContPairs[k].Size()<<endl;
-		for (size_t a = 0; a < ContPairs[k].Size();a++) {
-    // TODO: DO THIS ONCE PER PARTICLE
-    // int a = 0;
-    // end = false;
-    // while (!end){ //Per particle
-    
+	//One iteration per SPH particle with contact candidates, the closest active element of each mesh
+	//is resolved first (one force per mesh, as in SDF contact) and the particle is written by this
+	//iteration only (no locks)
+	#pragma omp parallel for schedule (dynamic,64) private(P1,P2,dist,x_pred) num_threads(Nproc)
+	for (int c = 0; c < cont_part.size(); c++) {
+    ContactAccum &acc = cacc[omp_get_thread_num()];
     //P1 is SPH particle, P2 is CONTACT SURFACE (FEM) Particle
-      bool is_first = false;
-      for (int m=0;m<meshcount;m++){
-        if (Particles[ContPairs[k][a].first]->ID == contact_surf_id[m])
-          is_first = true;
-      }
-      
-
-      if (is_first) 	{ 	//Cont Surf is partcicles from FEM
-        P1 = ContPairs[k][a].second; P2 = ContPairs[k][a].first; 	}
-      else {
-        P1 = ContPairs[k][a].first; P2 = ContPairs[k][a].second; } 
-      
-			vr = Particles[P1]->v - Particles[P2]->v;		//Fraser 3-137
-			//cout << "Particle P1v: "<<Particles[P1]->v<<endl;
-			//cout << "Particle P2v: "<<Particles[P2]->v<<endl;
-			//ok, FEM Particles normals can be calculated by two ways, the one used to
-			//calculate SPH ones, and could be given by mesh input
-			//delta_ Is the projection of relative velocity 
-			delta_ = - dot( Particles[P2]->normal , vr);	//Penetration rate, Fraser 3-138
-      
-      //cout << "p1 vel "<<Particles[P1]->v << "p2 vel "<< Particles[P2]->v <<endl;
-      // cout << "distance "<< Particles[P1]->x - Particles[P2]->x<<endl;
-			//Check if SPH and fem particles are approaching each other
-			//if (delta_ > 0 ){
-        m = Particles[P2]->mesh;
-        //cout << "particle Mesh "<< m<<", " <<"particle " << P2<<endl;
-				e = trimesh[m]-> element[Particles[P2]->element];
-        
-        x_pred = Particles[P1]->x + Particles[P1]->v * deltat + Particles[P1]->a * deltat * deltat/2.0;
-        vr_pred = Particles[P1]->v + Particles[P1]->a * deltat - Particles[P2]->v;
-        
-        dist =  dot (Particles[P2]->normal, x_pred ) - trimesh[m]-> element[Particles[P2]->element] -> pplane;
-        //cout << "dist "<<dist<<", h "<<Particles[P1]->h<<endl;
-        if( dist  < Particles[P1]->h) {
-
-          qj = Particles[P1]->x - dist * Particles[P2]->normal;
-                                 //Check if it is inside triangular element
-					//Find a vector 
-					//Fraser 3-147
-					inside = true;
-          if (trimesh[m]->dimension == 3){
-            i=0;		
-            while (i<3 && inside){
-              j = i+1;	if (j>2) j = 0;
-              crit = dot (cross ( *trimesh[m]->node[e -> node[j]] 
-                                          - *trimesh[m]->node[e -> node[i]],
-                                          qj  - *trimesh[m]->node[e -> node[i]]),
-                                Particles[P2]->normal);
-              if (crit < 0.0) inside = false;
-              i++;
-            }
-          } else { //MESH DIMENSION = 2
-            i=0;
-            while (i<2 && inside){
-              j = i+1;	if (j>1) j = 0;
-              crit = dot ( *trimesh[m]->node[e -> node[j]] 
-                                          - *trimesh[m]->node[e -> node[i]],
-                                          qj  - *trimesh[m]->node[e -> node[i]]);
-              if (crit < 0.0) inside = false;
-              i++;
-            }
-          }
-					
-					if (inside ) { //Contact point inside element, contact proceeds
-            inside_geom++;
-            end=true;
-
-            delta = Particles[P1]->h - dist;
-            //cout << "dist "<<dist<<", h "<<Particles[P1]->h<< ", delta "<<delta<<endl;
-						// DAMPING
-						//Calculate SPH and FEM elements stiffness (series)
-						//Since FEM is assumed as rigid, stiffness is simply the SPH one 
-            // if (!gradKernelCorr)
-              kij = 2.0 * Particles[P1]->Mass / (deltat * deltat);
-            // else //TESTING PHASE
-              // kij = Particles[P1]->Mass / (deltat * deltat);
-						
-            //kij = PFAC * Particles[P1]-> cont_stiff;
-						omega = sqrt (kij/Particles[P1]->Mass);
-						psi_cont = 2. * Particles[P1]->Mass * omega * DFAC; // Fraser Eqn 3-158
-            
-            //normal_cf = 2.0 * Particles[P1]->Mass /(deltat*deltat )*delta;
-            //cout << "Normal "<<Particles[P2]->normal<<endl;
-						omp_set_lock(&Particles[P1]->my_lock);
-                Particles[P1] -> contforce = (kij * delta - psi_cont * delta_) * Particles[P2]->normal; // NORMAL DIRECTION, Fraser 3-159    
-              Particles[P1] -> delta_cont = delta;
-						omp_unset_lock(&Particles[P1]->my_lock);
-            
-            // if (P1 ==11062) {
-            // cout << "Particle "<<P1 << ", contforce "<<Particles[P1] ->contforce<<endl;
-            // cout << "Particle P2 normal "<<Particles[P2]->normal<<endl; 
-            // cout << "x_pred "<<x_pred<<endl;
-            // cout << "x: "<<Particles[P1]->x <<endl;
-            // cout << "dist: "<<dist <<endl;
-            // cout << "pplane "<<trimesh[m]-> element[Particles[P2]->element] -> pplane<<endl;
-            // }
-            // if ( abs(Particles[P1] -> contforce[0])>1.0e-5 || abs(Particles[P1] -> contforce[1])>1.0e-5){
-              // cout << "TG CONTACT FORCE != 0 !!! "<<endl;
-            // }
-            //inside_pairs++;
-						
-						// TANGENTIAL COMPONENNT DIRECTION
-						// Fraser Eqn 3-167
-						// TODO - recalculate vr here too!
-            
-            //removed if, this is calculated always
-            tgvr = vr + delta_ * Particles[P2]->normal;  // -dot(vr,normal) * normal, FRASER 3-168
-            norm_tgvr = norm(tgvr);  
-            tgdir = tgvr / norm_tgvr;              
-            atg = Particles[P1] -> a - dot (Particles[P1] -> a,Particles[P2]->normal)*Particles[P2]->normal;
-            //ONCE SAVED atg, now can change acceleration by contact!
-
-						dt_fext = contact_force_factor * (Particles[P1]->Mass * 2. * norm(Particles[P1]->v) / norm (Particles[P1] -> contforce));
-
-						if (dt_fext < min_force_ts_){
-							min_force_ts_ = dt_fext;
-							if (dt_fext > 0)
-                omp_set_lock(&dom_lock);
-								this -> min_force_ts = min_force_ts_;
-                omp_unset_lock(&dom_lock);
-						}
-						omp_set_lock(&Particles[P1]->my_lock);
-						//Particles[P1] -> a += Particles[P1] -> contforce / Particles[P1] -> Mass; 
-            Particles[P1] -> a += Particles[P1] -> contforce / Particles[P1] -> Mass; 
-						omp_unset_lock(&Particles[P1]->my_lock);
-						//cout << "contforce "<<Particles[P1] -> contforce<<endl;
-            
-            fr_sta = friction_sta;
-            fr_dyn = friction_dyn;
-            if (friction_function == Linear)
-              fr_sta = fr_dyn = friction_m * Particles[P1] ->T + friction_b;
-
-             double dens = Particles[P1]->Density;
-             if (Dimension==3)
-              dS2 = pow(Particles[P1]->Mass/dens,2.0/3.0); //Fraser 3-119
-             else {
-               if (dom_bid_type == AxiSymmetric){
-                 // m= 2.0*pi*r *(s)*(s) , dens(ax) = 2. pi * r rho --> m/rho = 
-                 //BEFORE CONVERTING rho!!
-                  dS2 = sqrt(Particles[P1]->Mass/dens)*2.0*M_PI*Particles[P1]->x[0]; 
-                  //cout << "dS "<<sqrt(Particles[P1]->Mass/dens)<<endl;
-                  dens /= 2.0*M_PI* Particles[P1]->x[0]; //USED AFTER FOR FRICTION AND CONDUCTION (CALLED CONV)1
-                  
-
-               } else{
-                  dS2 = pow(Particles[i]->Mass/dens,1.0/3.0); //PLANE STRAIN
-               }
-             } 
-            
-            if (fr_sta > 0.) { 
- 
-                ////// DISPLACEMENT CRITERIA
-                //Wang2013, but applied to current step
-                du = x_pred - Particles[P1] ->x - Particles[P2] -> v * deltat ;
-                delta_tg = du - dot(du, Particles[P2]->normal)*Particles[P2]->normal;
-                tgforce = kij * delta_tg;
-
-               //if (ref_accel) ref_tg = atg * Particles[P1]->Mass;
-               //else           
-               ref_tg = tgforce;
-               //TODO: CHANGE DIMENSION !!!!!!
-                
-               if (norm(ref_tg) < fr_sta * norm(Particles[P1] -> contforce) ){ //STATIC; NO SLIP
-                  omp_set_lock(&Particles[P1]->my_lock);
-                    //if (P1 == 12415) cout << "ares (a - tgforce): "<<Particles[P1] -> a - tgforce<<endl;
-                    Particles[P1] -> contforce -= tgforce / Particles[P1]->Mass;
-                    Particles[P1] -> a -= tgforce / Particles[P1]->Mass;   
-                    // Particles[P1]->q_fric_work  = dot(tgforce,vr) * Particles[P1]->Density / Particles[P1]->Mass; //J/(m3.s)       
-                    // Particles[P1]->friction_hfl = dot(tgforce,vr) / dS2; //J/(m3.s)                    
-                  omp_unset_lock(&Particles[P1]->my_lock);
-                } else {
-                  tgforce_dyn = fr_dyn * norm(Particles[P1] -> contforce) * tgforce/norm(tgforce);
-                  omp_set_lock(&Particles[P1]->my_lock);
-                    Particles[P1] -> contforce -= tgforce_dyn;
-                    Particles[P1] -> a -= tgforce_dyn / Particles[P1]->Mass;
-                  omp_unset_lock(&Particles[P1]->my_lock);
-
-                  if (cont_heat_fric){
-                    //atg = Particles[P1] -> a - dot (Particles[P1] -> a,Particles[P2]->normal)*Particles[P2]->normal;                      
-                    omp_set_lock(&Particles[P1]->my_lock);
-                    abs_fv = abs(dot(tgforce_dyn,vr));
-                    Particles[P1]->q_fric_work  =  abs_fv * dens / Particles[P1]->Mass; //J/(m3.s)
-                    Particles[P1]->cshearabs = norm(tgforce_dyn) / dS2;
-                    Particles[P1]->friction_hfl = abs_fv / dS2; //J/(m3.s)
-                    // Particles[P1]->q_fric_work  = Particles[P1]->Mass * dot(atg, vr) * Particles[P1]->Density / Particles[P1]->Mass; //J/(m3.s)
-                    // Particles[P1]->friction_hfl = Particles[P1]->Mass * dot(atg,vr) / dS2;
-                    omp_unset_lock(&Particles[P1]->my_lock);
-                    //cout<< "fric work" <<Particles[P1]->q_fric_work<<endl;
-                    
-                  }
-                  // //if (P1 == 12415) cout << "SURPASSED, applying  " << friction_sta * norm(imp_force)* tgforce/norm(tgforce) <<endl;
-                }         
-
-
-            }//friction
-            
-            omp_set_lock(&dom_lock);            
-              contact_force_sum += norm(Particles[P1] ->contforce);
-              m_contact_force[m]+=Particles[P1] ->contforce;
-              //contact_force_sum_v += Particles[P1] ->contforce;
-              contact_reaction_sum += dot (Particles[P1] -> a,Particles[P2]->normal)* Particles[P1]->Mass;
-              //ext_forces_work_step += dot (Particles[P1] -> contforce,//Particles[P2]->v);
-              //ext_forces_work_step += /*dot(*/Particles[P1] -> contforce/*,1./norm(Particles[P2]->v)*Particles[P2]->v)*/ * Particles[P2]->v; //Assuming v2 and forces are parallel
-              ext_forces_work_step += dot(Particles[P1] -> contforce,Particles[P2]->v);
-            omp_unset_lock(&dom_lock);	
-
-            if (cont_heat_cond){//Contact thermal Conductance
-              //Fraser Eq 3.121
-              omp_set_lock(&Particles[P1]->my_lock);
-                Particles[P1]->q_cont_conv = dens * contact_hc * dS2 * (Particles[P2]->T - Particles[P1]->T) / Particles[P1]->Mass; //J/[m3.s]
-              omp_unset_lock(&Particles[P1]->my_lock);
-              
-              // omp_set_lock(&dom_lock);                             
-                // tot_cont_heat_cond[m] += contact_hc * dS2 * (Particles[P1]->T - Particles[P2]->T);
-              // omp_unset_lock(&dom_lock);	
-            }
-
-            
-					}// if inside
-        } //If distance is less than h
-    }//Contact Pairs
-    
-    //contact_force_sum = norm (contact_force_sum_v);
-	}//Nproc
+    P1 = cont_part[c];
+    x_pred = Particles[P1]->x + Particles[P1]->v * deltat + Particles[P1]->a * deltat * deltat/2.0;
+    for (int m=0;m<meshcount;m++){
+      P2 = ActiveContactElement(c, m, x_pred, dist);
+      if (P2 < 0) continue;
+      ContactForceWang(Particles[P1], Particles[P2]->normal, dist, Particles[P2]->v, Particles[P2]->T, x_pred, m, acc);
+    }//mesh
+	}//Contact particles
   //cout << "END CONTACT----------------------"<<endl;
 	max_contact_force = sqrt (max_contact_force);
 	//min_contact_force = sqrt (min_contact_force);
 	//cout << "Inside pairs count: "<<inside_geom<<", Inside time: "<<inside_time<<", statically restricted " << stra_restr<<endl;
 	int cont_force_count = 0;
 	
+  MergeContactAccum();
   ext_forces_work += ext_forces_work_step * deltat;
 
   // for (int m=0;m<meshcount;m++) 
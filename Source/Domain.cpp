@@ -28,6 +28,11 @@
 #define MIN_PS_FOR_NBSEARCH		1.e-6//TODO: MOVE TO CLASS MEMBER
 #define DELTA_PL_STRAIN 1.e-3
 #include <set>
+#include <new> //Placement new (PlaceParticles)
+#ifdef __linux__
+#include <sched.h>  //Thread affinity
+#include <unistd.h>
+#endif
 
 #include "LSDynaReader/src/lsdynaReader.h"
 
@@ -106,6 +111,8 @@ inline Domain::Domain ()
     deltat	= 0.0;
     deltatint	= 0.0;
     deltatmin	= 0.0;
+    min_ts_acc_part_id = min_ts_vel_part_id = -1;
+    m_nb_min_dist_valid = false;
     sqrt_h_a = 0.0025;
 
     TRPR = 0.0;
@@ -133,6 +140,29 @@ inline Domain::Domain ()
 	friction = 0.0;
 	update_contact_surface = true;
 	ts_nb_inc = 5;
+  nb_skin = 0.;
+  reorder_nb_inc = 0;
+  m_reorder_count = 0;
+  soa_kernels = false;
+  soa_live = false;
+  lockfree_sum = false;
+  fused_kernels = false;
+  simd_kernels = false;
+  m_accel_batch = AccelBatch_Scalar<sph_real>;
+  m_accel_batch_isa = "scalar";
+  gather_kernels = false;
+  kernel_table_res = 0;
+  m_gather_nb_valid = false;
+  pair_cache = false;
+  m_pair_cache_valid = false;
+  colored_sum = false;
+  numa_first_touch = false;
+  m_part_arena = NULL;
+  m_part_arena_np = 0;
+  m_ncolors = 0;
+  m_color_valid = false;
+  m_colored_pass = false;
+  async_output = false;
   fric_type = Fr_Dyn;
   m_contact_forces_time = 0.; //TODO: MOVE TO ANOTHER CLASS
   m_forces_artifvisc_time = 0.;
@@ -145,6 +175,8 @@ inline Domain::Domain ()
 	
 	thermal_solver = false;
   contact_mesh_auto_update = true;
+  bvh_contact = false;
+  sdf_cell = 0.;
   meshcount = 0;
   h_update = false;
   
@@ -176,6 +208,7 @@ inline Domain::Domain ()
 
 inline Domain::~Domain ()
 {
+	out_writer.Stop();
 	size_t Max = Particles.Size();
 	for (size_t i=1; i<=Max; i++)  Particles.DelItem(Max-i);
 }
@@ -191,6 +224,7 @@ inline void Domain::Kernel_Set(Kernels_Type const & KT)
 {
 	KernelType = KT;
 	if (KernelType==2) Cellfac = 3.0; else Cellfac = 2.0;
+	m_kernel.Set(Dimension, KernelType, kernel_table_res);
 }
 
 inline void Domain::Viscosity_Eq_Set(Viscosity_Eq_Type const & VQ)
@@ -238,63 +272,52 @@ inline void Domain::AdaptiveTimeStep()
 		// throw new Fatal("Too small time step, please choose a smaller time step initially to make the simulation more stable");
 }
 
-// inline void Domain::CheckMinTSVel() {
-  // //Min time step check based on velocity
-  // double test	= 0.0;
-  // double vmax;
-  // int i;
-  // deltatmin	= deltatint;
-  // #pragma omp parallel for schedule (static) private(test) num_threads(Nproc)
-  // for (int i=0; i<Particles.Size(); i++) {
-    // //if (Particles[i]->IsFree) {
-      // test = CFL * Particles[i]->h/(Particles[i]->Cs + norm(Particles[i]->v));
-      // if (deltatmin > test ) {
-        // vmax = norm(Particles[i]->v);
-        // omp_set_lock(&dom_lock);
-          // deltatmin = test;
-        // omp_unset_lock(&dom_lock);
-      // }
-    // //}
-  // }
-  // if (deltatmin<(deltatint/1.0e5)){
-    // cout << "Max vel: "<<vmax<<endl;
-  // }
-  // //cout << "deltatmin " << deltatmin<<endl;
-// }
-
-inline void Domain::CheckMinTSVel() {
-  //Min time step check based on velocity
-  double test	= 0.0;
-  double d,min;
-
-  deltatmin	= deltatint;
-  #pragma omp parallel for schedule (static) private(test,d,min) num_threads(Nproc)
+// // Minimum distance to the (Anei) neighbours. Only recalculated after the neighbour
+// lists change, not every time step
+inline void Domain::CalcNbMinDist() {
+  nb_min_dist.resize(Particles.Size());
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
   for (int i=0; i<Particles.Size(); i++) {
-    min = 1000.;
-    for (int n=0;n<ipair_SM[i];n++){
-      d = norm(Particles[Anei[i][n]]->x - Particles[i]->x);
-      //sum +=d;
+    double min = 1000.;
+    for (size_t n=Anei_start[i];n<Anei_start[i+1];n++){ //Both j > i and j < i neighbours
+      double d = norm(Particles[Anei[n]]->x - Particles[i]->x);
       if (  d<  min)
         min = d;
-      // if (d>max)
-        // max=d;
-    }
-    for (int n=0;n<jpair_SM[i];n++) {
-      d = norm(Particles[Anei[i][MAX_NB_PER_PART-1-n]]->x - Particles[i]->x);
-      //sum +=d;
-      if ( d <  min)
-        min = d;
-      // if (d>max)
-        // max = d;
-    }
-    test = CFL * min/(Particles[i]->Cs + norm(Particles[i]->v));
-    if (deltatmin > test ) {
-      omp_set_lock(&dom_lock);
-        deltatmin = test;
-      omp_unset_lock(&dom_lock);
     }
+    nb_min_dist[i] = min;
+  }
+  m_nb_min_dist_valid = true;
+}
 
+// Both checks are min reductions: each thread keeps its minimum and its particle in
+// locals and stores them once at the end (no shared cache line written in the loop),
+// then thread results are compared in order (lowest index wins a tie)
+inline void Domain::CheckMinTSVel() {
+  //Min time step check based on velocity
+  if (!m_nb_min_dist_valid || nb_min_dist.size() != Particles.Size()) CalcNbMinDist();
+  std::vector <double> tmin(Nproc,deltatint);
+  std::vector <int>    imin(Nproc,-1);
+  #pragma omp parallel num_threads(Nproc)
+  {
+    double tmin_ = deltatint;
+    int    imin_ = -1;
+    #pragma omp for schedule (static)
+    for (int i=0; i<Particles.Size(); i++) {
+      double test = CFL * nb_min_dist[i]/(Particles[i]->Cs + norm(Particles[i]->v));
+      if (test < tmin_) {
+        tmin_ = test;
+        imin_ = i;
+      }
+    }
+    tmin[omp_get_thread_num()] = tmin_;
+    imin[omp_get_thread_num()] = imin_;
   }
+  deltatmin	= deltatint;
+  for (int T=0; T<Nproc; T++)
+    if (tmin[T] < deltatmin) {
+      deltatmin = tmin[T];
+      min_ts_vel_part_id = imin[T];
+    }
   //cout << "deltatmin " << deltatmin<<endl;
 }
 
@@ -302,19 +325,29 @@ inline void Domain::CheckMinTSVel() {
 /////for Ductile Solid Continua
 ///// EBERHARD
 inline void Domain::CheckMinTSAccel () {
-		double test	= 0.0;
-		deltatmin	= deltatint;
-		#pragma omp parallel for schedule (static) private(test) num_threads(Nproc)
-		for (int i=0; i<Particles.Size(); i++) {
-        test = sqrt_h_a * sqrt(Particles[i]->h/norm(Particles[i]->a));
-					if (deltatmin > test ) {
-					omp_set_lock(&dom_lock);
-						deltatmin = test;
-            min_ts_acc_part_id = i;
-					omp_unset_lock(&dom_lock);
-				
-        }
-		}
+  std::vector <double> tmin(Nproc,deltatint);
+  std::vector <int>    imin(Nproc,-1);
+  #pragma omp parallel num_threads(Nproc)
+  {
+    double tmin_ = deltatint;
+    int    imin_ = -1;
+    #pragma omp for schedule (static)
+    for (int i=0; i<Particles.Size(); i++) {
+      double test = sqrt_h_a * sqrt(Particles[i]->h/norm(Particles[i]->a));
+      if (test < tmin_) {
+        tmin_ = test;
+        imin_ = i;
+      }
+    }
+    tmin[omp_get_thread_num()] = tmin_;
+    imin[omp_get_thread_num()] = imin_;
+  }
+  deltatmin	= deltatint;
+  for (int T=0; T<Nproc; T++)
+    if (tmin[T] < deltatmin) {
+      deltatmin = tmin[T];
+      min_ts_acc_part_id = imin[T];
+    }
   //cout << "deltatmin "<<deltatmin<<endl;
 }
 
@@ -359,9 +392,6 @@ inline void Domain::AddBoxLength(int tag, Vec3_t const & V, double Lx, double Ly
     double qin = 0.03;
     srand(100);
     double rho_0 = Density; /////AXISYMM
-		
-		//For new SOA accessing
-		std::vector <Vec3_t> x_sta;
 
     if (Dimension==3) {
     	if (type==0) {
@@ -385,7 +415,6 @@ inline void Domain::AddBoxLength(int tag, Vec3_t const & V, double Lx, double Ly
 						z = V(2) + ((2*sqrt(6.0)/3)*k+1)*r;
 						if (random) Particles.Push(new Particle(tag,Vec3_t((x + qin*r*double(rand())/RAND_MAX),(y+ qin*r*double(rand())/RAND_MAX),(z+ qin*r*double(rand())/RAND_MAX)),Vec3_t(0,0,0),0.0,Density,h,Fixed));
 						else    		{Particles.Push(new Particle(tag,Vec3_t(x,y,z),Vec3_t(0,0,0),0.0,Density,h,Fixed));
-													x_sta.push_back(Vec3_t(x,y,z));
 						}
 						i++;
 						if ((k%2!=0) && (j%2!=0)) xp = V(0) + (2*i+(j%2)+(k%2)-1)*r; else xp = V(0) + (2*i+(j%2)+(k%2)+1)*r;
@@ -419,7 +448,6 @@ inline void Domain::AddBoxLength(int tag, Vec3_t const & V, double Lx, double Ly
 						z = V(2) + (2.0*k+1)*r;
 						if (random) Particles.Push(new Particle(tag,Vec3_t((x + qin*r*double(rand())/RAND_MAX),(y+ qin*r*double(rand())/RAND_MAX),(z+ qin*r*double(rand())/RAND_MAX)),Vec3_t(0,0,0),0.0,Density,h,Fixed));
 						else    		Particles.Push(new Particle(tag,Vec3_t(x,y,z),Vec3_t(0,0,0),0.0,Density,h,Fixed));
-						x_sta.push_back(Vec3_t(x,y,z));
 						i++;
 						xp = V(0) + (2*i+1)*r; //COMMENTED BY LUCIANO
 						//cout << "X: "<<xp<<endl;
@@ -449,7 +477,6 @@ inline void Domain::AddBoxLength(int tag, Vec3_t const & V, double Lx, double Ly
 		
 		// New SOA members
 		cout << "Allocating "<<endl;
-		Initiate (&m_x,Particles.Size());
 		Initiate (&m_h,Particles.Size());
 		Initiate (&m_kT,Particles.Size());
 		Initiate (&m_cpT,Particles.Size());
@@ -476,7 +503,6 @@ inline void Domain::AddBoxLength(int tag, Vec3_t const & V, double Lx, double Ly
 		// m_mass 	= new double* [Particles.Size()];		
 		//TODO-> CHANGE TO static members (particle will be deleted)
 		for (int p=0;p<Particles.Size();p++){			
-			m_x[p] 		= &x_sta[p];
 			*m_rho[p] 	= Density; 
 			*m_T[p] = *m_Tinf[p] = *m_hcT[p] = *m_kT[p] = *m_qconvT[p] = 0.;
 			*m_mass[p] = Mass;
@@ -1231,7 +1257,7 @@ inline void Domain::MoveGhost(){
     // Particles[gi]-> Sigma    =     Particles[i]-> Sigma;
     // Particles[gi]-> Strain  =     Particles[i]-> Strain;
     // Particles[gi]-> Density  =     Particles[i]-> Density;
-
+		StoreSOA(gi, SOA_VEL | SOA_DENS | SOA_STRESS);
 	}
 }
 
@@ -1268,7 +1294,7 @@ inline void Domain::CorrectVelAcc(){  //For axil symm particles
         Particles[i]-> v(0) =Particles[i]-> v(1) = 0.;
         Particles[i]-> a(0) =Particles[i]-> a(1) = 0.;
       }
-
+      StoreSOA(i, SOA_VEL);
 
     }      
 }
@@ -1282,6 +1308,7 @@ inline void Domain::PropGhost(){
       Particles[gi]-> Density  =     Particles[i]-> Density;      
       Particles[gi]-> ShearStress  =     Particles[i]-> ShearStress;  
       Particles[gi]-> pl_strain = Particles[i]-> pl_strain; 
+      StoreSOA(gi, SOA_DENS | SOA_STRESS);
     }
   
 }
@@ -1436,6 +1463,7 @@ void Domain::CalculateSurface(const int &id){
 		Particles[i] -> normal = 0.;
 		Particles[i] -> ID = Particles [i] -> ID_orig;
 	}
+	bool pc = UsePairCache();
 
 	#pragma omp parallel for schedule (static) private(P1,P2,mi,mj,xij) num_threads(Nproc)
 	#ifdef __GNUC__
@@ -1448,6 +1476,10 @@ void Domain::CalculateSurface(const int &id){
 			//cout << "a: " << a << "p1: " << SMPairs[k][a].first << ", p2: "<< SMPairs[k][a].second<<endl;
 			P1	= Particles[SMPairs[k][a].first];
 			P2	= Particles[SMPairs[k][a].second];
+			if (pc) {
+        const PairGeom &g = pgeom[pgeom_off[k]+a];
+        xij = Vec3_t(g.xij[0], g.xij[1], g.xij[2]);
+      } else
 			xij	= P1->x - P2->x;
 						
 			mi = P1->Mass;
@@ -1556,7 +1588,7 @@ inline void Domain::StartAcceleration (Vec3_t const & a) {
 				{
 					Mat3_t Vec,Val,VecT,temp;
 					double pc_ti_inv_d2=Particles[i]->TI/(rho2);//Precompute some values
-					Rotation(Particles[i]->Sigma,Vec,VecT,Val);
+					Rotation(Particles[i]->Sigma.ToMat(),Vec,VecT,Val);
 					//Before
 					// if (Val(0,0)>0) Val(0,0) = -Particles[i]->TI * Val(0,0)/(Particles[i]->Density*Particles[i]->Density); else Val(0,0) = 0.0;
 					// if (Val(1,1)>0) Val(1,1) = -Particles[i]->TI * Val(1,1)/(Particles[i]->Density*Particles[i]->Density); else Val(1,1) = 0.0;
@@ -1621,7 +1653,7 @@ inline void Domain::PrimaryComputeAcceleration () {
 
 			Periodic_X_Correction(xij, h, Particles[P1], Particles[P2]);
 
-			K	= Kernel(Dimension, KernelType, norm(xij)/h, h);
+			K	= m_kernel.W(norm(xij)/h, h);
 			if ( !Particles[P1]->IsFree ) {
 				omp_set_lock(&Particles[P1]->my_lock);
 										Particles[P1]->SumKernel+= K;
@@ -1679,7 +1711,7 @@ inline void Domain::PrimaryComputeAcceleration () {
 				}
 				else {
 					Mat3_t Vec,Val,VecT,temp;
-					Rotation(Particles[a]->Sigma,Vec,VecT,Val);
+					Rotation(Particles[a]->Sigma.ToMat(),Vec,VecT,Val);
 					double pc_ti_inv_d2=Particles[a]->TI/(Particles[a]->Density*Particles[a]->Density);//Precompute some values
 					// if (Val(0,0)>0) Val(0,0) = -Particles[a]->TI * Val(0,0)/(Particles[a]->Density*Particles[a]->Density); else Val(0,0) = 0.0;
 					// if (Val(1,1)>0) Val(1,1) = -Particles[a]->TI * Val(1,1)/(Particles[a]->Density*Particles[a]->Density); else Val(1,1) = 0.0;
@@ -1692,6 +1724,7 @@ inline void Domain::PrimaryComputeAcceleration () {
 					Mult(temp,VecT,Particles[a]->TIR);
 				}
 			}
+			StoreSOA(a, SOA_STRESS);
 		}
 
   } 
@@ -1699,14 +1732,25 @@ inline void Domain::PrimaryComputeAcceleration () {
 
 inline void Domain::LastComputeAcceleration ()
 {
+	if (lockfree_sum) InitThreadAccum(TA_ALL);
+	int ncol = BeginPairSweeps(colored_sum && !lockfree_sum);
+	for (int col=0; col<ncol; col++)
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (int k=0; k<Nproc;k++) {
+		for (size_t q=ColorBegin(k,col); q<ColorEnd(k,col);q++) {
+			size_t i = ColorPair(q);
+			CalcForce2233(Particles[SMPairs[k][i].first],Particles[SMPairs[k][i].second],SMPairs[k][i].first,SMPairs[k][i].second);
+		}
+	}
+	EndPairSweeps();
+	
+	//Fixed-free pairs are not colored, always locked
 	#pragma omp parallel for schedule (static) num_threads(Nproc)
 	for (int k=0; k<Nproc;k++) {
-		for (size_t i=0; i<SMPairs[k].Size();i++)
-			CalcForce2233(Particles[SMPairs[k][i].first],Particles[SMPairs[k][i].second]);
-
 		for (int i=0; i<FSMPairs[k].Size();i++)
-			CalcForce2233(Particles[FSMPairs[k][i].first],Particles[FSMPairs[k][i].second]);
+			CalcForce2233(Particles[FSMPairs[k][i].first],Particles[FSMPairs[k][i].second],FSMPairs[k][i].first,FSMPairs[k][i].second);
 	}
+	if (lockfree_sum) ReduceThreadAccum(TA_ALL);
 	
   m_clock_begin = clock();
 	// CONTACT FORCES
@@ -1782,7 +1826,7 @@ void Domain::CalcKinEnergyEqn(){
 			di = Particles[P1]->Density; dj = Particles[P2]->Density;
 
 			h	= (Particles[P1]->h + Particles[P2]->h)/2.0;
-			GK	= GradKernel(Dimension, KernelType, norm(xij)/h, h);	
+			GK	= m_kernel.gradW(norm(xij)/h, h);	
 			
 			temp = 0.5 * mj*(Particles[P1]->Pressure/(di*di)+Particles[P2]->Pressure/(dj*dj))*
 							dot(vij,GK*xij);
@@ -1849,7 +1893,7 @@ inline void Domain::CalcGradCorrMatrix () {
 			P2	= Particles[SMPairs[k][a].second];
 			xij	= P1->x - P2->x;
 			h	= (P1->h+P2->h)/2.0;
-			GK	= GradKernel(Dimension, KernelType, norm(xij)/h, h);	
+			GK	= m_kernel.gradW(norm(xij)/h, h);	
 			
 			di = P1->Density; mi = P1->Mass;
 			dj = P2->Density; mj = P2->Mass;
@@ -1881,7 +1925,7 @@ inline void Domain::CalcGradCorrMatrix () {
 			P2	= Particles[FSMPairs[k][a].second];
 			xij	= P1->x - P2->x;
 			h	= (P1->h+P2->h)/2.0;
-			GK	= GradKernel(Dimension, KernelType, norm(xij)/h, h);	
+			GK	= m_kernel.gradW(norm(xij)/h, h);	
 			
 			di = P1->Density; mi = P1->Mass;
 			dj = P2->Density; mj = P2->Mass;
@@ -1966,8 +2010,8 @@ inline void Domain::CalcGradCorrMixedMatrix () {
 			P2	= Particles[SMPairs[k][a].second];
 			xij	= P1->x - P2->x;
 			h	= (P1->h+P2->h)/2.0;
-			GK	= GradKernel(Dimension, KernelType, norm(xij)/h, h);				
-      K	  =     Kernel(Dimension, KernelType, norm(xij)/h, h);
+			GK	= m_kernel.gradW(norm(xij)/h, h);				
+      K	  =     m_kernel.W(norm(xij)/h, h);
       
       sumden [i]+= mj/dj * K;
       sumden [j]-= mi/di * K;
@@ -2002,7 +2046,7 @@ inline void Domain::CalcGradCorrMixedMatrix () {
 			P2	= Particles[FSMPairs[k][a].second];
 			xij	= P1->x - P2->x;
 			h	= (P1->h+P2->h)/2.0;
-			GK	= GradKernel(Dimension, KernelType, norm(xij)/h, h);	
+			GK	= m_kernel.gradW(norm(xij)/h, h);	
 			
 			di = P1->Density; mi = P1->Mass;
 			dj = P2->Density; mj = P2->Mass;
@@ -2074,6 +2118,13 @@ inline void Domain::Move (double dt) {
 		}
 }
 
+//User callbacks write Particle fields directly (BC velocities, fixed 
+//particles), soa is reloaded before the next SOA kernel
+inline void Domain::CallGeneral(PtDom fn) {
+  (*fn)(*this);
+  if (fn != &General) soa_live = false;
+}
+
 inline void Domain::WholeVelocity() {
     //Apply a constant velocity to all particles in the initial time step
     if (norm(BC.allv)>0.0 || BC.allDensity>0.0) {
@@ -2091,6 +2142,7 @@ inline void Domain::WholeVelocity() {
 			Particles[i]->Pressure	= EOS(Particles[i]->PresEq, Particles[i]->Cs, Particles[i]->P0,Particles[i]->Density, Particles[i]->RefDensity);
     		}
     	}
+    	soa_live = false;
     }
 }
 
@@ -2102,6 +2154,12 @@ inline void Domain::InitialChecks() {
 		std::cout << "Please correct the dimension (2=>2D or 3=>3D) and run again" << std::endl;
 		abort();
 	}
+	m_kernel.Set(Dimension, KernelType, kernel_table_res); //Dimension may be changed after Kernel_Set
+	m_accel_batch = SelectAccelBatch(m_accel_batch_isa);
+	if (simd_kernels)
+		std::cout << "Batched acceleration kernel: " << m_accel_batch_isa << std::endl;
+	SetThreadAffinity(); //Before the first touch
+	if (numa_first_touch) PlaceParticles();
 
 	if (BC.InOutFlow>0 && BC.Periodic[0])
 		throw new Fatal("Periodic BC in the X direction cannot be used with In/Out-Flow BC simultaneously");
@@ -2112,6 +2170,58 @@ inline void Domain::InitialChecks() {
 			Particles[i]->Pressure = EOS(Particles[i]->PresEq, Particles[i]->Cs, Particles[i]->P0,Particles[i]->Density, Particles[i]->RefDensity);
 }
 
+// Particles are created one by one by the main thread, so on a multi socket node all
+// of them are on the first socket memory. Here they are moved to a block allocated 
+// without touching it (large blocks are mmap'ed) and each one is written by the thread 
+// that owns index i in the static schedule loops, so its pages go to that thread node.
+// Histories and B matrix are taken by the moved particle.
+// SOA fields and thread buffers are first written in parallel loops already.
+inline void Domain::PlaceParticles(){
+	int np = Particles.Size();
+	if (np == 0) return;
+	char *arena = static_cast<char*>(::operator new(np*sizeof(Particle)));
+	char *old = m_part_arena;
+	char *old_end = old + m_part_arena_np*sizeof(Particle);
+	
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (int i=0; i<np; i++){
+		Particle *P = Particles[i];
+		Particle *N = new (arena + i*sizeof(Particle)) Particle(std::move(*P));
+		omp_init_lock(&N->my_lock);
+		omp_destroy_lock(&P->my_lock);
+		if ((char*)P >= old && (char*)P < old_end) P->~Particle();
+		else delete P; //Not placed yet
+		Particles[i] = N;
+	}
+	if (old != NULL) ::operator delete(old);
+	ParticlePool().Trim(); //The moved particles blocks are empty now
+	m_part_arena = arena;
+	m_part_arena_np = np;
+}
+
+// "compact": thread t on cpu t, "spread": threads evenly strided over all cpus (both 
+// sockets). Thread pools are kept between parallel regions with the same num_threads, 
+// so each pinned thread keeps its particles. Linux only.
+inline void Domain::SetThreadAffinity(){
+	if (thread_affinity != "compact" && thread_affinity != "spread") return;
+#ifdef __linux__
+	int ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	int stride = (thread_affinity == "spread" && Nproc < ncpu) ? ncpu/Nproc : 1;
+	#pragma omp parallel num_threads(Nproc)
+	{
+		int t = omp_get_thread_num();
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET((t*stride) % ncpu, &set);
+		if (sched_setaffinity(0, sizeof(set), &set) != 0)
+			std::cout << "Thread " << t << " could not be pinned" << std::endl;
+	}
+	std::cout << "Threads pinned (" << thread_affinity << ")" << std::endl;
+#else
+	std::cout << "Thread affinity is only available on Linux" << std::endl;
+#endif
+}
+
 inline void Domain::TimestepCheck ()
 {
 	// Check the time step
@@ -2480,7 +2590,9 @@ inline void Domain::Solve (double tf, double dt, double dtOut, char const * TheF
 
 void ContactNbUpdate(SPH::Domain *dom){
   dom->CalculateSurface(1);				//After Nb search			
-  dom->ContactNbSearch();
+  if (dom->contact_alg == SDF) return;  //No contact pairs, surface only
+  if (dom->bvh_contact) dom->ContactBVHSearch();
+  else                  dom->ContactNbSearch();
   //cout << "Saving nb data"<<endl;
   dom->SaveContNeighbourData();	//Again Save Nb data
   //cout << "done "<<endl;
@@ -2505,7 +2617,7 @@ inline void Domain::UpdateSmoothingLength(){
       //cout << "htent " <<htent<<endl;
       if (htent > Particles[i]->hmin && htent<Particles[i]->hmax)
         Particles[i]->h = htent;  
-
+      StoreSOA(i, SOA_H);
   }
 }
 
@@ -2524,7 +2636,7 @@ inline void Domain::UpdateSmoothingLength(){
       // max = 0.;
       // //if (Particles[i]->pl_strain > DELTA_PL_STRAIN ){
       // for (int n=0;n<ipair_SM[i];n++){
-        // d = norm(Particles[Anei[i][n]]->x - Particles[i]->x);
+        // d = norm(Particles[Anei[Anei_start[i]+n]]->x - Particles[i]->x);
         // //sum +=d;
         // if (  d<  min)
           // min = d;
@@ -2532,7 +2644,7 @@ inline void Domain::UpdateSmoothingLength(){
           // // max=d;
       // }
       // for (int n=0;n<jpair_SM[i];n++) {
-        // d = norm(Particles[Anei[i][MAX_NB_PER_PART-1-n]]->x - Particles[i]->x);
+        // d = norm(Particles[Anei[Anei_start[i]+ipair_SM[i]+n]]->x - Particles[i]->x);
         // //sum +=d;
         // if ( d <  min)
           // min = d;
@@ -2565,7 +2677,7 @@ inline void Domain::UpdateSmoothingLength(){
       // max = 0.;
       // //if (Particles[i]->pl_strain > DELTA_PL_STRAIN ){
       // for (int n=0;n<ipair_SM[i];n++){
-        // dv = Particles[Anei[i][n]]->x - Particles[i]->x;
+        // dv = Particles[Anei[Anei_start[i]+n]]->x - Particles[i]->x;
         // d = dot(dv,dv);
         // //sum +=d;
         // if (  d >  max)
@@ -2574,7 +2686,7 @@ inline void Domain::UpdateSmoothingLength(){
           // // max=d;
       // }
       // for (int n=0;n<jpair_SM[i];n++) {
-        // dv = Particles[Anei[i][MAX_NB_PER_PART-1-n]]->x - Particles[i]->x;
+        // dv = Particles[Anei[Anei_start[i]+ipair_SM[i]+n]]->x - Particles[i]->x;
         // d = dot(dv,dv);
         // //sum +=d;
         // if ( d >  max)
@@ -32,6 +32,10 @@
 #include "Particle.h"
 #include "Functions.h"
 #include "Boundary_Condition.h"
+#include "ParticleSOA.h"
+#include "PairKernelSIMD.h"
+#include "ThreadAccum.h"
+#include "OutputWriter.h"
 
 //#ifdef _WIN32 /* __unix__ is usually defined by compilers targeting Unix systems */
 #include <sstream>
@@ -42,11 +46,11 @@
 
 #include "Mesh.h"
 #include "Plane.h"
+#include "ContactSDF.h"
 
 #include <fstream>
 
 //#define NONLOCK_SUM 
-#define MAX_NB_PER_PART 100
 
 enum domain_bid_type {PlaneStress=0, PlaneStrain=1, AxiSymmetric =2, AxiSymm_3D =2};
 
@@ -61,7 +65,7 @@ enum Damage_Model { None=0, Rankine=1 };
 enum Function_Type { Constant=0, Linear=1, Multilinear=2};
 
 enum Friction_Type{Fr_Sta=0,Fr_Dyn,Fr_StaDyn,Fr_Bound};
-enum Contact_Alg{Fraser=0, Wang, Seo, Zhan, LSDyna};
+enum Contact_Alg{Fraser=0, Wang, Seo, Zhan, LSDyna, SDF};
 
 namespace SPH {
   
@@ -90,6 +94,21 @@ namespace SPH {
 
 class NastranVolReader;
 
+//Full neighbour list entry (gather mode): neighbour, pair SMPairs[k][p] and 
+//side (0 if the particle is the first of the pair)
+struct GatherNb {
+  size_t j, p;
+  int k, side;
+  bool operator< (const GatherNb &b) const { return k < b.k || (k == b.k && p < b.p); }
+};
+
+//Pair geometry cache entry, for the orientation (first, second) of SMPairs
+struct PairGeom {
+  double xij[3];  //x_first - x_second
+  double rij, h;  //Distance and mean smoothing length
+  double GK, K;   //Kernel gradient factor and kernel
+};
+
 
 enum BC_TYPE {Velocity_BC=0, Force_BC, Temperature_BC, Convection_BC, Symmetry_BC};
 
@@ -159,11 +178,15 @@ public:
     void MainNeighbourSearch_CNS    (const double &r);  //NEW; ALLOWS TO SAVE DATA BY PARTICLE NBS (AND NOT LOCKING DOMAIN)
 		void MainNeighbourSearch_Ext		();									//Create pairs of particles in the whole domain
 		int AvgNeighbourCount						();									//Create pairs of particles in the whole domain
+    bool VerletNbUpdate             ();                 //Verlet list: search with skin radius only when needed, filter pairs every step
+    void ReorderParticles           ();                 //Sort solid particles along a Morton curve (memory locality)
+    void PlaceParticles             ();                 //NUMA first touch: particles copied to one block by the threads using them
+    void SetThreadAffinity          ();                 //Pins each OpenMP thread to a cpu (thread_affinity)
     
     void InitReductionArraysOnce();
     inline void ResetReductionArrays();
     inline void CalcPairPosList();                             //Calculate position list for every particle ipl/jpl[NProc][particle]
-    inline void CalcRefTable();
+    inline void PrefixSum(const std::vector<size_t> &count, std::vector<size_t> &start); //Parallel, start[i] = sum count[0..i-1]
     //For new reduction method
     inline void AccelReduction();
     inline void RateTensorsReduction();
@@ -178,20 +201,54 @@ public:
     void StartAcceleration					(Vec3_t const & a = Vec3_t(0.0,0.0,0.0));	//Add a fixed acceleration such as the Gravity
     void PrimaryComputeAcceleration	();									//Compute the solid boundary properties
     void LastComputeAcceleration		();									//Compute the acceleration due to the other particles
-    void CalcForce2233	(Particle * P1, Particle * P2);		//Calculates the contact force between soil-soil/solid-solid particles
+    void CalcForce2233	(Particle * P1, Particle * P2, const size_t &i1, const size_t &i2);		//Calculates the contact force between soil-soil/solid-solid particles
     void CalcAccel();		//NEW, ONLY CALCULATES ACCELERATION; IN ORDER TO ALTERNATE AND NOT CALCULATE Density at same place
     
-    ///// TEST FUNCTIONS FOR PARTICLE PARALLELIZATION
-    inline void CalcAccelPP(); //ONLY FOR TESTING, PARALLELIZATION BY PARTICLE
-    inline void CalcAccelPair(Particle * P1, Particle * P2);
-    inline void CalcRateTensorsPair (Particle *P1, Particle *P2);
+    ///// GATHER MODE, PARALLELIZATION BY PARTICLE (InteractionTest.cpp)
+    inline bool GatherKernels();
+    inline void BuildGatherNbList();
+    inline void CalcAccelPP();
+    inline void CalcAccelPair(Particle * P1, Particle * P2, const int &k, const size_t &p, const int &side, Vec3_t &acc);
+    inline void CalcRateTensorsPair (Particle *P1, Particle *P2, const int &k, const size_t &p, const int &side, Sym3_t &str, Skew3_t &rot);
     inline void CalcTensorsPP();
     inline void CalcDensPP();
-    inline void CalcDensIncPairs(Particle *P1, Particle *P2);
+    inline void CalcDensIncPairs(Particle *P1, Particle *P2, const int &k, const size_t &p, const int &side, double &drho);
+    //Pair geometry cache (Neighbour.cpp)
+    inline bool UsePairCache();
+    inline void BuildPairCache();
+    inline void GetPairGeom(const int &k, const size_t &p, const bool &swap, Vec3_t &xij, double &rij, double &h, double &GK, double &K);
     
     void CalcDensInc();
     void CalcRateTensors();
     void CalcForceSOA(int &i,int &j) ;
+    //SOA versions of the pair kernels, called from CalcAccel, CalcRateTensors and CalcDensInc
+    inline bool SOAKernels();
+    inline void LoadSOA();
+    inline void StoreSOA(const int &i, const int &fields); //SOA_Field mask
+    inline void CallGeneral(PtDom fn);  //Runs GeneralBefore/After, a user callback marks soa stale
+    inline void CalcAccelSOA();
+    inline void CalcRateTensorsSOA();
+    inline void CalcDensIncSOA();
+    //Batched (AVX2/AVX-512/scalar) acceleration pair kernel, see PairKernelSIMD.h
+    inline bool SIMDKernels();
+    inline void CalcAccelBatchSOA(const bool &lockfree);
+    //Lock free pair sum, per thread buffers reduced after the pair loop (see ThreadAccum.h)
+    inline bool LockFreeSum();
+    inline void InitThreadAccum(const int &fields);
+    inline void ReduceThreadAccum(const int &fields);
+    //Density increment and rate tensors in one pair pass (Nishimura reduction)
+    inline bool FusedKernels();
+    inline void CalcDensRateTensorsFused();
+    //Colored pair sweeps: no two pairs of a color share a particle, no locks (Neighbour.cpp)
+    inline bool ColoredSum();
+    inline void BuildPairColoring();
+    inline int  BeginPairSweeps(const bool &colored);
+    inline void EndPairSweeps();
+    inline size_t ColorBegin(const int &k, const int &col);
+    inline size_t ColorEnd  (const int &k, const int &col);
+    inline size_t ColorPair (const size_t &q);
+    inline void PairLock  (Particle *P);
+    inline void PairUnlock(Particle *P);
     void Move						(double dt);										//Move particles
 
   void Solve					(double tf, double dt, double dtOut, char const * TheFileKey, size_t maxidx);		///< The solving function
@@ -226,14 +283,17 @@ public:
     void Solve_wo_init (double tf, double dt, double dtOut, char const * TheFileKey, size_t maxidx);		///< The solving function	
 	//void Step(double tf, double dt, double dtOut, char const * TheFileKey, size_t maxidx);
 	
-    void CellInitiate		();															//Find the size of the domain as a cube, make cells and HOCs
-    void ListGenerate		();															//Generate linked-list
-    void CellReset			();															//Reset HOCs and particles' LL to initial value of -1
+    void CellInitiate		();															//Find the size of the domain as a cube, make cells and the flat cell grid
+    void ListGenerate		();															//Sort particles by cell (counting sort)
+    void CellReset			();															//Reset cell counts and fixed particles list
+    inline int CellIdx	(const int &i, const int &j, const int &k){return i + CellNo[0] * (j + CellNo[1] * k);} //Flat cell index
 	
 	void ClearNbData();	
 	
     void WriteXDMF			(char const * FileKey);					//Save a XDMF file for the visualization
     void WriteCSV				(char const * FileKey);					//Save a XDMF file for the visualization
+    void SubmitOutput		(OutputFrame &f);					//Write a staged frame (now or by the output thread)
+    void FlushOutput		();												//Wait for the pending asynchronous output
     
     void ReadXDMF			(char const * FileKey);	        //NEW, FOR RESTART
 
@@ -274,8 +334,23 @@ public:
   inline void CalcContactForcesAnalytic();
   inline void CalcContactForces2(); //Position criteria, SEO Contact detection
   inline void CalcContactForcesWang();
+  inline void ContactForceWang(Particle *P, const Vec3_t &n, const double &dist, const Vec3_t &vt, const double &Ttool,
+                               const Vec3_t &x_pred, const int &m, ContactAccum &acc);
+  inline void CalcContactForcesSDF(); //Tool signed distance fields, no contact pairs
+  inline void BuildContactSDF();
+  inline void SetContactSDFCylinder(const int &m, const Vec3_t &p, const Vec3_t &axis, const double &r);
+  std::vector <SignedDistField *> mesh_sdf;
+  double sdf_cell;                    //SDF grid spacing, 0: half the minimum solid h
   inline void CalcContactInitialGap();
   inline void UpdateContactParticles();  //Update position, velocity and normals FROM MESH
+  inline void UpdateContactParticle(const int &m, const int &e);
+  inline void UpdateContactPairElements(); //Rigid frame meshes: only the elements in ContPairs
+  inline void ZeroContactAccum();
+  inline void BuildContactCandidates();    //ContPairs grouped by SPH particle (cont_part, cont_elem)
+  inline bool InsideContactElement(const int &P2, const Vec3_t &qj);
+  inline int  ActiveContactElement(const int &c, const int &m, const Vec3_t &x_pred, double &dist);
+  std::vector <int> cont_part, cont_elem_start, cont_elem; //Contact candidates, one entry per SPH particle
+  inline void MergeContactAccum();         //Per thread contact totals to contact_force_sum, m_contact_force, ...
   
   inline void UpdateFrictionCoeff();
   
@@ -285,6 +360,9 @@ public:
   
   bool contact_mesh_auto_update;
   inline void ContactNbSearch();	//Performed AFTER neighbour search
+  inline void ContactBVHSearch();	//Contact pairs from the mesh element hierarchies (bvh_contact)
+  bool bvh_contact;               //Contact particles are left out of the cell grid, surface particles query the meshes
+  inline size_t GridParticleCount(){return ((bvh_contact || contact_alg == SDF) && meshcount > 0) ? first_fem_particle_idx[0] : Particles.Size();}
 	std::vector<int> contact_surf_id;						//particles id from surface
 
 	double contact_force_factor;
@@ -311,6 +389,19 @@ public:
   
   int ts_nb_inc;
   
+  //Verlet list (skin) neighbour reuse
+  double nb_skin;                 //Skin radius added to Cellfac*h in search, 0 if not used
+  std::vector <Vec3_t> x_nb;      //Positions at last skin search
+  std::vector <double> h_nb;      //Smoothing length at last skin search
+  Array<Array<std::pair<size_t,size_t> > >	SMPairs_nb, FSMPairs_nb, NSMPairs_nb; //Candidate pairs (within skin radius)
+  
+  int reorder_nb_inc;             //Particles are reordered (Morton) every this neighbour searches, 0 if not used
+  int m_reorder_count;
+  bool numa_first_touch;          //Particles placed by PlaceParticles at InitialChecks and after each reordering
+  std::string thread_affinity;    //"compact" or "spread", empty if threads are not pinned
+  char   *m_part_arena;           //Block holding the placed particles (Particles[i] points to the i-th one)
+  size_t  m_part_arena_np;
+  
   int solid_part_count;
   //TEST
   //Forces calculation time spent
@@ -327,6 +418,9 @@ public:
 		double 					min_force_ts;		//min time step size due to contact forces
     int             manual_min_ts;
     int             min_ts_acc_part_id;
+    int             min_ts_vel_part_id;
+    std::vector <double> nb_min_dist;   //Minimum neighbour distance of each particle, for CheckMinTSVel
+    bool            m_nb_min_dist_valid; //Computed once after each neighbour update
 		
     int 					  Dimension;    	///< Dimension of the problem
     domain_bid_type  dom_bid_type;    
@@ -361,7 +455,12 @@ public:
     Vec3_t                 			DomSize;	///< Each component of the vector is the domain size in that direction if periodic boundary condition is defined in that direction as well
     double					rhomax;
 
-    int						*** HOC;	///< Array of "Head of Chain" for each cell
+    //Flat cell grid, particles sorted by cell (replaces "Head of Chain" linked list)
+    std::vector <int>		cell_start;	///< [Cells] First position of each cell in cell_part
+    std::vector <int>		cell_count;	///< [Cells] Particle count of each cell
+    std::vector <int>		cell_part;	///< [Particles] Particle indices sorted by cell
+    std::vector <int>		part_cell;	///< [Particles] Flat cell index of each particle
+    std::vector <int>		cell_fill;	///< [Cells] Write position of each cell (parallel ListGenerate)
 
     bool					FSI;						///< Selecting variable to choose Fluid-Structure Interaction
 		int						contact_type;		//0: no contact 1: node to surface 2: node 2 node
@@ -427,14 +526,14 @@ public:
     std::vector < std::pair<int,int> >     pair_test,pair_ord;                    //OLY FOR TESTING
     //Array< Array <size_t> >               ilist_SM,jlist_SM;          // Size [Pairs] i and j particles of pair list [l], already flattened
     std::vector < size_t >                ipair_SM,jpair_SM;          //[Particles]// This is nb count for each particle i<j and j>i (called njgi) FLATTENED
-    std::vector < size_t >                ipl_SM;                     // [Particles] position of link/pair (nb sum), called s_jgi in 1991 paper
-    std::vector < std::vector <size_t>  > Aref;                      // Entry[Particle ,nb], indicates link
-    std::vector < std::vector <size_t>  > Anei;                      //[Particles][MAX_NB_PER_PART] neighbiour list for j > i
+    std::vector < size_t >                Anei_start;                 //[Particles+1] CSR row start of Anei and Aref, i<j entries first
+    std::vector < size_t >                Aref;                       //[Anei_start[N]] pair (link) of each entry
+    std::vector < size_t >                Anei;                       //[Anei_start[N]] neighbour of each entry
     std::vector <Vec3_t>                  pair_force;
     std::vector <double>                  temp_force;
     std::vector <double>                  pair_densinc;
-    std::vector <Mat3_t>                  pair_StrainRate;
-    std::vector <Mat3_t>                  pair_RotRate;    
+    std::vector <Sym3_t>                  pair_StrainRate;
+    std::vector <Skew3_t>                 pair_RotRate;    
     
     Array< size_t > 				FixedParticles;
     Array< size_t >				FreeFSIParticles;
@@ -449,7 +548,8 @@ public:
     String					OutputName[3];
 	double T_inf;			//LUCIANO: IN CASE OF ONLY ONE CONVECTION TEMPERAURE
 	
-	iKernel m_kernel;
+	iKernel m_kernel;        //Selected at InitialChecks from Dimension and KernelType
+	size_t kernel_table_res; //Kernel lookup table points per unit q, 0: evaluate the functors
 	bool					m_isNbDataCleared;
 	bool						auto_ts;				//LUCIANO: Auto Time Stepping: VEL CRITERIA
 	bool            auto_ts_acc;    
@@ -473,7 +573,6 @@ public:
 	Array<std::pair<size_t,size_t> > GhostPairs;	//If used
 	
 	/////////////////////// SOA (Since v0.4) ///////////////////////////////////
-	Vec3_t **m_x,*m_v,*m_a;
 	double **m_h;
 	double **m_T, **m_Tinf, **m_kT, **m_hcT, **m_cpT, **m_dTdt;
 	double **m_qconvT,**m_qT;	//thermal source terms 
@@ -483,11 +582,42 @@ public:
 	double *strrate,*rotrate;//all flattened, six component (rotation rate is upped matrix component, since it is antisymm)
 	double *shearstress,*shearstressa,*shearstressb;
 	double *strain,*straina,*strainb;
+  
+  ParticleSOA soa;  //Hot fields of the pair kernels, kept by StoreSOA (see ParticleSOA.h)
+  bool soa_live;    //soa loaded and current, false reloads it at the next SOA kernel
+  bool soa_kernels; //Use SOA kernels when there is no gradient correction, damage or axisymmetry
+  std::vector <ThreadAccum> tacc; //One per thread, lock free pair sum
+  std::vector <ContactAccum> cacc; //One per thread, contact totals
+  bool simd_kernels;  //Batched acceleration kernel for the common case (if SOA kernels)
+  AccelBatchFn m_accel_batch;       //Selected from CPU features at InitialChecks
+  const char * m_accel_batch_isa;
+  bool fused_kernels; //Single pair pass for density and rate tensors (if nonlock_sum)
+  bool lockfree_sum;  //Per thread buffers instead of particle locks (if not nonlock_sum)
+  bool gather_kernels;              //Per particle (gather) pair kernels, each pair computed twice
+  std::vector <size_t>    gnb_start;  //[Particles+1] CSR row start in gnb_list
+  std::vector <GatherNb>  gnb_list;   //Full neighbour list, rebuilt after each search
+  bool m_gather_nb_valid;
+  bool pair_cache;                  //Share pair geometry and kernel values between pair passes
+  std::vector <PairGeom>  pgeom;      //[pairs] in SMPairs order, pgeom[pgeom_off[k]+p]
+  std::vector <size_t>    pgeom_off;  //[Nproc]
+  std::vector <Vec3_t>    pgeom_x;    //Positions and smoothing lengths the cache was built with
+  std::vector <double>    pgeom_h;
+  bool m_pair_cache_valid;
+  bool colored_sum;                 //Pair passes as color sweeps without particle locks (if not nonlock_sum or lockfree_sum)
+  int  m_ncolors;
+  std::vector <size_t>    col_p;      //SMPairs[k] indices, grouped by thread and by color
+  std::vector <size_t>    col_start;  //[Nproc*(m_ncolors+1)] start of each color of each thread in col_p
+  bool m_color_valid;
+  bool m_colored_pass;              //Inside color sweeps, PairLock does nothing
+  
+  bool async_output;                //WriteXDMF and WriteCSV only gather, files are written by the output thread
+  OutputWriter out_writer;          //Double buffered staging frames
 	
   //////////////////////// NEW: IMPLICIT SOLVER FOR QUASI STATIC 
   inline void InitImplicitSolver();
   inline void CalcBMat();
   inline void CalcStiffMat();
+  inline void CalcNbMinDist();
   inline void CheckMinTSVel();
   inline void CheckMinTSAccel();
   inline void CalcDamage();
@@ -506,7 +636,7 @@ public:
   Vec3_t Domain::getBboxDims();
   
   private:
-		bool  Domain::CheckRadius(Particle* P1, Particle *P2);
+		bool  Domain::CheckRadius(Particle* P1, Particle *P2, const double &skin = 0.);
 		void Periodic_X_Correction	(Vec3_t & x, double const & h, Particle * P1, Particle * P2);		//Corrects xij for the periodic boundary condition
 		void AdaptiveTimeStep				();		//Uses the minimum time step to smoothly vary the time step
     
@@ -529,6 +659,7 @@ public:
 		bool enable_th_exp;
 		bool enable_plastic_heat_gen;
 		void AllocateNbPair(const int &temp1, const int &temp2, const int &T);
+		inline void AllocateCellPairs(const int &temp1, const int &cell, const int &T);	//temp1 against every particle in cell
     
 
 
@@ -349,33 +349,63 @@ namespace SPH {
 		}
 	}
 	
-	//NEW
-	iKernel::iKernel(size_t const & Dim,double const & h){
-	
-	m_inv_h=1./h;
-	
-	Dim ==2 ? m_w = 7.0/(478.0*h*h*M_PI) 		: m_w = 1.0/(120.0*h*h*h*M_PI);				//m_w
-	Dim ==2 ? m_gradw = 7.0/(478.0*h*h*h*M_PI) 	: m_gradw = 1.0/(120.0*h*h*h*h*M_PI);		//m_gradw
-	Dim ==2 ? m_lapw = 7.0/(478.0*h*h*h*h*M_PI) : m_lapw = 1.0/(120.0*h*h*h*h*h*M_PI);		//m_lapw
-		
+	inline void iKernel::Set(size_t const & Dim, size_t const & KT, size_t const & table_res){
+		m_dim = Dim;
+		switch (KT) {
+			case 0: if (Dim == 2) {m_W = &KernelFunctor<2,0>::W; m_gradW = &KernelFunctor<2,0>::GradW;}
+							else					{m_W = &KernelFunctor<3,0>::W; m_gradW = &KernelFunctor<3,0>::GradW;}
+							m_qmax = 2.0; break;
+			case 1: if (Dim == 2) {m_W = &KernelFunctor<2,1>::W; m_gradW = &KernelFunctor<2,1>::GradW;}
+							else					{m_W = &KernelFunctor<3,1>::W; m_gradW = &KernelFunctor<3,1>::GradW;}
+							m_qmax = 2.0; break;
+			case 2: if (Dim == 2) {m_W = &KernelFunctor<2,2>::W; m_gradW = &KernelFunctor<2,2>::GradW;}
+							else					{m_W = &KernelFunctor<3,2>::W; m_gradW = &KernelFunctor<3,2>::GradW;}
+							m_qmax = 3.0; break;
+			case 3: if (Dim == 2) {m_W = &KernelFunctor<2,3>::W; m_gradW = &KernelFunctor<2,3>::GradW;}
+							else					{m_W = &KernelFunctor<3,3>::W; m_gradW = &KernelFunctor<3,3>::GradW;}
+							m_qmax = 2.0; break;
+			default:
+				std::cout << "Kernel Type No is out of range. Please correct it and run again" << std::endl;
+				std::cout << "0 => Qubic Spline" << std::endl;
+				std::cout << "1 => Quintic" << std::endl;
+				std::cout << "2 => Quintic Spline" << std::endl;
+				std::cout << "3 => Hyperbolic Spline" << std::endl;
+				abort();
+				break;
+		}
+		m_tw.clear(); m_tqgw.clear();
+		if (table_res > 0) {
+			size_t n = size_t(m_qmax * table_res) + 2;
+			m_dq_inv = double(table_res);
+			m_tw.resize(n); m_tqgw.resize(n);
+			for (size_t i=0; i<n; i++) {
+				double q = double(i)/m_dq_inv;
+				m_tw[i]		= m_W(q,1.0);
+				m_tqgw[i]	= (i == 0) ? 0.0 : q * m_gradW(q,1.0); 
+			}
+			m_tqgw[0] = 2.0*m_tqgw[1] - m_tqgw[2]; //Extrapolated, q = 0 uses the functor
+		}
 	}
 	
-	inline double iKernel::W( double const & q ) {
-		if		(q<1.0)	return m_w*(pow((3.0-q),5.0)-6.0*pow((2.0-q),5.0)+15.0*pow((1.0-q),5.0));
-		else if (q<2.0)	return m_w*(pow((3.0-q),5.0)-6.0*pow((2.0-q),5.0));
-		else if (q<3.0)	return m_w*(pow((3.0-q),5.0));
-		else			return 0.0;
-		
+	//W(q,h) = W(q,1)/h^Dim, gradW(q,h) = gradW(q,1)/h^(Dim+2)
+	inline double iKernel::W( double const & q, double const & h ) const {
+		if (m_tw.empty())	return m_W(q,h);
+		if (q >= m_qmax)	return 0.0;
+		double x = q*m_dq_inv;
+		size_t i = size_t(x);
+		double f = x - double(i);
+		double hd = (m_dim == 2) ? h*h : h*h*h;
+		return ((1.0-f)*m_tw[i] + f*m_tw[i+1])/hd;
 	}
 	
-	inline double iKernel::gradW( double const & q ) {
-		if		(q==0.0)	return m_gradw*m_inv_h*    (20.0*pow((3.0-q),3.0)-120.0*pow((2.0-q),3.0)+300.0*pow((1.0-q),3.0));
-		else if (q<1.0)		return m_gradw*m_inv_h/q *(-5.0*pow((3.0-q),4.0)+30.0*pow((2.0-q),4.0)-75.0*pow((1.0-q),4.0));
-		else if (q<2.0)		return m_gradw*m_inv_h/q *(-5.0*pow((3.0-q),4.0)+30.0*pow((2.0-q),4.0));
-		else if (q<3.0)		return m_gradw*m_inv_h/q *(-5.0*pow((3.0-q),4.0));
-		else							return 0.0;		
-		
-		
+	inline double iKernel::gradW( double const & q, double const & h ) const {
+		if (m_tqgw.empty() || q == 0.0)	return m_gradW(q,h);
+		if (q >= m_qmax)	return 0.0;
+		double x = q*m_dq_inv;
+		size_t i = size_t(x);
+		double f = x - double(i);
+		double hd = (m_dim == 2) ? h*h*h*h : h*h*h*h*h;
+		return ((1.0-f)*m_tqgw[i] + f*m_tqgw[i+1])/(q*hd);
 	}
 
 	inline void Rotation (Mat3_t Input, Mat3_t & Vectors, Mat3_t & VectorsT, Mat3_t & Values)
@@ -22,6 +22,7 @@
 #define SPH_SPECIAL_FUNCTIONS_H
 
 #include "matvec.h"
+#include <vector>
 
 namespace SPH {
 
@@ -49,18 +50,98 @@ namespace SPH {
 	Mat3_t abab									(Mat3_t const & A, Mat3_t const & B);
 	
 	
-	//NEW
+	//////////////////////////////////////////////////////////////////////////
+	// Kernels specialized at compile time on dimension and type, with the   //
+	// normalization constant folded and powers written as products. q = r/h //
+	// GradW is dW/dr * 1/r, as GradKernel                                   //
+	//////////////////////////////////////////////////////////////////////////
+	template <int Dim> inline double HPow(double const & h) { return Dim == 2 ? h*h : h*h*h; }
+	
+	template <int Dim, int KT> struct KernelFunctor;
+	
+	template <int Dim> struct KernelFunctor<Dim,0> {	// Qubic Spline
+		static inline double C() { return Dim == 2 ? 10.0/(7.0*M_PI) : 1.0/M_PI; }
+		static inline double W(double const & q, double const & h) {
+			double C_h = C()/HPow<Dim>(h);
+			if 		(q<1.0)	return C_h*(1.0-1.5*q*q+0.75*q*q*q);
+			else if (q<2.0)	{double b = 2.0-q; return C_h*0.25*b*b*b;}
+			else			return 0.0;
+		}
+		static inline double GradW(double const & q, double const & h) {
+			double C_h = C()/(HPow<Dim>(h)*h);
+			if 		(q==0.0)	return -3.0*C_h/h;
+			else if (q<1.0)		return C_h/(q*h)*(-3.0*q+2.25*q*q);
+			else if (q<2.0)		{double b = 2.0-q; return C_h/(q*h)*(-0.75*b*b);}
+			else				return 0.0;
+		}
+	};
+	
+	template <int Dim> struct KernelFunctor<Dim,1> {	// Quintic
+		static inline double C() { return Dim == 2 ? 7.0/(4.0*M_PI) : 7.0/(8.0*M_PI); }
+		static inline double W(double const & q, double const & h) {
+			if (q<2.0) {double b = 1.0-0.5*q; b*=b; return C()/HPow<Dim>(h)*b*b*(2.0*q+1.0);}
+			else		return 0.0;
+		}
+		static inline double GradW(double const & q, double const & h) {
+			if (q<2.0) {double b = 1.0-0.5*q; return -5.0*C()/(HPow<Dim>(h)*h*h)*b*b*b;}
+			else		return 0.0;
+		}
+	};
+	
+	template <int Dim> struct KernelFunctor<Dim,2> {	// Quintic Spline
+		static inline double C() { return Dim == 2 ? 7.0/(478.0*M_PI) : 1.0/(120.0*M_PI); }
+		static inline double W(double const & q, double const & h) {
+			double a = 3.0-q, b = 2.0-q, c = 1.0-q;
+			double a5 = a*a*a*a*a, b5 = b*b*b*b*b, c5 = c*c*c*c*c;
+			double C_h = C()/HPow<Dim>(h);
+			if		(q<1.0)	return C_h*(a5-6.0*b5+15.0*c5);
+			else if (q<2.0)	return C_h*(a5-6.0*b5);
+			else if (q<3.0)	return C_h*a5;
+			else			return 0.0;
+		}
+		static inline double GradW(double const & q, double const & h) {
+			double a = 3.0-q, b = 2.0-q, c = 1.0-q;
+			double a4 = a*a*a*a, b4 = b*b*b*b, c4 = c*c*c*c;
+			double C_h = C()/(HPow<Dim>(h)*h);
+			if		(q==0.0)	return C_h/h*(20.0*27.0-120.0*8.0+300.0);
+			else if (q<1.0)		return C_h/(q*h)*(-5.0*a4+30.0*b4-75.0*c4);
+			else if (q<2.0)		return C_h/(q*h)*(-5.0*a4+30.0*b4);
+			else if (q<3.0)		return C_h/(q*h)*(-5.0*a4);
+			else				return 0.0;
+		}
+	};
+	
+	template <int Dim> struct KernelFunctor<Dim,3> {	// Hyperbolic Spline, Fraser, Eq 3-27
+		static inline double C() { return Dim == 2 ? 1.0/(3.0*M_PI) : 15.0/(62.0*M_PI); }
+		static inline double W(double const & q, double const & h) {
+			double C_h = C()/HPow<Dim>(h);
+			if		(q<1.0)	return C_h*(q*q*q-6.0*q+6.0);
+			else if (q<2.0)	{double b = 2.0-q; return C_h*b*b*b;}
+			else			return 0.0;
+		}
+		static inline double GradW(double const & q, double const & h) {
+			double C_h = C()/(HPow<Dim>(h)*h);
+			if		(q<1.0)	return C_h/(q*h)*(3.0*q*q-6.0);
+			else if (q<2.0)	{double b = 2.0-q; return C_h/(q*h)*(3.0*b*b-1.0);}
+			else			return 0.0;
+		}
+	};
+	
+	//Kernel selected once (Domain::InitialChecks), calls the specialized functor
+	//Optional lookup table (table_res points per unit of q) with linear interpolation
 	class iKernel{
-		public: //Ok TODO: Move members to private
-		iKernel(size_t const & Dim,double const & h);
-		iKernel(){}
-		virtual ~iKernel(){}
-		double gradW(double const & q);
-		double W(double const & q);
-		
-		double m_w,m_gradw,m_lapw,m_inv_h;	//Precomputed Kernel constants
-
+		public:
+		iKernel(){ Set(3,0); }
+		inline void Set(size_t const & Dim, size_t const & KT, size_t const & table_res = 0);
+		inline double W			(double const & q, double const & h) const;
+		inline double gradW	(double const & q, double const & h) const;
 		
+		private:
+		double (*m_W)			(double const &, double const &);
+		double (*m_gradW)	(double const &, double const &);
+		size_t m_dim;
+		std::vector<double> m_tw, m_tqgw;	//Table at h = 1: W and q*gradW (smooth at q = 0)
+		double m_dq_inv, m_qmax;
 	};
 
 }; // namespace SPH
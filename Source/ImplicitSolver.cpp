@@ -9,8 +9,7 @@ inline void Domain::InitImplicitSolver(){
   for (int i=0; i<Particles.Size(); i++)//Like in Domain::Move
   #endif
   {
-    Matrix *mat = new Matrix(6,3);
-    Particles[i]->m_B = *mat;
+    Particles[i]->BMat();
   }
 }
 inline void Domain::CalcBMat  (){
@@ -36,7 +35,7 @@ inline void Domain::CalcBMat  (){
 
 			dj = P2->Density;
 			mj = P2->Mass;    
-      double GK	= GradKernel(Dimension, KernelType, rij/h, h);
+      double GK	= m_kernel.gradW(rij/h, h);
       Vec3_t d_dx = GK * xij;
       
       omp_set_lock(&P1->my_lock);
@@ -4,6 +4,7 @@ namespace SPH {
 
 inline void Domain::InFlowBCFresh()
 {
+	soa_live = false; //Particles changed here, reloaded at the next SOA kernel
 	int temp, temp1;
 	int q1,q2,q3;
 	if (BC.inoutcounter == 0)
@@ -24,17 +25,14 @@ inline void Domain::InFlowBCFresh()
 			for (q3=0; BC.Periodic[2]? (q3<(CellNo[2]-2)) : (q3<CellNo[2]) ; q3++)
 			for (q1=0; q1<(temp1 + 1)                                      ; q1++)
 			{
-				if (HOC[q1][q2][q3]!=-1)
+				int cell = CellIdx(q1,q2,q3);
+				for (int n=cell_start[cell]; n<cell_start[cell]+cell_count[cell]; n++)
 				{
-					temp = HOC[q1][q2][q3];
-					while (temp != -1)
+					temp = cell_part[n];
+					if (Particles[temp]->IsFree && (Particles[temp]->x(0) <= BC.InFlowLoc1) )
 					{
-						if (Particles[temp]->IsFree && (Particles[temp]->x(0) <= BC.InFlowLoc1) )
-						{
-							BC.InPart.Push(temp);
-							Particles[temp]->InOut = 1;
-						}
-						temp = Particles[temp]->LL;
+						BC.InPart.Push(temp);
+						Particles[temp]->InOut = 1;
 					}
 				}
 			}
@@ -63,15 +61,12 @@ inline void Domain::InFlowBCFresh()
 		for (q3=0; BC.Periodic[2]? (q3<(CellNo[2]-2)) : (q3<CellNo[2]) ; q3++)
 		for (q1=0; q1<(temp1 + 1)                                      ; q1++)
 		{
-			if (HOC[q1][q2][q3]!=-1)
+			int cell = CellIdx(q1,q2,q3);
+			for (int n=cell_start[cell]; n<cell_start[cell]+cell_count[cell]; n++)
 			{
-				temp = HOC[q1][q2][q3];
-				while (temp != -1)
-				{
-					if (Particles[temp]->IsFree && (Particles[temp]->x(0) <= BC.InFlowLoc1) && Particles[temp]->InOut==1)
-						BC.InPart.Push(temp);
-					temp = Particles[temp]->LL;
-				}
+				temp = cell_part[n];
+				if (Particles[temp]->IsFree && (Particles[temp]->x(0) <= BC.InFlowLoc1) && Particles[temp]->InOut==1)
+					BC.InPart.Push(temp);
 			}
 		}
 		BC.inoutcounter = 2;
@@ -87,17 +82,14 @@ inline void Domain::InFlowBCFresh()
 		for (q3=0     ; BC.Periodic[2]? (q3<(CellNo[2]-2)) : (q3<CellNo[2]) ; q3++)
 		for (q1=temp1 ; q1<CellNo[0]                                        ; q1++)
 		{
-			if (HOC[q1][q2][q3]!=-1)
+			int cell = CellIdx(q1,q2,q3);
+			for (int n=cell_start[cell]; n<cell_start[cell]+cell_count[cell]; n++)
 			{
-				temp = HOC[q1][q2][q3];
-				while (temp != -1)
+				temp = cell_part[n];
+				if (Particles[temp]->IsFree && (Particles[temp]->x(0) >= BC.OutFlowLoc) )
 				{
-					if (Particles[temp]->IsFree && (Particles[temp]->x(0) >= BC.OutFlowLoc) )
-					{
-						BC.OutPart.Push(temp);
-						Particles[temp]->InOut = 2;
-					}
-					temp = Particles[temp]->LL;
+					BC.OutPart.Push(temp);
+					Particles[temp]->InOut = 2;
 				}
 			}
 		}
@@ -115,8 +107,11 @@ inline void Domain::InFlowBCFresh()
 			Particles[a]->vb = vel;
 			Particles[a]->va = vel;
 			Particles[a]->Density  = den;
-			Particles[a]->Densityb = den;
-			Particles[a]->Densitya = den;
+			if (Scheme == 1) {
+				Particles[a]->LeapfrogHist().Densityb = den;
+				Particles[a]->LeapfrogHist().Densitya = den;
+			} else
+				Particles[a]->VerletHist().Densityb = den;
     			Particles[a]->Pressure = EOS(Particles[a]->PresEq, Particles[a]->Cs, Particles[a]->P0,Particles[a]->Density, Particles[a]->RefDensity);
 		}
 
@@ -141,8 +136,11 @@ inline void Domain::InFlowBCFresh()
 			if (BC.outDensity>0.0)
 			{
 				Particles[a]->Density  = den;
-				Particles[a]->Densityb = den;
- 				Particles[a]->Densitya = den;
+				if (Scheme == 1) {
+					Particles[a]->LeapfrogHist().Densityb = den;
+					Particles[a]->LeapfrogHist().Densitya = den;
+				} else
+					Particles[a]->VerletHist().Densityb = den;
     				Particles[a]->Pressure = EOS(Particles[a]->PresEq, Particles[a]->Cs, Particles[a]->P0,Particles[a]->Density, Particles[a]->RefDensity);
 			}
 		}
@@ -150,6 +148,7 @@ inline void Domain::InFlowBCFresh()
 
 inline void Domain::InFlowBCLeave()
 {
+	soa_live = false; //Particles moved or removed
 	size_t a,b;
 	Array <int> DelPart,TempPart;
 	Array<std::pair<Vec3_t,size_t> > AddPart;
@@ -314,6 +313,7 @@ inline void Domain::InFlowBCLeave()
 
 inline void Domain::CheckParticleLeave ()
 {
+	soa_live = false; //Particles may be removed
 	Array <int> DelParticles;
 
 	#pragma omp parallel for schedule(static) num_threads(Nproc)
@@ -22,7 +22,7 @@
 
 namespace SPH {
 	
-inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
+inline void Domain::CalcForce2233(Particle * P1, Particle * P2, const size_t &i1, const size_t &i2)
 {
 	double h	= (P1->h+P2->h)/2;
 	Vec3_t xij	= P1->x - P2->x;
@@ -58,8 +58,8 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
 
 		Vec3_t vij	= P1->v - P2->v;
 		
-		double GK	= GradKernel(Dimension, KernelType, rij/h, h);
-		double K	= Kernel(Dimension, KernelType, rij/h, h);
+		double GK	= m_kernel.gradW(rij/h, h);
+		double K	= m_kernel.W(rij/h, h);
 		
 		// double GK	= m_kernel.gradW(rij/h);
 		// double K		= m_kernel.W(rij/h);
@@ -84,8 +84,8 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
 		Mat3_t Sigmaj,Sigmai;
 		set_to_zero(Sigmaj);
 		set_to_zero(Sigmai);
-		Sigmai = P1->Sigma;
-		Sigmaj = P2->Sigma;
+		Sigmai = P1->Sigma.ToMat();
+		Sigmaj = P2->Sigma.ToMat();
 
 //		if (P1->IsFree) Sigmai = P1->Sigma; else  Sigmai = P2->Sigma;
 //		if (P2->IsFree) Sigmaj = P2->Sigma; else  Sigmaj = P1->Sigma;
@@ -94,7 +94,7 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
 		Mat3_t TIij;
 		set_to_zero(TIij);
 		if (P1->TI > 0.0 || P2->TI > 0.0) 
-			TIij = pow((K/Kernel(Dimension, KernelType, (P1->TIInitDist + P2->TIInitDist)/(2.0*h), h)),(P1->TIn+P2->TIn)/2.0)*(P1->TIR+P2->TIR);
+			TIij = pow((K/m_kernel.W((P1->TIInitDist + P2->TIInitDist)/(2.0*h), h)),(P1->TIn+P2->TIn)/2.0)*(P1->TIR+P2->TIR);
 			//TIij = pow((K/m_kernel.W((P1->TIInitDist + P2->TIInitDist)/(2.0*h))),(P1->TIn+P2->TIn)/2.0)*(P1->TIR+P2->TIR);
 
 		// NoSlip BC velocity correction
@@ -113,7 +113,8 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
 			}
 		}
 
-		Mat3_t StrainRate,RotationRate;
+		Sym3_t  StrainRate;
+		Skew3_t RotationRate;
 		set_to_zero(StrainRate);
 		set_to_zero(RotationRate);
 		
@@ -135,20 +136,14 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
 			StrainRate(0,0) = 2.0*vab(0)*xij(0);
 			StrainRate(0,1) = vab(0)*xij(1)+vab(1)*xij(0);
 			StrainRate(0,2) = vab(0)*xij(2)+vab(2)*xij(0);
-			StrainRate(1,0) = StrainRate(0,1);
 			StrainRate(1,1) = 2.0*vab(1)*xij(1);
 			StrainRate(1,2) = vab(1)*xij(2)+vab(2)*xij(1);
-			StrainRate(2,0) = StrainRate(0,2);
-			StrainRate(2,1) = StrainRate(1,2);
 			StrainRate(2,2) = 2.0*vab(2)*xij(2);
 			StrainRate	= -0.5 * GK * StrainRate;
 			
-			RotationRate(0,1) = vab(0)*xij(1)-vab(1)*xij(0);
-			RotationRate(0,2) = vab(0)*xij(2)-vab(2)*xij(0);
-			RotationRate(1,2) = vab(1)*xij(2)-vab(2)*xij(1);
-			RotationRate(1,0) = -RotationRate(0,1);
-			RotationRate(2,0) = -RotationRate(0,2);
-			RotationRate(2,1) = -RotationRate(1,2);
+			RotationRate = Skew3_t(vab(0)*xij(1)-vab(1)*xij(0),   //01
+			                       vab(1)*xij(2)-vab(2)*xij(1),   //12
+			                       vab(0)*xij(2)-vab(2)*xij(0));  //02
 			RotationRate	  = -0.5 * GK * RotationRate;
 			
 			// if (StrainRate(2,2)<-1.e-3)
@@ -181,13 +176,19 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
 
 		// XSPH Monaghan
 		if (XSPH != 0.0  && (P1->IsFree*P2->IsFree)) {
-			omp_set_lock(&P1->my_lock);
+			if (lockfree_sum) {
+				ThreadAccum &T = tacc[omp_get_thread_num()];
+				T.vxsph[i1] += XSPH*mj/(0.5*(di+dj))*K*-vij;
+				T.vxsph[i2] += XSPH*mi/(0.5*(di+dj))*K*vij;
+			} else {
+			PairLock(P1);
 			P1->VXSPH += XSPH*mj/(0.5*(di+dj))*K*-vij;
-			omp_unset_lock(&P1->my_lock);
+			PairUnlock(P1);
 
-			omp_set_lock(&P2->my_lock);
+			PairLock(P2);
 			P2->VXSPH += XSPH*mi/(0.5*(di+dj))*K*vij;
-			omp_unset_lock(&P2->my_lock);
+			PairUnlock(P2);
+			}
 		}
 
 		// Calculating the forces for the particle 1 & 2
@@ -245,8 +246,34 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
 		}
     
     clock_begin = clock();
+		if (lockfree_sum) {
+			// Lock free: add to this thread buffers, reduced after the pair loop
+			ThreadAccum &T = tacc[omp_get_thread_num()];
+			T.a[i1]		+= mj * (!gradKernelCorr ? temp : temp_c[0]);
+			T.drho[i1]	+= mj * (di/dj) * (!gradKernelCorr ? temp1 : temp1_c[0]);
+			T.a[i2]		-= mi * (!gradKernelCorr ? temp : temp_c[1]);
+			T.drho[i2]	+= mi * (dj/di) * (!gradKernelCorr ? temp1 : temp1_c[1]);
+			if (P1->IsFree) {
+				float mj_dj= mj/dj;
+				T.zwab[i1]	+= mj_dj* K;
+				T.strrate[i1] += mj_dj * (!gradKernelCorr ? StrainRate : Sym3_t(StrainRate_c[0]));
+				T.rotrate[i1] += mj_dj * (!gradKernelCorr ? RotationRate : Skew3_t(RotationRate_c[0]));
+			} else
+				T.zwab[i1]	= 1.0;
+			if (P2->IsFree) {
+				float mi_di = mi/di;
+				T.zwab[i2]	+= mi_di* K;
+				T.strrate[i2] += mi_di * (!gradKernelCorr ? StrainRate : Sym3_t(StrainRate_c[1]));
+				T.rotrate[i2] += mi_di * (!gradKernelCorr ? RotationRate : Skew3_t(RotationRate_c[1]));
+			} else
+				T.zwab[i2]	= 1.0;
+			if (P1->Shepard && P1->ShepardCounter == P1->ShepardStep) T.sumden[i1] += mj* K;
+			if (P2->Shepard && P2->ShepardCounter == P2->ShepardStep) T.sumden[i2] += mi* K;
+			m_forces_update_time += (double)(clock() - clock_begin) / CLOCKS_PER_SEC;
+			return;
+		}
 		// Locking the particle 1 for updating the properties
-		omp_set_lock(&P1->my_lock);
+		PairLock(P1);
 			if (!gradKernelCorr){
 				P1->a					+= mj * temp;
 				P1->dDensity	+= mj * (di/dj) * temp1;
@@ -262,19 +289,12 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
 				float mj_dj= mj/dj;
 				P1->ZWab	+= mj_dj* K;
 				if (!gradKernelCorr){
-					#ifndef FLAT_TENSORS
 					P1->StrainRate 		= P1->StrainRate + mj_dj*StrainRate;
 					P1->RotationRate 	= P1->RotationRate + mj_dj*RotationRate;
-					#else 
-					Mat3_t temp = FromFlatSym (P1->strrate)+ mj_dj*StrainRate;
-					ToFlatSym(temp,P1 -> strrate);
-					temp = FromFlatAntiSymNullDiag(P1->rotrate) + mj_dj*RotationRate;
-					ToFlatSymNullDiag(temp,P1 -> rotrate); //is the same function
-					#endif
 				}
 				else {
-					P1->StrainRate 		= P1->StrainRate 		+ mj_dj * StrainRate_c[0];
-					P1->RotationRate 	= P1->RotationRate 	+ mj_dj * RotationRate_c[0];
+					P1->StrainRate 		= P1->StrainRate 		+ mj_dj * Sym3_t(StrainRate_c[0]);
+					P1->RotationRate 	= P1->RotationRate 	+ mj_dj * Skew3_t(RotationRate_c[0]);
 				}
 
 			}
@@ -284,10 +304,10 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
 			if (P1->Shepard)
 				if (P1->ShepardCounter == P1->ShepardStep)
 					P1->SumDen += mj*    K;
-		omp_unset_lock(&P1->my_lock);
+		PairUnlock(P1);
 
 		// Locking the particle 2 for updating the properties
-		omp_set_lock(&P2->my_lock);
+		PairLock(P2);
 			if (!gradKernelCorr){
 				P2->a					-= mi * temp;
 				P2->dDensity	+= mi * (dj/di) * temp1;							
@@ -301,18 +321,11 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
 				float mi_di = mi/di;
 				P2->ZWab	+= mi_di* K;
 				if (!gradKernelCorr){
-					#ifndef FLAT_TENSORS
           P2->StrainRate	 = P2->StrainRate + mi_di*StrainRate;
 					P2->RotationRate = P2->RotationRate + mi_di*RotationRate;
-					#else 
-					Mat3_t temp = FromFlatSym (P2->strrate)+ mi_di*StrainRate;
-					ToFlatSym(temp,P2 -> strrate);
-					temp = FromFlatAntiSymNullDiag(P2->rotrate) + mi_di*RotationRate;
-					ToFlatSymNullDiag(temp,P2 -> rotrate); //is the same function
-					#endif
 				} else {
-					P2->StrainRate = P2->StrainRate 		+ mi_di*StrainRate_c[1];
-					P2->RotationRate = P2->RotationRate + mi_di*RotationRate_c[1];
+					P2->StrainRate = P2->StrainRate 		+ mi_di*Sym3_t(StrainRate_c[1]);
+					P2->RotationRate = P2->RotationRate + mi_di*Skew3_t(RotationRate_c[1]);
 				}
 
 
@@ -324,7 +337,7 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
 				if (P2->ShepardCounter == P2->ShepardStep)
 					P2->SumDen += mi*    K;
 
-		omp_unset_lock(&P2->my_lock);
+		PairUnlock(P2);
  
 		//omp_set_lock(&dom_lock); //THIS CAUSES EXTREMELY LONG TIMES
     m_forces_update_time += (double)(clock() - clock_begin) / CLOCKS_PER_SEC;
@@ -332,6 +345,51 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
   //}//Interaction
 }
 
+// Lock free sum is used by CalcAccel, CalcRateTensors and CalcDensInc only if  
+// the table reduction (nonlock_sum) is not active; CalcForce2233 checks lockfree_sum
+inline bool Domain::LockFreeSum(){
+  return lockfree_sum && !nonlock_sum;
+}
+
+//Buffers are only grown here (first touch by their own thread), they are already zero
+inline void Domain::InitThreadAccum(const int &fields){
+  if (tacc.size() < Nproc) tacc.resize(Nproc);
+  size_t np = Particles.Size();
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+	#ifdef __GNUC__
+	for (size_t k=0; k<Nproc;k++) 
+	#else
+	for (int k=0; k<Nproc;k++) 
+	#endif	
+    tacc[k].Resize(np, fields);
+}
+
+//Adds the thread buffers to the particles and clears them for the next pass.
+//Non free particles with any pair get ZWab = 1, as in the locking sum
+inline void Domain::ReduceThreadAccum(const int &fields){
+  int nt = Nproc; //Only these buffers are sized by InitThreadAccum
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+  for (int i=0; i<Particles.Size(); i++){
+    Particle *P = Particles[i];
+    for (int t=0; t<nt; t++){
+      ThreadAccum &T = tacc[t];
+      if (fields & TA_ACCEL)   { P->a        += T.a[i];      T.a[i]    = 0.; }
+      if (fields & TA_DENSINC) { P->dDensity += T.drho[i];   T.drho[i] = 0.; }
+      if (fields & TA_RATES) {
+        P->StrainRate   += T.strrate[i];  set_to_zero(T.strrate[i]);
+        P->RotationRate += T.rotrate[i];  set_to_zero(T.rotrate[i]);
+      }
+      if (fields & TA_VXSPH)   { P->VXSPH    += T.vxsph[i];  T.vxsph[i] = 0.; }
+      if (fields & TA_ZWAB) {
+        if (P->IsFree)            P->ZWab += T.zwab[i];
+        else if (T.zwab[i] > 0.)  P->ZWab  = 1.0;
+        T.zwab[i] = 0.;
+      }
+      if (fields & TA_SUMDEN)  { P->SumDen   += T.sumden[i]; T.sumden[i] = 0.; }
+    }
+  }
+}
+
 
 
 }; // namespace SPH
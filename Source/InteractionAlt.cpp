@@ -10,9 +10,16 @@ namespace SPH{
   
   
 inline void Domain::CalcAccel() {
+  if (GatherKernels()) {CalcAccelPP(); return;}
+  if (SOAKernels()) {CalcAccelSOA(); return;}
   Particle *P1, *P2;
   double dam_f; //if not damage
+  bool lockfree = LockFreeSum();
+  bool pc = UsePairCache();
+  if (lockfree) InitThreadAccum(TA_ACCEL);
 	
+  int ncol = BeginPairSweeps(ColoredSum());
+  for (int col=0; col<ncol; col++)
   #pragma omp parallel for schedule (static) private (P1,P2,dam_f) num_threads(Nproc)
 	#ifdef __GNUC__
 	for (size_t k=0; k<Nproc;k++) 
@@ -20,7 +27,8 @@ inline void Domain::CalcAccel() {
 	for (int k=0; k<Nproc;k++) 
 	#endif	
 	{
-  for (size_t p=0; p<SMPairs[k].Size();p++) {
+  for (size_t q=ColorBegin(k,col); q<ColorEnd(k,col);q++) {
+    size_t p = ColorPair(q);
     
     //#ifndef NONLOCK_SUM
     if (!nonlock_sum){
@@ -32,12 +40,16 @@ inline void Domain::CalcAccel() {
     P2 = Particles[std::max(SMPairs[k][p].first, SMPairs[k][p].second)];
     //#endif
     }
-    double h	= (P1->h+P2->h)/2;
-    Vec3_t xij	= P1->x - P2->x;
-    dam_f = 1.0;
+    double h, rij, GK, K;
+    Vec3_t xij;
+    if (pc) GetPairGeom(k, p, nonlock_sum && SMPairs[k][p].first > SMPairs[k][p].second, xij, rij, h, GK, K);
+    else {
+    h	= (P1->h+P2->h)/2;
+    xij	= P1->x - P2->x;
     //Periodic_X_Correction(xij, h, P1, P2);
-
-    double rij	= norm(xij);
+    rij	= norm(xij);
+    }
+    dam_f = 1.0;
     
 		double di=0.0,dj=0.0,mi=0.0,mj=0.0;
 		double Alpha	= (P1->Alpha + P2->Alpha)/2.0;
@@ -59,8 +71,10 @@ inline void Domain::CalcAccel() {
     if (dam_f > 0.0) {
       if (dam_f > 1.0 ) dam_f = 1.0;
 		Vec3_t vij	= P1->v - P2->v;
-		double GK	= GradKernel(Dimension, KernelType, rij/h, h);
-		double K	= Kernel(Dimension, KernelType, rij/h, h);
+		if (!pc) {
+		GK	= m_kernel.gradW(rij/h, h);
+		K	= m_kernel.W(rij/h, h);
+		}
 		
 		// double GK	= m_kernel.gradW(rij/h);
 		// double K		= m_kernel.W(rij/h);
@@ -97,18 +111,19 @@ inline void Domain::CalcAccel() {
     Mat3_t Sigmaj,Sigmai;
     set_to_zero(Sigmaj);
     set_to_zero(Sigmai);
-    Sigmai = P1->Sigma;
-    Sigmaj = P2->Sigma;
+    Sigmai = P1->Sigma.ToMat();
+    Sigmaj = P2->Sigma.ToMat();
 
     // Tensile Instability
     Mat3_t TIij;
     set_to_zero(TIij);
     if (P1->TI > 0.0 || P2->TI > 0.0) {
       //cout << "P1->TIR" << P1->TIR<<endl;
-      TIij = pow((K/Kernel(Dimension, KernelType, (P1->TIInitDist + P2->TIInitDist)/(2.0*h), h)),(P1->TIn+P2->TIn)/2.0)*(P1->TIR+P2->TIR);
+      TIij = pow((K/m_kernel.W((P1->TIInitDist + P2->TIInitDist)/(2.0*h), h)),(P1->TIn+P2->TIn)/2.0)*(P1->TIR+P2->TIR);
       //TIij = pow((K/m_kernel.W((P1->TIInitDist + P2->TIInitDist)/(2.0*h))),(P1->TIn+P2->TIn)/2.0)*(P1->TIR+P2->TIR);
     }
-		Mat3_t StrainRate,RotationRate;
+		Sym3_t  StrainRate;
+		Skew3_t RotationRate;
 		set_to_zero(StrainRate);
 		set_to_zero(RotationRate);
 		
@@ -204,9 +219,13 @@ inline void Domain::CalcAccel() {
     // if (SMPairs[k][p].first == ID_TEST) cout << "-"<<endl;
     // else if (SMPairs[k][p].second == ID_TEST) cout << "+" <<endl;
     //#else  ////NONLOCK
-    else { 
+    else if (lockfree) {
+      ThreadAccum &T = tacc[k];
+      T.a[SMPairs[k][p].first]  += dam_f * mj * (!gradKernelCorr ? temp : temp_c[0]);
+      T.a[SMPairs[k][p].second] -= dam_f * mi * (!gradKernelCorr ? temp : temp_c[1]);
+    } else { 
 		// Locking the particle 1 for updating the properties
-		omp_set_lock(&P1->my_lock);
+		PairLock(P1);
 			if (!gradKernelCorr){
 				P1->a					+= dam_f*mj * temp;
 				//P1->dDensity	+= mj * (di/dj) * temp1;
@@ -215,26 +234,28 @@ inline void Domain::CalcAccel() {
 				//P1->dDensity	+= mj * (di/dj) * temp1_c[0];
 			}
 
-		omp_unset_lock(&P1->my_lock);
+		PairUnlock(P1);
 
 		// Locking the particle 2 for updating the properties
-		omp_set_lock(&P2->my_lock);
+		PairLock(P2);
 			if (!gradKernelCorr){
 				P2->a					-= dam_f * mi * temp;				
 			}else {
 				P2->a					-= dam_f * mi * temp_c[1];
 			}
-		omp_unset_lock(&P2->my_lock);
+		PairUnlock(P2);
     //#endif
     }//nonlock_sum
     
     }//dam_f
   }//MAIN FOR IN PAIR
   }//MAIN FOR PROC
-
+  EndPairSweeps();
+  if (lockfree) ReduceThreadAccum(TA_ACCEL);
 }
 
 inline void Domain::AccelReduction(){
+  bool soa_k = SOAKernels(); //Masses already loaded
   if (solid_part_count > 0){
     #pragma omp parallel for schedule (static) num_threads(Nproc)
     for (int i=0; i<solid_part_count;i++)
@@ -242,9 +263,13 @@ inline void Domain::AccelReduction(){
     #pragma omp parallel for schedule (static) num_threads(Nproc)
     for (int i=0; i<solid_part_count;i++){
       for (int n=0;n<ipair_SM[i];n++){  
-        Particles[i]->a += Particles[Anei[i][n]]->Mass * pair_force[Aref[i][n]];}
+        int j = Anei[Anei_start[i]+n];
+        double mj = soa_k ? soa.mass[j] : Particles[j]->Mass;
+        Particles[i]->a += mj * pair_force[Aref[Anei_start[i]+n]];}
       for (int n=0;n<jpair_SM[i];n++){   
-        Particles[i]->a -= Particles[Anei[i][MAX_NB_PER_PART-1-n]]->Mass * pair_force[Aref[i][MAX_NB_PER_PART-1-n]];}    
+        int j = Anei[Anei_start[i]+ipair_SM[i]+n];
+        double mj = soa_k ? soa.mass[j] : Particles[j]->Mass;
+        Particles[i]->a -= mj * pair_force[Aref[Anei_start[i]+ipair_SM[i]+n]];}    
     }
     if (dom_bid_type == AxiSymmetric){
       //ADD HOOP ACCEL AND MULT BY 2PI
@@ -261,7 +286,14 @@ inline void Domain::AccelReduction(){
 
 //Similar but not densities
 inline void Domain::CalcRateTensors() {
+  if (GatherKernels()) {CalcTensorsPP(); return;}
+  if (SOAKernels()) {CalcRateTensorsSOA(); return;}
   Particle *P1, *P2;          
+  bool lockfree = LockFreeSum();
+  bool pc = UsePairCache();
+  if (lockfree) InitThreadAccum(TA_RATES);
+  int ncol = BeginPairSweeps(ColoredSum());
+  for (int col=0; col<ncol; col++)
 	#pragma omp parallel for schedule (static) private (P1,P2) num_threads(Nproc)
 	#ifdef __GNUC__
 	for (size_t k=0; k<Nproc;k++) 
@@ -269,7 +301,8 @@ inline void Domain::CalcRateTensors() {
 	for (int k=0; k<Nproc;k++) 
 	#endif	
 	{
-  for (size_t p=0; p<SMPairs[k].Size();p++) {
+  for (size_t q=ColorBegin(k,col); q<ColorEnd(k,col);q++) {
+    size_t p = ColorPair(q);
     //#ifndef NONLOCK_SUM
     if (!nonlock_sum){
     P1	= Particles[SMPairs[k][p].first];
@@ -280,12 +313,15 @@ inline void Domain::CalcRateTensors() {
     P2 = Particles[std::max(SMPairs[k][p].first, SMPairs[k][p].second)];
     //#endif
     }
-    double h	= (P1->h+P2->h)/2;
-    Vec3_t xij	= P1->x - P2->x;
-
+    double h, rij, GK, K;
+    Vec3_t xij;
+    if (pc) GetPairGeom(k, p, nonlock_sum && SMPairs[k][p].first > SMPairs[k][p].second, xij, rij, h, GK, K);
+    else {
+    h	= (P1->h+P2->h)/2;
+    xij	= P1->x - P2->x;
 	//Periodic_X_Correction(xij, h, P1, P2);
-
-	double rij	= norm(xij);
+    rij	= norm(xij);
+    }
 
   double clock_begin;
 
@@ -304,19 +340,22 @@ inline void Domain::CalcRateTensors() {
     int i1 = std::min(SMPairs[k][p].first, SMPairs[k][p].second);
 		int i2 = std::max(SMPairs[k][p].first, SMPairs[k][p].second);
     
-		double GK	= GradKernel(Dimension, KernelType, rij/h, h);
-		double K	= Kernel(Dimension, KernelType, rij/h, h);
+		if (!pc) {
+		GK	= m_kernel.gradW(rij/h, h);
+		K	= m_kernel.W(rij/h, h);
+		}
 
 		Mat3_t Sigmaj,Sigmai;
 		set_to_zero(Sigmaj);
 		set_to_zero(Sigmai);
-		Sigmai = P1->Sigma;
-		Sigmaj = P2->Sigma;
+		Sigmai = P1->Sigma.ToMat();
+		Sigmaj = P2->Sigma.ToMat();
 
 		// NoSlip BC velocity correction
 		Vec3_t vab = vij;
 
-		Mat3_t StrainRate,RotationRate;
+		Sym3_t  StrainRate;
+		Skew3_t RotationRate;
 		set_to_zero(StrainRate);
 		set_to_zero(RotationRate);
 		
@@ -338,26 +377,20 @@ inline void Domain::CalcRateTensors() {
     StrainRate(0,0) = 2.0*vab(0)*xij(0);
     StrainRate(0,1) = vab(0)*xij(1)+vab(1)*xij(0);
     StrainRate(0,2) = vab(0)*xij(2)+vab(2)*xij(0);
-    StrainRate(1,0) = StrainRate(0,1);
     StrainRate(1,1) = 2.0*vab(1)*xij(1);
     StrainRate(1,2) = vab(1)*xij(2)+vab(2)*xij(1);
     // if (dom_bid_type == AxiSymmetric){
       // StrainRate(0,2) = StrainRate(1,2) = 0.;
       // RotationRate(0,2) = RotationRate(1,2) = 0.;
     // }
-    StrainRate(2,0) = StrainRate(0,2);
-    StrainRate(2,1) = StrainRate(1,2);
     StrainRate(2,2) = 2.0*vab(2)*xij(2);
     StrainRate	= -0.5 * GK * StrainRate;
     
 
     
-    RotationRate(0,1) = vab(0)*xij(1)-vab(1)*xij(0);
-    RotationRate(0,2) = vab(0)*xij(2)-vab(2)*xij(0);
-    RotationRate(1,2) = vab(1)*xij(2)-vab(2)*xij(1);
-    RotationRate(1,0) = -RotationRate(0,1);
-    RotationRate(2,0) = -RotationRate(0,2);
-    RotationRate(2,1) = -RotationRate(1,2);
+    RotationRate = Skew3_t(vab(0)*xij(1)-vab(1)*xij(0),   //01
+                           vab(1)*xij(2)-vab(2)*xij(1),   //12
+                           vab(0)*xij(2)-vab(2)*xij(0));  //02
     RotationRate	  = -0.5 * GK * RotationRate;
     
 			// if (StrainRate(2,2)<-1.e-3)
@@ -410,8 +443,17 @@ inline void Domain::CalcRateTensors() {
     pair_StrainRate[first_pair_perproc[k] + p] = StrainRate; //SHOULD ALSO MULTIPLY ACCEL AFTER
     pair_RotRate[first_pair_perproc[k] + p] = RotationRate; //SHOULD ALSO MULTIPLY ACCEL AFTER
     //#else
+    } else if (lockfree) {
+      ThreadAccum &T = tacc[k];
+      size_t i = SMPairs[k][p].first, j = SMPairs[k][p].second;
+      float mj_dj= mj/dj;
+      float mi_di = mi/di;
+      T.strrate[i] += mj_dj * (!gradKernelCorr ? StrainRate   : Sym3_t (StrainRate_c[0]));
+      T.rotrate[i] += mj_dj * (!gradKernelCorr ? RotationRate : Skew3_t(RotationRate_c[0]));
+      T.strrate[j] += mi_di * (!gradKernelCorr ? StrainRate   : Sym3_t (StrainRate_c[1]));
+      T.rotrate[j] += mi_di * (!gradKernelCorr ? RotationRate : Skew3_t(RotationRate_c[1]));
     } else {
-		omp_set_lock(&P1->my_lock);
+		PairLock(P1);
 
       float mj_dj= mj/dj;
 
@@ -420,46 +462,51 @@ inline void Domain::CalcRateTensors() {
         P1->RotationRate 	= P1->RotationRate + mj_dj*RotationRate;
       }
       else {
-        P1->StrainRate 		= P1->StrainRate 		+ mj_dj * StrainRate_c[0];
-        P1->RotationRate 	= P1->RotationRate 	+ mj_dj * RotationRate_c[0];
+        P1->StrainRate 		= P1->StrainRate 		+ mj_dj * Sym3_t(StrainRate_c[0]);
+        P1->RotationRate 	= P1->RotationRate 	+ mj_dj * Skew3_t(RotationRate_c[0]);
       }
 
-		omp_unset_lock(&P1->my_lock);
+		PairUnlock(P1);
 
 		// Locking the particle 2 for updating the properties
-		omp_set_lock(&P2->my_lock);
+		PairLock(P2);
 	
       float mi_di = mi/di;
       if (!gradKernelCorr){
         P2->StrainRate	 = P2->StrainRate + mi_di*StrainRate;
         P2->RotationRate = P2->RotationRate + mi_di*RotationRate;
       } else {
-        P2->StrainRate = P2->StrainRate 		+ mi_di*StrainRate_c[1];
-        P2->RotationRate = P2->RotationRate + mi_di*RotationRate_c[1];
+        P2->StrainRate = P2->StrainRate 		+ mi_di*Sym3_t(StrainRate_c[1]);
+        P2->RotationRate = P2->RotationRate + mi_di*Skew3_t(RotationRate_c[1]);
       }
 
-		omp_unset_lock(&P2->my_lock);
+		PairUnlock(P2);
     //#endif
     }//nonlock_sum
     }//FOR PAIRS
   }//FOR NPROC
+  EndPairSweeps();
+  if (lockfree) ReduceThreadAccum(TA_RATES);
 }
 
 
 // TODO: TEMPLATIZE, at least by type, by Reduction double, 
 inline void Domain::RateTensorsReduction(){
+  bool soa_k = SOAKernels() && !FusedKernels(); //Masses and densities already loaded
   //Not necesay to set to zero here. Are in domain
   #pragma omp parallel for schedule (static) num_threads(Nproc)
   for (int i=0; i<solid_part_count;i++){
     for (int n=0;n<ipair_SM[i];n++){    
-      double mjdj = Particles[Anei[i][n]]->Mass /Particles[Anei[i][n]]->Density;
-      Particles[i]->StrainRate    = Particles[i]->StrainRate   + mjdj * pair_StrainRate[Aref[i][n]];
-      Particles[i]->RotationRate  = Particles[i]->RotationRate + mjdj * pair_RotRate[Aref[i][n]];      
+      int j = Anei[Anei_start[i]+n];
+      double mjdj = soa_k ? soa.mass[j]/soa.rho[j] : Particles[j]->Mass /Particles[j]->Density;
+      Particles[i]->StrainRate    = Particles[i]->StrainRate   + mjdj * pair_StrainRate[Aref[Anei_start[i]+n]];
+      Particles[i]->RotationRate  = Particles[i]->RotationRate + mjdj * pair_RotRate[Aref[Anei_start[i]+n]];      
     }
     for (int n=0;n<jpair_SM[i];n++){   
-      double mjdj = Particles[Anei[i][MAX_NB_PER_PART-1-n]]->Mass / Particles[Anei[i][MAX_NB_PER_PART-1-n]]->Density;
-      Particles[i]->StrainRate    = Particles[i]->StrainRate   + mjdj * pair_StrainRate[Aref[i][MAX_NB_PER_PART-1-n]];
-      Particles[i]->RotationRate  = Particles[i]->RotationRate + mjdj * pair_RotRate[Aref[i][MAX_NB_PER_PART-1-n]];
+      int j = Anei[Anei_start[i]+ipair_SM[i]+n];
+      double mjdj = soa_k ? soa.mass[j]/soa.rho[j] : Particles[j]->Mass / Particles[j]->Density;
+      Particles[i]->StrainRate    = Particles[i]->StrainRate   + mjdj * pair_StrainRate[Aref[Anei_start[i]+ipair_SM[i]+n]];
+      Particles[i]->RotationRate  = Particles[i]->RotationRate + mjdj * pair_RotRate[Aref[Anei_start[i]+ipair_SM[i]+n]];
     } 
   }
 
@@ -472,7 +519,7 @@ inline void Domain::RateTensorsReduction(){
         else                          psi = -0.01 * Particles[i]->h;
         Particles[i]->StrainRate(2,2) = Particles[i]->v(0)/(psi + Particles[i]->x(0)); //DIRECT HOOP STRAIN RATE, Wang 2015
         Particles[i]->StrainRate(0,2) = 0.0; Particles[i]->StrainRate(2,0) = 0.0;
-         Particles[i]->RotationRate(0,2) = 0.0; Particles[i]->RotationRate(2,0) = 0.0;
+         Particles[i]->RotationRate.d[2] = 0.0; //02
       //}    
     }
   }
@@ -481,8 +528,15 @@ inline void Domain::RateTensorsReduction(){
 
 // TODO: USED CALCULATED KERNELKS
 inline void Domain::CalcDensInc() {
+  if (GatherKernels()) {CalcDensPP(); return;}
+  if (SOAKernels()) {CalcDensIncSOA(); return;}
 	double dam_f;
   Particle *P1, *P2;
+  bool lockfree = LockFreeSum();
+  bool pc = UsePairCache();
+  if (lockfree) InitThreadAccum(TA_DENSINC);
+  int ncol = BeginPairSweeps(ColoredSum());
+  for (int col=0; col<ncol; col++)
 	#pragma omp parallel for schedule (static) private (P1,P2,dam_f) num_threads(Nproc)
 	#ifdef __GNUC__
 	for (size_t k=0; k<Nproc;k++) 
@@ -490,7 +544,8 @@ inline void Domain::CalcDensInc() {
 	for (int k=0; k<Nproc;k++) 
 	#endif	
 	{
-    for (size_t p=0; p<SMPairs[k].Size();p++) {
+    for (size_t q=ColorBegin(k,col); q<ColorEnd(k,col);q++) {
+      size_t p = ColorPair(q);
       if (!nonlock_sum){
       //#ifndef NONLOCK_SUM
       P1	= Particles[SMPairs[k][p].first];
@@ -502,12 +557,15 @@ inline void Domain::CalcDensInc() {
       //#endif
       }
       dam_f = 1.0;
-      double h	= (P1->h+P2->h)/2;
-      Vec3_t xij	= P1->x - P2->x;
-
+      double h, rij, GK, K;
+      Vec3_t xij;
+      if (pc) GetPairGeom(k, p, nonlock_sum && SMPairs[k][p].first > SMPairs[k][p].second, xij, rij, h, GK, K);
+      else {
+      h	= (P1->h+P2->h)/2;
+      xij	= P1->x - P2->x;
       //Periodic_X_Correction(xij, h, P1, P2);
-
-      double rij	= norm(xij);
+      rij	= norm(xij);
+      }
 
       // if ((rij/h)<=Cellfac)
       // {
@@ -521,8 +579,10 @@ inline void Domain::CalcDensInc() {
 
       Vec3_t vij	= P1->v - P2->v;
       
-      double GK	= GradKernel(Dimension, KernelType, rij/h, h);
-      double K	= Kernel(Dimension, KernelType, rij/h, h);
+      if (!pc) {
+      GK	= m_kernel.gradW(rij/h, h);
+      K	= m_kernel.W(rij/h, h);
+      }
     
       //NEW
       Mat3_t GKc[2];
@@ -564,42 +624,49 @@ inline void Domain::CalcDensInc() {
       if (nonlock_sum)
         pair_densinc[first_pair_perproc[k] + p] = temp1;
       //#else
-      else {
+      else if (lockfree) {
+        ThreadAccum &T = tacc[k];
+        //Axisymmetric: density is 2*PI*r*rho, WANG EQN 56 (no density ratio)
+        double fi = (dom_bid_type != AxiSymmetric) ? di/dj : 1.0;
+        double fj = (dom_bid_type != AxiSymmetric) ? dj/di : 1.0;
+        T.drho[SMPairs[k][p].first]  += dam_f * mj * fi * (!gradKernelCorr ? temp1 : temp1_c[0]);
+        T.drho[SMPairs[k][p].second] += dam_f * mi * fj * (!gradKernelCorr ? temp1 : temp1_c[1]);
+      } else {
       // Locking the particle 1 for updating the properties
       if (dom_bid_type != AxiSymmetric) {
-      omp_set_lock(&P1->my_lock);
+      PairLock(P1);
         if (!gradKernelCorr){
           P1->dDensity	+= dam_f * mj * (di/dj) * temp1;
         } else{
           P1->dDensity	+= dam_f *mj * (di/dj) * temp1_c[0];
         }		
-      omp_unset_lock(&P1->my_lock);
+      PairUnlock(P1);
 
       // Locking the particle 2 for updating the properties
-      omp_set_lock(&P2->my_lock);
+      PairLock(P2);
         if (!gradKernelCorr){
           P2->dDensity	+= dam_f * mi * (dj/di) * temp1;							
         }else {
           P2->dDensity	+= dam_f * mi * (dj/di) * temp1_c[1];
         }
-      omp_unset_lock(&P2->my_lock);
+      PairUnlock(P2);
       
       } else{ //HERE DENSITY IS NOT STANDARD DENSITY BUT : 2*PI*r*rho WANG EQN 56
       ///// AISYMM NOW WORKING WITH STD REDUCTION (THIS)
-        omp_set_lock(&P1->my_lock);
+        PairLock(P1);
           if (!gradKernelCorr){
             P1->dDensity	+= dam_f * mj * temp1;
           } else{
             P1->dDensity	+= dam_f * mj * temp1_c[0];
           }		
-        omp_unset_lock(&P1->my_lock);        
+        PairUnlock(P1);        
 
           if (!gradKernelCorr){
             P2->dDensity	+= dam_f * mi * temp1;
           } else{
             P2->dDensity	+= dam_f * mi * temp1_c[1];
           }		
-        omp_unset_lock(&P1->my_lock); 
+        PairUnlock(P1); 
       }
 
       //#endif
@@ -607,19 +674,25 @@ inline void Domain::CalcDensInc() {
       } //if dam_f > 0.0
     }//FOR PAIRS
   }//FOR NPROC
-
+  EndPairSweeps();
+  if (lockfree) ReduceThreadAccum(TA_DENSINC);
 }
 
 inline void Domain::DensReduction(){
+  bool soa_k = SOAKernels() && !FusedKernels(); //Masses and densities already loaded
   if (dom_bid_type != AxiSymmetric) {
     #pragma omp parallel for schedule (static) num_threads(Nproc)
     for (int i=0; i<solid_part_count;i++){
       Particles[i]->dDensity = 0.;
       for (int n=0;n<ipair_SM[i];n++){ 
-        Particles[i]->dDensity += Particles[Anei[i][n]]->Mass /Particles[Anei[i][n]]->Density * pair_densinc[Aref[i][n]];
+        int j = Anei[Anei_start[i]+n];
+        double mjdj = soa_k ? soa.mass[j]/soa.rho[j] : Particles[j]->Mass /Particles[j]->Density;
+        Particles[i]->dDensity += mjdj * pair_densinc[Aref[Anei_start[i]+n]];
       }
       for (int n=0;n<jpair_SM[i];n++){   
-        Particles[i]->dDensity += Particles[Anei[i][MAX_NB_PER_PART-1-n]]->Mass / Particles[Anei[i][MAX_NB_PER_PART-1-n]]->Density * pair_densinc[Aref[i][MAX_NB_PER_PART-1-n]];    
+        int j = Anei[Anei_start[i]+ipair_SM[i]+n];
+        double mjdj = soa_k ? soa.mass[j]/soa.rho[j] : Particles[j]->Mass / Particles[j]->Density;
+        Particles[i]->dDensity += mjdj * pair_densinc[Aref[Anei_start[i]+ipair_SM[i]+n]];    
       }      
       Particles[i]->dDensity *= Particles[i]->Density;
     }
@@ -628,10 +701,10 @@ inline void Domain::DensReduction(){
     for (int i=0; i<solid_part_count;i++){
       Particles[i]->dDensity = 0.;
       for (int n=0;n<ipair_SM[i];n++){ 
-        Particles[i]->dDensity += Particles[Anei[i][n]]->Mass * pair_densinc[Aref[i][n]];
+        Particles[i]->dDensity += Particles[Anei[Anei_start[i]+n]]->Mass * pair_densinc[Aref[Anei_start[i]+n]];
       }
       for (int n=0;n<jpair_SM[i];n++){   
-        Particles[i]->dDensity += Particles[Anei[i][MAX_NB_PER_PART-1-n]]->Mass * pair_densinc[Aref[i][MAX_NB_PER_PART-1-n]];    
+        Particles[i]->dDensity += Particles[Anei[Anei_start[i]+ipair_SM[i]+n]]->Mass * pair_densinc[Aref[Anei_start[i]+ipair_SM[i]+n]];    
       }    
       //Particles[i]->dDensity *= Particles[i]->Density;
     }    
@@ -639,6 +712,54 @@ inline void Domain::DensReduction(){
   
 }
 
+//// FUSED DENSITY AND RATE TENSORS PASS, NISHIMURA REDUCTION ONLY. 
+//// Both need only x, v and h of the pair; the mj/dj weights are applied by
+//// DensReduction and RateTensorsReduction, so the rate tensors still see 
+//// the updated density if it is updated between both reductions (Fraser)
+inline bool Domain::FusedKernels(){
+  return fused_kernels && nonlock_sum;
+}
+
+inline void Domain::CalcDensRateTensorsFused() {
+  bool pc = UsePairCache();
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+	#ifdef __GNUC__
+	for (size_t k=0; k<Nproc;k++) 
+	#else
+	for (int k=0; k<Nproc;k++) 
+	#endif	
+	{
+  for (size_t p=0; p<SMPairs[k].Size();p++) {
+    Particle *P1 = Particles[std::min(SMPairs[k][p].first, SMPairs[k][p].second)];
+    Particle *P2 = Particles[std::max(SMPairs[k][p].first, SMPairs[k][p].second)];
+    double h, rij, GK, K;
+    Vec3_t xij;
+    if (pc) GetPairGeom(k, p, SMPairs[k][p].first > SMPairs[k][p].second, xij, rij, h, GK, K);
+    else {
+      h	  = (P1->h+P2->h)/2;
+      xij	= P1->x - P2->x;
+      rij	= norm(xij);
+      GK	= m_kernel.gradW(rij/h, h);
+    }
+    Vec3_t vab	= P1->v - P2->v;
+    
+    double dam_f = 1.0;
+    if (model_damage && dam_D[k][p] > 0.0) dam_f = 1.0 - dam_D[k][p];
+    pair_densinc[first_pair_perproc[k] + p] = (dam_f > 0.0) ? GK * dot(vab, xij) : 0.0;
+    
+    pair_StrainRate[first_pair_perproc[k] + p] = (-0.5 * GK) * 
+                            Sym3_t(2.0*vab(0)*xij(0), 2.0*vab(1)*xij(1), 2.0*vab(2)*xij(2),
+                                   vab(0)*xij(1)+vab(1)*xij(0),
+                                   vab(1)*xij(2)+vab(2)*xij(1),
+                                   vab(0)*xij(2)+vab(2)*xij(0));
+    pair_RotRate[first_pair_perproc[k] + p] = (-0.5 * GK) * 
+                            Skew3_t(vab(0)*xij(1)-vab(1)*xij(0),   //01
+                                    vab(1)*xij(2)-vab(2)*xij(1),   //12
+                                    vab(0)*xij(2)-vab(2)*xij(0));  //02
+  }//FOR PAIRS
+  }//FOR NPROC
+}
+
 inline void Domain::CalcForceSOA(int &i,int &j) {
 
   Particle * P1, *P2;
@@ -675,8 +796,8 @@ inline void Domain::CalcForceSOA(int &i,int &j) {
 
 		Vec3_t vij	= P1->v - P2->v;
 		
-		double GK	= GradKernel(Dimension, KernelType, rij/h, h);
-		double K	= Kernel(Dimension, KernelType, rij/h, h); 
+		double GK	= m_kernel.gradW(rij/h, h);
+		double K	= m_kernel.W(rij/h, h); 
     
 		// Artificial Viscosity
 		Mat3_t PIij;
@@ -720,7 +841,7 @@ inline void Domain::CalcForceSOA(int &i,int &j) {
 		Mat3_t TIij;
 		set_to_zero(TIij);
 		if (P1->TI > 0.0 || P2->TI > 0.0) 
-			TIij = pow((K/Kernel(Dimension, KernelType, (P1->TIInitDist + P2->TIInitDist)/(2.0*h), h)),(P1->TIn+P2->TIn)/2.0)*(P1->TIR+P2->TIR);
+			TIij = pow((K/m_kernel.W((P1->TIInitDist + P2->TIInitDist)/(2.0*h), h)),(P1->TIn+P2->TIn)/2.0)*(P1->TIR+P2->TIR);
 			//TIij = pow((K/m_kernel.W((P1->TIInitDist + P2->TIInitDist)/(2.0*h))),(P1->TIn+P2->TIn)/2.0)*(P1->TIR+P2->TIR);
 
 		// NoSlip BC velocity correction
@@ -739,7 +860,8 @@ inline void Domain::CalcForceSOA(int &i,int &j) {
 			}
 		}
 
-		Mat3_t StrainRate,RotationRate;
+		Sym3_t  StrainRate;
+		Skew3_t RotationRate;
 		set_to_zero(StrainRate);
 		set_to_zero(RotationRate);
 		
@@ -761,21 +883,15 @@ inline void Domain::CalcForceSOA(int &i,int &j) {
 			StrainRate(0,0) = 2.0*vab(0)*xij(0);
 			StrainRate(0,1) = vab(0)*xij(1)+vab(1)*xij(0);
 			StrainRate(0,2) = vab(0)*xij(2)+vab(2)*xij(0);
-			StrainRate(1,0) = StrainRate(0,1);
 			StrainRate(1,1) = 2.0*vab(1)*xij(1);
 			StrainRate(1,2) = vab(1)*xij(2)+vab(2)*xij(1);
-			StrainRate(2,0) = StrainRate(0,2);
-			StrainRate(2,1) = StrainRate(1,2);
 			StrainRate(2,2) = 2.0*vab(2)*xij(2);
 			StrainRate	= -0.5 * GK * StrainRate;
       
 			
-			RotationRate(0,1) = vab(0)*xij(1)-vab(1)*xij(0);
-			RotationRate(0,2) = vab(0)*xij(2)-vab(2)*xij(0);
-			RotationRate(1,2) = vab(1)*xij(2)-vab(2)*xij(1);
-			RotationRate(1,0) = -RotationRate(0,1);
-			RotationRate(2,0) = -RotationRate(0,2);
-			RotationRate(2,1) = -RotationRate(1,2);
+			RotationRate = Skew3_t(vab(0)*xij(1)-vab(1)*xij(0),   //01
+			                       vab(1)*xij(2)-vab(2)*xij(1),   //12
+			                       vab(0)*xij(2)-vab(2)*xij(0));  //02
 			RotationRate	  = -0.5 * GK * RotationRate;
 			
 			// if (StrainRate(2,2)<-1.e-3)
@@ -808,13 +924,13 @@ inline void Domain::CalcForceSOA(int &i,int &j) {
 
 		// XSPH Monaghan
 		if (XSPH != 0.0  && (P1->IsFree*P2->IsFree)) {
-			omp_set_lock(&P1->my_lock);
+			PairLock(P1);
 			P1->VXSPH += XSPH*mj/(0.5*(di+dj))*K*-vij;
-			omp_unset_lock(&P1->my_lock);
+			PairUnlock(P1);
 
-			omp_set_lock(&P2->my_lock);
+			PairLock(P2);
 			P2->VXSPH += XSPH*mi/(0.5*(di+dj))*K*vij;
-			omp_unset_lock(&P2->my_lock);
+			PairUnlock(P2);
 		}
 
 		// Calculating the forces for the particle 1 & 2
@@ -893,8 +1009,8 @@ inline void Domain::CalcForceSOA(int &i,int &j) {
 					P1->RotationRate 	= P1->RotationRate + mj_dj*RotationRate;
 				}
 				else {
-					P1->StrainRate 		= P1->StrainRate 		+ mj_dj * StrainRate_c[0];
-					P1->RotationRate 	= P1->RotationRate 	+ mj_dj * RotationRate_c[0];
+					P1->StrainRate 		= P1->StrainRate 		+ mj_dj * Sym3_t(StrainRate_c[0]);
+					P1->RotationRate 	= P1->RotationRate 	+ mj_dj * Skew3_t(RotationRate_c[0]);
 				}
 
 			}
@@ -924,8 +1040,8 @@ inline void Domain::CalcForceSOA(int &i,int &j) {
 					P2->StrainRate	 = P2->StrainRate + mi_di*StrainRate;
 					P2->RotationRate = P2->RotationRate + mi_di*RotationRate;
 				} else {
-					P2->StrainRate = P2->StrainRate 		+ mi_di*StrainRate_c[1];
-					P2->RotationRate = P2->RotationRate + mi_di*RotationRate_c[1];
+					P2->StrainRate = P2->StrainRate 		+ mi_di*Sym3_t(StrainRate_c[1]);
+					P2->RotationRate = P2->RotationRate + mi_di*Skew3_t(RotationRate_c[1]);
 				}
 
 
@@ -945,4 +1061,403 @@ inline void Domain::CalcForceSOA(int &i,int &j) {
   //}//Interaction
 } 
 
+///////////////////////////////////////////////////////////////////
+//// SOA KERNELS: SAME AS ABOVE, FOR THE COMMON CASE (NO GRADIENT 
+//// CORRECTION, NO DAMAGE, NOT AXISYMMETRIC). FIELDS ARE READ FROM
+//// soa, WHICH IS LOADED ONCE AND UPDATED BY THE INTEGRATORS (StoreSOA).
+//// LOCKING SUM ACCUMULATORS ARE ADDED TO PARTICLES AFTER (LOCK FREE 
+//// SUM IS REDUCED DIRECTLY TO PARTICLES)
+inline bool Domain::SOAKernels(){
+  return soa_kernels && !gradKernelCorr && !model_damage && dom_bid_type != AxiSymmetric;
+}
+
+//Loads every field, when the SOA kernels start or after soa_live is reset (particles 
+//reordered, added or changed out of the integrators). Then it is kept by StoreSOA
+inline void Domain::LoadSOA(){
+  soa.Resize(Particles.Size());
+  if (Particles.Size() > 0) //Local origin, positions are differenced only
+    for (int c=0;c<3;c++) soa.x0[c] = Particles[0]->x(c);
+  soa_live = true;
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+  for (int i=0; i<Particles.Size(); i++){
+    soa.mass  [i] = Particles[i]->Mass;
+    soa.alpha [i] = Particles[i]->Alpha;
+    soa.beta  [i] = Particles[i]->Beta;
+    StoreSOA(i, SOA_ALL);
+  }
+}
+
+//Called by the code that changes the particle fields (integrators, ghosts, BCs), 
+//with the particle data already in cache. Nothing is done if the SOA is not in use
+inline void Domain::StoreSOA(const int &i, const int &fields){
+  if (!soa_live) return;
+  Particle *P = Particles[i];
+  if (fields & SOA_POS)
+    for (int c=0;c<3;c++) soa.x[3*i+c] = P->x(c) - soa.x0[c];
+  if (fields & SOA_VEL)
+    for (int c=0;c<3;c++) soa.v[3*i+c] = P->v(c);
+  if (fields & SOA_H)
+    soa.h[i] = P->h;
+  if (fields & SOA_DENS) {
+    soa.rho[i] = P->Density;
+    soa.cs [i] = SoundSpeed(P->PresEq, P->Cs, P->Density, P->RefDensity);
+  }
+  if (fields & SOA_STRESS){
+    soa.ti    [i] = P->TI;
+    soa.tin   [i] = P->TIn;
+    soa.tidist[i] = P->TIInitDist;
+    double tir[6];
+    ToFlatSym(P->TIR, tir);
+    for (int c=0;c<6;c++) {soa.sigma[6*i+c] = P->Sigma.d[c]; soa.tir[6*i+c] = tir[c];}
+  }
+}
+
+inline void Domain::CalcAccelSOA() {
+  if (!soa_live || soa.n != Particles.Size()) LoadSOA();
+  bool lockfree = LockFreeSum();
+  bool pc = UsePairCache();
+  if (lockfree) InitThreadAccum(TA_ACCEL);
+  else if (!nonlock_sum) {
+    #pragma omp parallel for schedule (static) num_threads(Nproc)
+    for (int i=0; i<Particles.Size(); i++)
+      for (int c=0;c<3;c++) soa.a[3*i+c] = 0.;
+  }
+  
+  if (SIMDKernels()) CalcAccelBatchSOA(lockfree);
+  else {
+  int ncol = BeginPairSweeps(ColoredSum());
+  for (int col=0; col<ncol; col++)
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+	#ifdef __GNUC__
+	for (size_t k=0; k<Nproc;k++) 
+	#else
+	for (int k=0; k<Nproc;k++) 
+	#endif	
+	{
+  for (size_t q=ColorBegin(k,col); q<ColorEnd(k,col);q++) {
+    size_t p = ColorPair(q);
+    size_t i,j;
+    if (!nonlock_sum){
+      i = SMPairs[k][p].first;  j = SMPairs[k][p].second;
+    } else {
+      i = std::min(SMPairs[k][p].first, SMPairs[k][p].second);
+      j = std::max(SMPairs[k][p].first, SMPairs[k][p].second);
+    }
+    double xij[3], vij[3], h, rij, GK, K;
+    if (pc) {
+      const PairGeom &g = pgeom[pgeom_off[k]+p];
+      double sg = (i == SMPairs[k][p].first) ? 1.0 : -1.0;
+      for (int c=0;c<3;c++) xij[c] = sg*g.xij[c];
+      h = g.h;  rij = g.rij;  GK = g.GK;  K = g.K;
+    } else {
+      for (int c=0;c<3;c++) xij[c] = soa.x[3*i+c] - soa.x[3*j+c];
+      h   = 0.5*(soa.h[i]+soa.h[j]);
+      rij = sqrt(xij[0]*xij[0] + xij[1]*xij[1] + xij[2]*xij[2]);
+      GK  = m_kernel.gradW(rij/h, h);
+      K   = m_kernel.W(rij/h, h);
+    }
+    for (int c=0;c<3;c++) vij[c] = soa.v[3*i+c] - soa.v[3*j+c];
+    double di = soa.rho[i], dj = soa.rho[j];
+    double mi = soa.mass[i],mj = soa.mass[j];
+    
+    // Artificial Viscosity (diagonal)
+    double PIij = 0.;
+    double Alpha	= 0.5*(soa.alpha[i] + soa.alpha[j]);
+    double Beta	  = 0.5*(soa.beta [i] + soa.beta [j]);
+    if (Alpha!=0.0 || Beta!=0.0) {
+      double vx   = vij[0]*xij[0] + vij[1]*xij[1] + vij[2]*xij[2];
+      double MUij = h*vx/(rij*rij+0.01*h*h);					///<(2.75) Li, Liu Book
+      double Cij  = 0.5*(soa.cs[i]+soa.cs[j]);
+      if (vx<0) PIij = (Alpha*Cij*MUij+Beta*MUij*MUij)/(0.5*(di+dj));		///<(2.74) Li, Liu Book
+    }
+    
+    // Stress term, flat symmetric
+    const sph_real *si = &soa.sigma[6*i], *sj = &soa.sigma[6*j];
+    double M[6];
+    if (GradientType == 0){
+      double fi = 1.0/(di*di), fj = 1.0/(dj*dj);
+      for (int c=0;c<6;c++) M[c] = fi*si[c] + fj*sj[c];
+    } else if (GradientType == 1){
+      double f = 1.0/(di*dj);
+      for (int c=0;c<6;c++) M[c] = f*(si[c] + sj[c]);
+    } else {
+      double f = 1.0/(di*dj);
+      for (int c=0;c<6;c++) M[c] = f*(si[c] - sj[c]); ////////// SEEE CAMPBELL 2000
+    }
+    for (int c=0;c<3;c++) M[c] += PIij;
+    
+    // Tensile Instability
+    if (soa.ti[i] > 0.0 || soa.ti[j] > 0.0) {
+      double f = pow((K/m_kernel.W((soa.tidist[i] + soa.tidist[j])/(2.0*h), h)),(soa.tin[i]+soa.tin[j])/2.0);
+      for (int c=0;c<6;c++) M[c] += f*(soa.tir[6*i+c] + soa.tir[6*j+c]);
+    }
+    
+    double g[3] = {GK*xij[0], GK*xij[1], GK*xij[2]};
+    Vec3_t temp;
+    temp(0) = g[0]*M[0] + g[1]*M[3] + g[2]*M[5];
+    temp(1) = g[0]*M[3] + g[1]*M[1] + g[2]*M[4];
+    temp(2) = g[0]*M[5] + g[1]*M[4] + g[2]*M[2];
+		if (Dimension == 2) temp(2) = 0.0; //PLANE STRAIN
+    
+    if (nonlock_sum)
+      pair_force[first_pair_perproc[k] + p] = temp;
+    else if (lockfree) {
+      tacc[k].a[i] += mj * temp;
+      tacc[k].a[j] -= mi * temp;
+    } else {
+      PairLock(Particles[i]);
+        for (int c=0;c<3;c++) soa.a[3*i+c] += mj * temp(c);
+      PairUnlock(Particles[i]);
+      PairLock(Particles[j]);
+        for (int c=0;c<3;c++) soa.a[3*j+c] -= mi * temp(c);
+      PairUnlock(Particles[j]);
+    }
+  }//MAIN FOR IN PAIR
+  }//MAIN FOR PROC
+  EndPairSweeps();
+  }//!SIMDKernels
+  
+  if (lockfree)
+    ReduceThreadAccum(TA_ACCEL);
+  else if (!nonlock_sum) {
+    #pragma omp parallel for schedule (static) num_threads(Nproc)
+    for (int i=0; i<Particles.Size(); i++)
+      for (int c=0;c<3;c++) Particles[i]->a(c) += soa.a[3*i+c];
+  }
+}
+
+//Cubic or hyperbolic spline, analytic kernel and no tensile instability
+//Called once the SOA is loaded
+inline bool Domain::SIMDKernels(){
+  if (!simd_kernels || !SOAKernels() || kernel_table_res > 0) return false;
+  if (KernelType != 0 && KernelType != 3) return false;
+  int ti = 0;
+  #pragma omp parallel for schedule (static) reduction(+:ti) num_threads(Nproc)
+  for (int i=0; i<Particles.Size(); i++)
+    if (soa.ti[i] > 0.0) ti++;
+  return ti == 0;
+}
+
+//Same as CalcAccelSOA pair loop, pair terms computed by batches of ACCEL_BATCH
+inline void Domain::CalcAccelBatchSOA(const bool &lockfree) {
+  AccelBatchPar par;
+  par.dim       = Dimension;
+  par.kt        = KernelType;
+  par.grad_type = GradientType;
+  if (KernelType == 0)  par.C = (Dimension == 2) ? KernelFunctor<2,0>::C() : KernelFunctor<3,0>::C();
+  else                  par.C = (Dimension == 2) ? KernelFunctor<2,3>::C() : KernelFunctor<3,3>::C();
+  
+  int ncol = BeginPairSweeps(ColoredSum());
+  for (int col=0; col<ncol; col++)
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+	#ifdef __GNUC__
+	for (size_t k=0; k<Nproc;k++) 
+	#else
+	for (int k=0; k<Nproc;k++) 
+	#endif	
+	{
+  size_t bi[ACCEL_BATCH], bj[ACCEL_BATCH];
+  double f[3*ACCEL_BATCH];
+  size_t q1 = ColorEnd(k,col);
+  for (size_t q0=ColorBegin(k,col); q0<q1;q0+=ACCEL_BATCH) {
+    int n = std::min((size_t)ACCEL_BATCH, q1-q0);
+    for (int b=0; b<n; b++){
+      size_t p = ColorPair(q0+b);
+      if (!nonlock_sum){
+        bi[b] = SMPairs[k][p].first;  bj[b] = SMPairs[k][p].second;
+      } else {
+        bi[b] = std::min(SMPairs[k][p].first, SMPairs[k][p].second);
+        bj[b] = std::max(SMPairs[k][p].first, SMPairs[k][p].second);
+      }
+    }
+    m_accel_batch(soa, par, bi, bj, n, f);
+    
+    for (int b=0; b<n; b++){
+      size_t i = bi[b], j = bj[b];
+      double mi = soa.mass[i], mj = soa.mass[j];
+      Vec3_t temp(f[3*b], f[3*b+1], f[3*b+2]);
+      if (nonlock_sum)
+        pair_force[first_pair_perproc[k] + q0 + b] = temp; //Not colored
+      else if (lockfree) {
+        tacc[k].a[i] += mj * temp;
+        tacc[k].a[j] -= mi * temp;
+      } else {
+        PairLock(Particles[i]);
+          for (int c=0;c<3;c++) soa.a[3*i+c] += mj * temp(c);
+        PairUnlock(Particles[i]);
+        PairLock(Particles[j]);
+          for (int c=0;c<3;c++) soa.a[3*j+c] -= mi * temp(c);
+        PairUnlock(Particles[j]);
+      }
+    }
+  }//BATCHES
+  }//MAIN FOR PROC
+  EndPairSweeps();
+}
+
+inline void Domain::CalcRateTensorsSOA() {
+  if (!soa_live || soa.n != Particles.Size()) LoadSOA();
+  bool lockfree = LockFreeSum();
+  bool pc = UsePairCache();
+  if (lockfree) InitThreadAccum(TA_RATES);
+  else if (!nonlock_sum) {
+    #pragma omp parallel for schedule (static) num_threads(Nproc)
+    for (int i=0; i<Particles.Size(); i++){
+      for (int c=0;c<6;c++) soa.strrate[6*i+c] = 0.;
+      for (int c=0;c<3;c++) soa.rotrate[3*i+c] = 0.;
+    }
+  }
+  
+  int ncol = BeginPairSweeps(ColoredSum());
+  for (int col=0; col<ncol; col++)
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+	#ifdef __GNUC__
+	for (size_t k=0; k<Nproc;k++) 
+	#else
+	for (int k=0; k<Nproc;k++) 
+	#endif	
+	{
+  for (size_t q=ColorBegin(k,col); q<ColorEnd(k,col);q++) {
+    size_t p = ColorPair(q);
+    size_t i,j;
+    if (!nonlock_sum){
+      i = SMPairs[k][p].first;  j = SMPairs[k][p].second;
+    } else {
+      i = std::min(SMPairs[k][p].first, SMPairs[k][p].second);
+      j = std::max(SMPairs[k][p].first, SMPairs[k][p].second);
+    }
+    double xij[3], vab[3], h, rij, GK;
+    if (pc) {
+      const PairGeom &g = pgeom[pgeom_off[k]+p];
+      double sg = (i == SMPairs[k][p].first) ? 1.0 : -1.0;
+      for (int c=0;c<3;c++) xij[c] = sg*g.xij[c];
+      h = g.h;  rij = g.rij;  GK = g.GK;
+    } else {
+      for (int c=0;c<3;c++) xij[c] = soa.x[3*i+c] - soa.x[3*j+c];
+      h   = 0.5*(soa.h[i]+soa.h[j]);
+      rij = sqrt(xij[0]*xij[0] + xij[1]*xij[1] + xij[2]*xij[2]);
+      GK  = m_kernel.gradW(rij/h, h);
+    }
+    for (int c=0;c<3;c++) vab[c] = soa.v[3*i+c] - soa.v[3*j+c];
+    
+    Sym3_t  StrainRate(  -GK*vab[0]*xij[0],
+                         -GK*vab[1]*xij[1],
+                         -GK*vab[2]*xij[2],
+                         -0.5*GK*(vab[0]*xij[1]+vab[1]*xij[0]),
+                         -0.5*GK*(vab[1]*xij[2]+vab[2]*xij[1]),
+                         -0.5*GK*(vab[0]*xij[2]+vab[2]*xij[0]));
+    Skew3_t RotationRate(-0.5*GK*(vab[0]*xij[1]-vab[1]*xij[0]),
+                         -0.5*GK*(vab[1]*xij[2]-vab[2]*xij[1]),
+                         -0.5*GK*(vab[0]*xij[2]-vab[2]*xij[0]));
+    const double *sr = StrainRate.d, *rr = RotationRate.d;
+    
+    if (nonlock_sum){
+      pair_StrainRate[first_pair_perproc[k] + p] = StrainRate;
+      pair_RotRate   [first_pair_perproc[k] + p] = RotationRate;
+    } else if (lockfree) {
+      double mj_dj = soa.mass[j]/soa.rho[j];
+      double mi_di = soa.mass[i]/soa.rho[i];
+      tacc[k].strrate[i] += mj_dj * StrainRate;
+      tacc[k].rotrate[i] += mj_dj * RotationRate;
+      tacc[k].strrate[j] += mi_di * StrainRate;
+      tacc[k].rotrate[j] += mi_di * RotationRate;
+    } else {
+      double mj_dj = soa.mass[j]/soa.rho[j];
+      double mi_di = soa.mass[i]/soa.rho[i];
+      PairLock(Particles[i]);
+        for (int c=0;c<6;c++) soa.strrate[6*i+c] += mj_dj*sr[c];
+        for (int c=0;c<3;c++) soa.rotrate[3*i+c] += mj_dj*rr[c];
+      PairUnlock(Particles[i]);
+      PairLock(Particles[j]);
+        for (int c=0;c<6;c++) soa.strrate[6*j+c] += mi_di*sr[c];
+        for (int c=0;c<3;c++) soa.rotrate[3*j+c] += mi_di*rr[c];
+      PairUnlock(Particles[j]);
+    }
+  }//FOR PAIRS
+  }//FOR NPROC
+  EndPairSweeps();
+  
+  if (lockfree)
+    ReduceThreadAccum(TA_RATES);
+  else if (!nonlock_sum) {
+    #pragma omp parallel for schedule (static) num_threads(Nproc)
+    for (int i=0; i<Particles.Size(); i++){
+      for (int c=0;c<6;c++) Particles[i]->StrainRate.d  [c] += soa.strrate[6*i+c];
+      for (int c=0;c<3;c++) Particles[i]->RotationRate.d[c] += soa.rotrate[3*i+c];
+    }
+  }
+}
+
+inline void Domain::CalcDensIncSOA() {
+  if (!soa_live || soa.n != Particles.Size()) LoadSOA();
+  bool lockfree = LockFreeSum();
+  bool pc = UsePairCache();
+  if (lockfree) InitThreadAccum(TA_DENSINC);
+  else if (!nonlock_sum) {
+    #pragma omp parallel for schedule (static) num_threads(Nproc)
+    for (int i=0; i<Particles.Size(); i++)
+      soa.drho[i] = 0.;
+  }
+  
+  int ncol = BeginPairSweeps(ColoredSum());
+  for (int col=0; col<ncol; col++)
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+	#ifdef __GNUC__
+	for (size_t k=0; k<Nproc;k++) 
+	#else
+	for (int k=0; k<Nproc;k++) 
+	#endif	
+	{
+  for (size_t q=ColorBegin(k,col); q<ColorEnd(k,col);q++) {
+    size_t p = ColorPair(q);
+    size_t i,j;
+    if (!nonlock_sum){
+      i = SMPairs[k][p].first;  j = SMPairs[k][p].second;
+    } else {
+      i = std::min(SMPairs[k][p].first, SMPairs[k][p].second);
+      j = std::max(SMPairs[k][p].first, SMPairs[k][p].second);
+    }
+    double xij[3], vij[3], h, rij, GK;
+    if (pc) {
+      const PairGeom &g = pgeom[pgeom_off[k]+p];
+      double sg = (i == SMPairs[k][p].first) ? 1.0 : -1.0;
+      for (int c=0;c<3;c++) xij[c] = sg*g.xij[c];
+      h = g.h;  rij = g.rij;  GK = g.GK;
+    } else {
+      for (int c=0;c<3;c++) xij[c] = soa.x[3*i+c] - soa.x[3*j+c];
+      h   = 0.5*(soa.h[i]+soa.h[j]);
+      rij = sqrt(xij[0]*xij[0] + xij[1]*xij[1] + xij[2]*xij[2]);
+      GK  = m_kernel.gradW(rij/h, h);
+    }
+    for (int c=0;c<3;c++) vij[c] = soa.v[3*i+c] - soa.v[3*j+c];
+    double temp1 = GK*(vij[0]*xij[0] + vij[1]*xij[1] + vij[2]*xij[2]);
+    
+    if (nonlock_sum)
+      pair_densinc[first_pair_perproc[k] + p] = temp1;
+    else if (lockfree) {
+      double di = soa.rho[i], dj = soa.rho[j];
+      tacc[k].drho[i] += soa.mass[j] * (di/dj) * temp1;
+      tacc[k].drho[j] += soa.mass[i] * (dj/di) * temp1;
+    } else {
+      double di = soa.rho[i], dj = soa.rho[j];
+      PairLock(Particles[i]);
+        soa.drho[i] += soa.mass[j] * (di/dj) * temp1;
+      PairUnlock(Particles[i]);
+      PairLock(Particles[j]);
+        soa.drho[j] += soa.mass[i] * (dj/di) * temp1;
+      PairUnlock(Particles[j]);
+    }
+  }//FOR PAIRS
+  }//FOR NPROC
+  EndPairSweeps();
+  
+  if (lockfree)
+    ReduceThreadAccum(TA_DENSINC);
+  else if (!nonlock_sum) {
+    #pragma omp parallel for schedule (static) num_threads(Nproc)
+    for (int i=0; i<Particles.Size(); i++)
+      Particles[i]->dDensity += soa.drho[i];
+  }
+}
+
   };//SPH
\ No newline at end of file
@@ -1,312 +1,283 @@
 #include "Domain.h"
 
 ///////////////////////////////////////////////////////////////////
-// ONLY FOR DELETION: IS FOR TESTING PARALLELIZE BY PARTICLE OR BY PAIR
-// PARALLELIZATION PER PARTICLE
-#define ID_TEST 0
+// GATHER MODE: PARALLELIZATION BY PARTICLE INSTEAD OF BY PAIR
+// Each particle loops over its full neighbour list (CSR, built from SMPairs)
+// and only writes its own accumulators, so there is no write contention and
+// no locks, at the cost of computing every pair twice. Pairs are evaluated 
+// with the same orientation (first, second) as in SMPairs, so the result is the 
+// same as CalcAccel, CalcRateTensors and CalcDensInc (up to the sum order).
+// side = 0: contribution to the first particle of the pair, 1: to the second one
 namespace SPH{
-// ONLY FOR TESTING  
-inline void Domain::CalcAccelPair(Particle * P1, Particle * P2){
-	double h	= (P1->h+P2->h)/2;
-	Vec3_t xij	= P1->x - P2->x;
 
-	Periodic_X_Correction(xij, h, P1, P2);
-
-	double rij	= norm(xij);
-
-  double clock_begin;
-  Vec3_t temp = 0.;
-	// if ((rij/h)<=Cellfac)
-	// {
-		double di=0.0,dj=0.0,mi=0.0,mj=0.0;
-		double Alpha	= (P1->Alpha + P2->Alpha)/2.0;
-		double Beta	= (P1->Beta + P2->Beta)/2.0;
-
-    di = P1->Density;
-    mi = P1->Mass;
-    dj = P2->Density;
-    mj = P2->Mass;
-
-		Vec3_t vij	= P1->v - P2->v;
-		
-		double GK	= GradKernel(Dimension, KernelType, rij/h, h);
-		double K	= Kernel(Dimension, KernelType, rij/h, h);
-		
-
-		// Artificial Viscosity
-		Mat3_t PIij;
-		set_to_zero(PIij);
-		if (Alpha!=0.0 || Beta!=0.0) {
-			double MUij = h*dot(vij,xij)/(rij*rij+0.01*h*h);					///<(2.75) Li, Liu Book
-			double Cij;
-			double Ci,Cj;
-			if (!P1->IsFree) Ci = SoundSpeed(P2->PresEq, P2->Cs, di, P2->RefDensity); else Ci = SoundSpeed(P1->PresEq, P1->Cs, di, P1->RefDensity);
-			if (!P2->IsFree) Cj = SoundSpeed(P1->PresEq, P1->Cs, dj, P1->RefDensity); else Cj = SoundSpeed(P2->PresEq, P2->Cs, dj, P2->RefDensity);
-			Cij = 0.5*(Ci+Cj);
-			
-			if (dot(vij,xij)<0) PIij = (Alpha*Cij*MUij+Beta*MUij*MUij)/(0.5*(di+dj)) * I;		///<(2.74) Li, Liu Book
-		}
-    //m_forces_artifvisc_time += (double)(clock() - m_clock_begin) / CLOCKS_PER_SEC;
+//Full neighbour list in CSR form from the half pair lists, rows sorted by pair 
+inline void Domain::BuildGatherNbList(){
+  size_t np = Particles.Size();
+  std::vector <size_t> nbcount(np,0);
+  
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+	#ifdef __GNUC__
+	for (size_t k=0; k<Nproc;k++) 
+	#else
+	for (int k=0; k<Nproc;k++) 
+	#endif	
+  {
+    for (size_t p=0; p<SMPairs[k].Size();p++){
+      #pragma omp atomic
+      nbcount[SMPairs[k][p].first]++;
+      #pragma omp atomic
+      nbcount[SMPairs[k][p].second]++;
+    }
+  }
+  PrefixSum(nbcount, gnb_start);
+  
+  gnb_list.resize(gnb_start[np]);
+  std::vector <size_t> cur(gnb_start.begin(), gnb_start.end()-1);
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+	#ifdef __GNUC__
+	for (size_t k=0; k<Nproc;k++) 
+	#else
+	for (int k=0; k<Nproc;k++) 
+	#endif	
+  {
+    for (size_t p=0; p<SMPairs[k].Size();p++){
+      size_t i = SMPairs[k][p].first, j = SMPairs[k][p].second, n;
+      #if _OPENMP >= 201107
+      #pragma omp atomic capture
+      #else
+      #pragma omp critical (gather_nb)
+      #endif
+      n = cur[i]++;
+      gnb_list[n].j = j; gnb_list[n].k = k; gnb_list[n].p = p; gnb_list[n].side = 0;
+      #if _OPENMP >= 201107
+      #pragma omp atomic capture
+      #else
+      #pragma omp critical (gather_nb)
+      #endif
+      n = cur[j]++;
+      gnb_list[n].j = i; gnb_list[n].k = k; gnb_list[n].p = p; gnb_list[n].side = 1;
+    }
+  }
+  //Fixed order in each row, sums do not depend on thread scheduling
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+  for (int i=0; i<np; i++)
+    std::sort(gnb_list.begin() + gnb_start[i], gnb_list.begin() + gnb_start[i+1]);
+  
+  m_gather_nb_valid = true;
+}
 
-		Mat3_t Sigmaj,Sigmai;
-		set_to_zero(Sigmaj);
-		set_to_zero(Sigmai);
-		Sigmai = P1->Sigma;
-		Sigmaj = P2->Sigma;
+inline bool Domain::GatherKernels(){
+  return gather_kernels && !nonlock_sum;
+}
 
-		// Tensile Instability
-		Mat3_t TIij;
-		set_to_zero(TIij);
-		if (P1->TI > 0.0 || P2->TI > 0.0) 
-			TIij = pow((K/Kernel(Dimension, KernelType, (P1->TIInitDist + P2->TIInitDist)/(2.0*h), h)),(P1->TIn+P2->TIn)/2.0)*(P1->TIR+P2->TIR);
-			//TIij = pow((K/m_kernel.W((P1->TIInitDist + P2->TIInitDist)/(2.0*h))),(P1->TIn+P2->TIn)/2.0)*(P1->TIR+P2->TIR);
+inline void Domain::CalcAccelPair(Particle * P1, Particle * P2, const int &k, const size_t &p, const int &side, Vec3_t &acc){
+  double h, rij, GK, K;
+  Vec3_t xij;
+  if (pair_cache) GetPairGeom(k, p, false, xij, rij, h, GK, K); //Built by UsePairCache in CalcAccelPP
+  else {
+    h	= (P1->h+P2->h)/2;
+    xij	= P1->x - P2->x;
+    rij	= norm(xij);
+    GK	= m_kernel.gradW(rij/h, h);
+    K	= m_kernel.W(rij/h, h);
+  }
+  double dam_f = 1.0;
 
-		if (!gradKernelCorr) {
-		if (GradientType == 0)
-			Mult( GK*xij , ( 1.0/(di*di)*Sigmai + 1.0/(dj*dj)*Sigmaj + PIij + TIij ) , temp);
+  double di=0.0,dj=0.0,mi=0.0,mj=0.0;
+  double Alpha	= (P1->Alpha + P2->Alpha)/2.0;
+  double Beta	= (P1->Beta + P2->Beta)/2.0;
+
+  di = P1->Density;
+  mi = P1->Mass;
+  dj = P2->Density;
+  mj = P2->Mass;
+  
+  if (model_damage) {
+    if (dam_D[k][p] > 0.0 ) dam_f = 1.0 - dam_D[k][p];
+  }
+  if (dam_f <= 0.0) return;
+  if (dam_f > 1.0 ) dam_f = 1.0;
+
+  Vec3_t vij	= P1->v - P2->v;
+
+  // Artificial Viscosity
+  Mat3_t PIij;
+  set_to_zero(PIij);
+  if (Alpha!=0.0 || Beta!=0.0) {
+    double MUij = h*dot(vij,xij)/(rij*rij+0.01*h*h);					///<(2.75) Li, Liu Book
+    double Cij;
+    double Ci,Cj;
+    if (dom_bid_type == AxiSymmetric){ //CALCULATED DENSITY
+      di/=(2.0*M_PI*P1->x(0));
+      dj/=(2.0*M_PI*P2->x(0));
     }
-    if (!gradKernelCorr){
-      //P1->a					+= mj * temp;
-			P2->a					-= mi * temp;
+    if (!P1->IsFree) Ci = SoundSpeed(P2->PresEq, P2->Cs, di, P2->RefDensity); else Ci = SoundSpeed(P1->PresEq, P1->Cs, di, P1->RefDensity);
+    if (!P2->IsFree) Cj = SoundSpeed(P1->PresEq, P1->Cs, dj, P1->RefDensity); else Cj = SoundSpeed(P2->PresEq, P2->Cs, dj, P2->RefDensity);
+    Cij = 0.5*(Ci+Cj);
+    if (dom_bid_type == AxiSymmetric){
+      di*=(2.0*M_PI*P1->x(0));
+      dj*=(2.0*M_PI*P2->x(0));
     }
-			
+    if (dot(vij,xij)<0) PIij = (Alpha*Cij*MUij+Beta*MUij*MUij)/(0.5*(di+dj)) * I;		///<(2.74) Li, Liu Book
+  }
+
+  Mat3_t Sigmaj,Sigmai;
+  Sigmai = P1->Sigma.ToMat();
+  Sigmaj = P2->Sigma.ToMat();
+
+  // Tensile Instability
+  Mat3_t TIij;
+  set_to_zero(TIij);
+  if (P1->TI > 0.0 || P2->TI > 0.0) 
+    TIij = pow((K/m_kernel.W((P1->TIInitDist + P2->TIInitDist)/(2.0*h), h)),(P1->TIn+P2->TIn)/2.0)*(P1->TIR+P2->TIR);
+
+  Vec3_t temp = 0.0;
+  Mat3_t M;
+  if      (GradientType == 0) M = 1.0/(di*di)*Sigmai + 1.0/(dj*dj)*Sigmaj + PIij + TIij;
+  else if (GradientType == 1) M = 1.0/(di*dj)*(Sigmai + Sigmaj)           + PIij + TIij;
+  else                        M = 1.0/(di*dj)*(Sigmai - Sigmaj)           + PIij + TIij; ////////// SEEE CAMPBELL 2000
+  
+  if (gradKernelCorr) {
+    Vec3_t vc;
+    Mult (GK * (side == 0 ? P1->gradCorrM : P2->gradCorrM), xij, vc);
+    Mult (vc, M, temp);
+  } else if (dom_bid_type != AxiSymmetric) {
+    Mult( GK*xij , M, temp);
+  } else { //Wang Eqn 40 and Joshi Eqn 27
+    Vec3_t wij = GK*xij;
+    Vec3_t av;
+    Mult (wij, PIij,av);
+    temp[0] = 2.0 * M_PI *((Sigmai(0,0)*P1->x(0)/(di*di) + Sigmaj(0,0) *P2->x(0)/(dj*dj)) *wij(0) + 
+                           (Sigmai(0,1)*P1->x(0)/(di*di) + Sigmaj(0,1) *P2->x(0)/(dj*dj)) *wij(1))+
+              av[0];
+    temp[1] = 2.0 * M_PI *((Sigmai(0,1)*P1->x(0)/(di*di) + Sigmaj(0,1) *P2->x(0)/(dj*dj)) *wij(0) + 
+                           (Sigmai(1,1)*P1->x(0)/(di*di) + Sigmaj(1,1) *P2->x(0)/(dj*dj)) *wij(1))+
+              av[1];
+  }
+  if (Dimension == 2 && !gradKernelCorr) temp(2) = 0.0; //PLANE STRAIN
+
+  if (side == 0)  acc += dam_f * mj * temp;
+  else            acc -= dam_f * mi * temp;
 }
 
-//////////////////////////
-//// ONLY FOR TESTING FUNCTION ///
-//// PARALLELIZATION BY PARTICLE
 inline void Domain::CalcAccelPP() {
-  Particle *P1, *P2;
-
-	#pragma omp parallel for schedule (static) private (P1,P2) num_threads(Nproc)
+  if (!m_gather_nb_valid) BuildGatherNbList();
+  UsePairCache();
+  
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
   for (int i=0; i < Particles.Size();i++){
-    for (int n=0;n<ipair_SM[i];n++){
-      P1	= Particles[i]; 
-      P2 = Particles[Anei[i][n]];
-      CalcAccelPair(P1,P2);
-    }
-    for (int n=0;n<jpair_SM[i];n++) {
-      P1	= Particles[i]; 
-      P2 = Particles[Anei[i][MAX_NB_PER_PART-1-n]];
-      CalcAccelPair(P1,P2);
+    Vec3_t acc = 0.;
+    for (size_t n=gnb_start[i]; n<gnb_start[i+1]; n++){
+      const GatherNb &nb = gnb_list[n];
+      if (nb.side == 0) CalcAccelPair(Particles[i], Particles[nb.j], nb.k, nb.p, 0, acc);
+      else              CalcAccelPair(Particles[nb.j], Particles[i], nb.k, nb.p, 1, acc);
     }
+    Particles[i]->a += acc;
   }
 }
 
-// ONLY WRITES IN P2
-
-//Similar but not densities
-inline void Domain::CalcRateTensorsPair (Particle *P1, Particle *P2) {          
-
-    double h	= (P1->h+P2->h)/2;
-    Vec3_t xij	= P1->x - P2->x;
-
-	//Periodic_X_Correction(xij, h, P1, P2);
-
-	double rij	= norm(xij);
-
-  double clock_begin;
-
-	// if ((rij/h)<=Cellfac)
-	// {
-  double di=0.0,dj=0.0,mi=0.0,mj=0.0;
-
-    di = P1->Density;
-    mi = P1->Mass;
-
-    dj = P2->Density;
-    mj = P2->Mass;
-
-		Vec3_t vij	= P1->v - P2->v;
-		
-		double GK	= GradKernel(Dimension, KernelType, rij/h, h);
-		double K	= Kernel(Dimension, KernelType, rij/h, h);
-	
-
-		Mat3_t Sigmaj,Sigmai;
-		set_to_zero(Sigmaj);
-		set_to_zero(Sigmai);
-		Sigmai = P1->Sigma;
-		Sigmaj = P2->Sigma;
-
-		// NoSlip BC velocity correction
-		Vec3_t vab = vij;
-
-		Mat3_t StrainRate,RotationRate;
-		set_to_zero(StrainRate);
-		set_to_zero(RotationRate);
-		
-		//NEW
-		Mat3_t GKc[2];
-		double m, mc[2];
-		GKc[0] = GK * P1->gradCorrM;
-		GKc[1] = GK * P2->gradCorrM;
-		if (gradKernelCorr){
-		}
-
-    //m_clock_begin = clock();		
-		
-    Mat3_t StrainRate_c[2],RotationRate_c[2]; //Corrected gradients
-
-		// // // // Calculation strain rate tensor
-		// // // //ORIGINAL FORM			
-		//if (!gradKernelCorr){
-    StrainRate(0,0) = 2.0*vab(0)*xij(0);
-    StrainRate(0,1) = vab(0)*xij(1)+vab(1)*xij(0);
-    StrainRate(0,2) = vab(0)*xij(2)+vab(2)*xij(0);
-    StrainRate(1,0) = StrainRate(0,1);
-    StrainRate(1,1) = 2.0*vab(1)*xij(1);
-    StrainRate(1,2) = vab(1)*xij(2)+vab(2)*xij(1);
-    StrainRate(2,0) = StrainRate(0,2);
-    StrainRate(2,1) = StrainRate(1,2);
-    StrainRate(2,2) = 2.0*vab(2)*xij(2);
-    StrainRate	= -0.5 * GK * StrainRate;
-    
-    RotationRate(0,1) = vab(0)*xij(1)-vab(1)*xij(0);
-    RotationRate(0,2) = vab(0)*xij(2)-vab(2)*xij(0);
-    RotationRate(1,2) = vab(1)*xij(2)-vab(2)*xij(1);
-    RotationRate(1,0) = -RotationRate(0,1);
-    RotationRate(2,0) = -RotationRate(0,2);
-    RotationRate(2,1) = -RotationRate(1,2);
-    RotationRate	  = -0.5 * GK * RotationRate;
-    
-			// if (StrainRate(2,2)<-1.e-3)
-
-			Mat3_t gradv[2],gradvT[2];
-			
-			//cout<<"gradv"<<gradv[0]<<endl;
-			Vec3_t gradK; 
-			Mult(GK * P1->gradCorrM,xij,gradK);
-			Dyad (vab,gradK,gradv[0]); //outer product. L, velocity gradient tensor
-			Mult(GK * P2->gradCorrM,xij,gradK);
-			Dyad (vab,gradK,gradv[1]); //outer product. L, velocity gradient tensor
-			
-			for (int j=0;j<2;j++){
-				Trans(gradv[j],gradvT[j]);
-				StrainRate_c[j] 	= -0.5*(gradv[j] + gradvT[j]);
-				RotationRate_c[j] = -0.5*(gradv[j] - gradvT[j]);
-			}
-      
-		// Calculating the forces for the particle 1 & 2
-		Vec3_t temp = 0.0;
-		double temp1 = 0.0;
-		Vec3_t temp_c[2];
-		double temp1_c[2];
-		Vec3_t vc[2];
-		
-		if (gradKernelCorr){
-			for (int j=0;j<2;j++){
-				Mult (GKc[j], xij, vc[j]);
-			}
-		}
-
-
-		if (Dimension == 2) temp(2) = 0.0;
-		
-		if (!gradKernelCorr)
-			temp1 = dot( vij , GK*xij );
-    
-    clock_begin = clock();
-		// Locking the particle 1 for updating the properties
-
-    float mj_dj= mj/dj;
-
-    float mi_di = mi/di;
-    P2->StrainRate	 = P2->StrainRate + mi_di*StrainRate;
-    P2->RotationRate = P2->RotationRate + mi_di*RotationRate;
-
-
+inline void Domain::CalcRateTensorsPair (Particle *P1, Particle *P2, const int &k, const size_t &p, const int &side, Sym3_t &str, Skew3_t &rot) {          
+  double h, rij, GK, K;
+  Vec3_t xij;
+  if (pair_cache) GetPairGeom(k, p, false, xij, rij, h, GK, K);
+  else {
+    h	= (P1->h+P2->h)/2;
+    xij	= P1->x - P2->x;
+    rij	= norm(xij);
+    GK	= m_kernel.gradW(rij/h, h);
+  }
+  double di = P1->Density, mi = P1->Mass;
+  double dj = P2->Density, mj = P2->Mass;
+
+  Vec3_t vab	= P1->v - P2->v;
+  double f = (side == 0) ? mj/dj : mi/di;
+  if (!gradKernelCorr) {
+    Sym3_t  StrainRate(2.0*vab(0)*xij(0), 2.0*vab(1)*xij(1), 2.0*vab(2)*xij(2),
+                       vab(0)*xij(1)+vab(1)*xij(0),
+                       vab(1)*xij(2)+vab(2)*xij(1),
+                       vab(0)*xij(2)+vab(2)*xij(0));
+    Skew3_t RotationRate(vab(0)*xij(1)-vab(1)*xij(0),   //01
+                         vab(1)*xij(2)-vab(2)*xij(1),   //12
+                         vab(0)*xij(2)-vab(2)*xij(0));  //02
+    str += (-0.5 * GK * f) * StrainRate;
+    rot += (-0.5 * GK * f) * RotationRate;
+  } else {
+    Mat3_t gradv,gradvT;
+    Vec3_t gradK; 
+    Mult(GK * (side == 0 ? P1->gradCorrM : P2->gradCorrM),xij,gradK);
+    Dyad (vab,gradK,gradv); //outer product. L, velocity gradient tensor
+    Trans(gradv,gradvT);
+    str += f * Sym3_t (Mat3_t(-0.5*(gradv + gradvT)));
+    rot += f * Skew3_t(Mat3_t(-0.5*(gradv - gradvT)));
+  }
 }
 
 inline void Domain::CalcTensorsPP() {
-  Particle *P1, *P2;
+  if (!m_gather_nb_valid) BuildGatherNbList();
+  UsePairCache();
 
-	#pragma omp parallel for schedule (static) private (P1,P2) num_threads(Nproc)
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
   for (int i=0; i < Particles.Size();i++){
-    for (int n=0;n<ipair_SM[i];n++){
-      P1	= Particles[i]; 
-      P2 = Particles[Anei[i][n]];
-      CalcRateTensorsPair(P1,P2);
-    }
-    for (int n=0;n<jpair_SM[i];n++) {
-      P1	= Particles[i]; 
-      P2 = Particles[Anei[i][MAX_NB_PER_PART-1-n]];
-      CalcRateTensorsPair(P1,P2);
+    Sym3_t  str(0.);
+    Skew3_t rot(0.);
+    for (size_t n=gnb_start[i]; n<gnb_start[i+1]; n++){
+      const GatherNb &nb = gnb_list[n];
+      if (nb.side == 0) CalcRateTensorsPair(Particles[i], Particles[nb.j], nb.k, nb.p, 0, str, rot);
+      else              CalcRateTensorsPair(Particles[nb.j], Particles[i], nb.k, nb.p, 1, str, rot);
     }
+    Particles[i]->StrainRate   += str;
+    Particles[i]->RotationRate += rot;
   }
 }
 
-inline void Domain::CalcDensIncPairs(Particle *P1, Particle *P2) {
-
-      double h	= (P1->h+P2->h)/2;
-      Vec3_t xij	= P1->x - P2->x;
-      double rij	= norm(xij);
-
-      double di=0.0,dj=0.0,mi=0.0,mj=0.0;
-
-      di = P1->Density;
-      mi = P1->Mass;
-
-      dj = P2->Density;
-      mj = P2->Mass;
-
-      Vec3_t vij	= P1->v - P2->v;
-      
-      double GK	= GradKernel(Dimension, KernelType, rij/h, h);
-      double K	= Kernel(Dimension, KernelType, rij/h, h);
-    
-      //NEW
-      Mat3_t GKc[2];
-      double m, mc[2];
-      GKc[0] = GK * P1->gradCorrM;
-      GKc[1] = GK * P2->gradCorrM;
-      if (gradKernelCorr){
-      }
-      // Calculating the forces for the particle 1 & 2
-      Vec3_t temp = 0.0;
-      double temp1 = 0.0;
-      Vec3_t temp_c[2];
-      double temp1_c[2];
-      Vec3_t vc[2];
-      
-      if (gradKernelCorr){
-        for (int i=0;i<2;i++){
-          Mult (GKc[i], xij, vc[i]);
-        }
-      }
-
-      if (Dimension == 2) temp(2) = 0.0;
-      
-      if (!gradKernelCorr){
-        temp1 = dot( vij , GK*xij );
-      } else {
-        for (int i=0;i<2;i++){			//TODO: DO THIS ONCE!
-          temp1_c[i] = dot( vij , vc[i] );
-        }
-      }
-      if (!gradKernelCorr){
-        P2->dDensity	+= mi * (dj/di) * temp1;							
-      }else {
-        P2->dDensity	+= mi * (dj/di) * temp1_c[1];
-      }
+inline void Domain::CalcDensIncPairs(Particle *P1, Particle *P2, const int &k, const size_t &p, const int &side, double &drho) {
+  double dam_f = 1.0;
+  if (model_damage) {
+    if (dam_D[k][p] > 0.0 ) dam_f = 1.0 - dam_D[k][p];
+  }
+  if (dam_f <= 0.0) return;
+  if (dam_f > 1.0) dam_f = 1.0;
+  
+  double h, rij, GK, K;
+  Vec3_t xij;
+  if (pair_cache) GetPairGeom(k, p, false, xij, rij, h, GK, K);
+  else {
+    h	= (P1->h+P2->h)/2;
+    xij	= P1->x - P2->x;
+    rij	= norm(xij);
+    GK	= m_kernel.gradW(rij/h, h);
+  }
+  double di = P1->Density, mi = P1->Mass;
+  double dj = P2->Density, mj = P2->Mass;
+  Vec3_t vij	= P1->v - P2->v;
+  
+  double temp1;
+  if (!gradKernelCorr){
+    temp1 = dot( vij , GK*xij );
+  } else {
+    Vec3_t vc;
+    Mult (GK * (side == 0 ? P1->gradCorrM : P2->gradCorrM), xij, vc);
+    temp1 = dot( vij , vc );
+  }
+  //Axisymmetric: density is 2*PI*r*rho, WANG EQN 56 (no density ratio)
+  if (side == 0)  drho += dam_f * mj * (dom_bid_type != AxiSymmetric ? di/dj : 1.0) * temp1;
+  else            drho += dam_f * mi * (dom_bid_type != AxiSymmetric ? dj/di : 1.0) * temp1;
 }
 
 inline void Domain::CalcDensPP() {
-  Particle *P1, *P2;
+  if (!m_gather_nb_valid) BuildGatherNbList();
+  UsePairCache();
 
-	#pragma omp parallel for schedule (static) private (P1,P2) num_threads(Nproc)
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
   for (int i=0; i < Particles.Size();i++){
-    for (int n=0;n<ipair_SM[i];n++){
-      P1	= Particles[i]; 
-      P2 = Particles[Anei[i][n]];
-      CalcDensIncPairs(P1,P2);
-    }
-    for (int n=0;n<jpair_SM[i];n++) {
-      P1	= Particles[i]; 
-      P2 = Particles[Anei[i][MAX_NB_PER_PART-1-n]];
-      CalcDensIncPairs(P1,P2);
+    double drho = 0.;
+    for (size_t n=gnb_start[i]; n<gnb_start[i+1]; n++){
+      const GatherNb &nb = gnb_list[n];
+      if (nb.side == 0) CalcDensIncPairs(Particles[i], Particles[nb.j], nb.k, nb.p, 0, drho);
+      else              CalcDensIncPairs(Particles[nb.j], Particles[i], nb.k, nb.p, 1, drho);
     }
+    Particles[i]->dDensity += drho;
   }
 }
 
-};//SPH
\ No newline at end of file
+}; //SPH
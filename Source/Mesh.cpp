@@ -10,6 +10,8 @@ TriMesh::TriMesh(){
   m_v = 0.;
   m_w = 0.;
   dimension = 3;
+  bvh = NULL;
+  rigid_frame = false;
 	
 }
 
@@ -59,6 +61,8 @@ TriMesh::TriMesh(NastranReader &nr, bool flipnormals){
   
   m_v = 0.;
   m_w = 0.;
+  bvh = NULL;
+  rigid_frame = false;
 }
 
 Element::Element(const int &n1, const int &n2, const int &n3){
@@ -271,6 +275,27 @@ inline void TriMesh::CalcCentroidVelFromNodes(){
 //ALL FROM RIGID TRANSLATION AND ROTATION
 //THIS USES m_v and m_w members
 inline void TriMesh::Update(const double &dt){
+  if (rigid_frame) { //Only the transform: x = R x0 + T, with x' = dR x + m_v dt
+    double wn = norm(m_w);
+    Mat3_t dR, R;
+    ::Identity(dR);
+    if (wn > 0.) { //Rodrigues, rotation of wn*dt around m_w
+      Vec3_t k = m_w / wn;
+      double s = sin(wn*dt), c = 1. - cos(wn*dt);
+      Mat3_t K;
+      K = 0.,   -k(2), k(1),
+          k(2),  0.,  -k(0),
+         -k(1),  k(0), 0.;
+      Mat3_t K2;
+      Mult(K, K, K2);
+      dR = dR + s*K + c*K2;
+    }
+    Mult(dR, m_R, R);   m_R = R;
+    Vec3_t T;
+    Mult(dR, m_T, T);   m_T = T + m_v * dt;
+    m_stamp++;
+    return;
+  }
 	//Seems to be More accurate to do this by node vel
 	//This is used by normals
   Vec3_t min = 1000.;
@@ -290,6 +315,7 @@ inline void TriMesh::Update(const double &dt){
   CalcCentroids();
   CalcNormals();        //From node positions
   UpdatePlaneCoeff();   //pplane
+  if (bvh) bvh->Refit(*this);
 }
  
 //To use in contact intersection
@@ -304,7 +330,7 @@ inline void TriMesh::Move(const Vec3_t &v){
   CalcCentroids();
   CalcNormals();        //From node positions
   UpdatePlaneCoeff();   //pplane
-  
+  if (bvh) bvh->Refit(*this);
 }
 
 inline void TriMesh::Scale(const double &f){
@@ -320,6 +346,63 @@ inline void TriMesh::Scale(const double &f){
   CalcNormals();        //From node positions
   cout << "generate plane coeffs"<<endl;
   //UpdatePlaneCoeff();   //pplane
+  if (bvh) bvh->Refit(*this);
+}
+
+//Topology is built once, pad grows each element box (e.g. contact particle radius)
+//With rigid_frame boxes are in the body frame and never refit
+inline void TriMesh::BuildBVH(const std::vector<double> &pad){
+  if (!bvh) bvh = new ElementBVH;
+  bvh->Build(*this, pad);
+}
+
+//Current world geometry becomes the body frame
+inline void TriMesh::SetRigidFrame(){
+  node0.resize(node.Size());
+  for (int n=0;n<node.Size();n++) node0[n] = *node[n];
+  centroid0.resize(element.Size());
+  normal0.resize(element.Size());
+  for (int e=0;e<element.Size();e++){
+    centroid0[e] = element[e]->centroid;
+    normal0[e]   = element[e]->normal;
+  }
+  ::Identity(m_R);
+  m_T = 0.;
+  m_stamp = 0;
+  node_stamp.assign(node.Size(), 0);
+  elem_stamp.assign(element.Size(), 0);
+  rigid_frame = true;
+  if (bvh) bvh->Build(*this, bvh->pad);
+}
+
+inline void TriMesh::ToBody(const Vec3_t &x, Vec3_t &x0) const{
+  Vec3_t d = x - m_T;
+  Mult(d, m_R, x0); //R^T (x - T)
+}
+
+inline bool TriMesh::TouchElement(const int &e){
+  if (elem_stamp[e] == m_stamp) return false;
+  Element *el = element[e];
+  for (int i=0;i<dimension;i++){
+    int n = el->node[i];
+    if (node_stamp[n] != m_stamp) {
+      Mult(m_R, node0[n], *node[n]);
+      *node[n] += m_T;
+      *node_v[n] = m_v + cross(m_w, *node[n]);
+      node_stamp[n] = m_stamp;
+    }
+  }
+  Mult(m_R, centroid0[e], el->centroid);
+  el->centroid += m_T;
+  Mult(m_R, normal0[e], el->normal);
+  el->pplane = dot(*node[el->node[el->nfar]], el->normal);
+  elem_stamp[e] = m_stamp;
+  return true;
+}
+
+inline void TriMesh::TouchAll(){
+  for (int e=0;e<element.Size();e++)
+    TouchElement(e);
 }
  
   
@@ -2,6 +2,7 @@
 #define _MESH_H_
 
 #include "matvec.h"
+#include <vector>
 //#include
 #include "NastranReader.h"
 
@@ -21,6 +22,8 @@ namespace SPH{
 // };
 
 
+class ElementBVH;
+
 // It is like triangular mesh
 class Element{
 	public:
@@ -56,6 +59,17 @@ friend class NastranReader;
   Vec3_t              m_w;            //Constant axis rotation
   
   double              T;              //homogeneous temp
+  ElementBVH         *bvh;            //Element hierarchy for BVH contact, NULL if not used
+  
+  //Rigid body frame mode (SetRigidFrame): geometry is kept in the body frame and Update only
+  //moves the transform. World nodes, centroids, normals and pplane of an element are computed
+  //when it is touched (TouchElement), elements and nodes are current if they carry m_stamp
+  bool                rigid_frame;
+  Mat3_t              m_R;            //Body to world rotation
+  Vec3_t              m_T;            //Body to world translation
+  int                 m_stamp;        //Transform version
+  std::vector <Vec3_t> node0, centroid0, normal0; //Body frame
+  std::vector <int>    node_stamp, elem_stamp;
   
 	TriMesh();
   TriMesh(NastranReader &nr, bool flipnormals = false);
@@ -67,6 +81,11 @@ friend class NastranReader;
                                         //ALL FROM RIGID TRANSLATION AND ROTATION
 	inline void CalcNormals();
 	inline void CalcSpheres();
+	inline void BuildBVH(const std::vector<double> &pad); //Refit by Update, Move and Scale afterwards
+	inline void SetRigidFrame();          //Call once the mesh is placed (Move and Scale are not allowed after)
+	inline void ToBody(const Vec3_t &x, Vec3_t &x0) const;
+	inline bool TouchElement(const int &e); //true if it was updated, not thread safe (shared nodes)
+	inline void TouchAll();
 	void CalcCentroids();
 	inline void SetVel(const Vec3_t &v) {m_v = v;};
 	inline void SetRotAxisVel(const Vec3_t &omega){m_w = omega;};
@@ -75,6 +94,7 @@ friend class NastranReader;
 };
 
 };
+#include "MeshBVH.h"
 #include "Mesh.cpp"
 
 #endif
@@ -0,0 +1,154 @@
+#ifndef _MESH_BVH_H_
+#define _MESH_BVH_H_
+
+#include <vector>
+#include <algorithm>
+
+namespace SPH{
+
+//////////////////////////////////////////////////////////////////////////////
+// Bounding volume hierarchy over the elements of a rigid TriMesh, used by   //
+// the BVH contact search instead of putting the contact particles in the   //
+// cell grid. Topology is built once (median split on element centroids);   //
+// since the mesh is rigid, Refit only recomputes the boxes from the node   //
+// positions, bottom up (children are always stored after their parent).   //
+// Meshes in rigid body frame mode are built in the body frame (node0,      //
+// centroid0) and queried with body frame positions, they are never refit.  //
+//////////////////////////////////////////////////////////////////////////////
+#define BVH_LEAF_SIZE 4
+
+struct BVHNode {
+  Vec3_t  bmin, bmax;
+  int     left, right;      //Children, -1 in leaves
+  int     first, count;     //Range in ElementBVH::elem (leaves only)
+};
+
+class ElementBVH{
+public:
+  std::vector <BVHNode> node;
+  std::vector <int>     elem;   //Element indices sorted by leaf
+  std::vector <double>  pad;    //Per element box growth (contact particle radius)
+
+  bool                  body;   //Built in the body frame of a rigid_frame mesh
+
+  ElementBVH():body(false){}
+
+  //pad may be empty (boxes are the element node bounds)
+  inline void Build(const TriMesh &mesh, const std::vector<double> &pad_){
+    size_t ne = mesh.element.Size();
+    body = mesh.rigid_frame;
+    pad = pad_;
+    if (pad.size() != ne) pad.assign(ne, 0.);
+    elem.resize(ne);
+    for (size_t e=0;e<ne;e++) elem[e] = e;
+    node.clear();
+    node.reserve(2*ne/BVH_LEAF_SIZE + 1);
+    if (ne > 0) BuildNode(mesh, 0, ne);
+    Refit(mesh);
+  }
+
+  inline void Refit(const TriMesh &mesh){
+    for (int n=node.size()-1;n>=0;n--){
+      BVHNode &b = node[n];
+      if (b.left < 0) {
+        ElemBox(mesh, elem[b.first], b.bmin, b.bmax);
+        for (int i=1;i<b.count;i++){
+          Vec3_t emin, emax;
+          ElemBox(mesh, elem[b.first+i], emin, emax);
+          for (int d=0;d<3;d++){
+            if (emin(d) < b.bmin(d)) b.bmin(d) = emin(d);
+            if (emax(d) > b.bmax(d)) b.bmax(d) = emax(d);
+          }
+        }
+      } else {
+        const BVHNode &l = node[b.left], &r = node[b.right];
+        for (int d=0;d<3;d++){
+          b.bmin(d) = std::min(l.bmin(d), r.bmin(d));
+          b.bmax(d) = std::max(l.bmax(d), r.bmax(d));
+        }
+      }
+    }
+  }
+
+  //Appends the elements of every leaf whose box is within r of x (candidates only)
+  inline void Query(const Vec3_t &x, const double &r, std::vector<int> &found) const{
+    if (node.size() == 0) return;
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0){
+      const BVHNode &b = node[stack[--top]];
+      bool overlap = true;
+      for (int d=0;d<3 && overlap;d++)
+        if (x(d) + r < b.bmin(d) || x(d) - r > b.bmax(d)) overlap = false;
+      if (!overlap) continue;
+      if (b.left < 0) {
+        for (int i=0;i<b.count;i++) found.push_back(elem[b.first+i]);
+      } else {
+        stack[top++] = b.left;
+        stack[top++] = b.right;
+      }
+    }
+  }
+
+private:
+  inline void ElemBox(const TriMesh &mesh, const int &e, Vec3_t &bmin, Vec3_t &bmax) const{
+    const Element *el = mesh.element[e];
+    bmin = bmax = NodePos(mesh, el->node[0]);
+    for (int i=1;i<mesh.dimension;i++){
+      const Vec3_t &xn = NodePos(mesh, el->node[i]);
+      for (int d=0;d<3;d++){
+        if (xn(d) < bmin(d)) bmin(d) = xn(d);
+        if (xn(d) > bmax(d)) bmax(d) = xn(d);
+      }
+    }
+    for (int d=0;d<3;d++){ bmin(d) -= pad[e]; bmax(d) += pad[e];}
+  }
+
+  inline const Vec3_t & NodePos(const TriMesh &mesh, const int &n) const{
+    return body ? mesh.node0[n] : *mesh.node[n];
+  }
+  inline const Vec3_t & Centroid(const TriMesh &mesh, const int &e) const{
+    return body ? mesh.centroid0[e] : mesh.element[e]->centroid;
+  }
+
+  struct CentroidLess {
+    const ElementBVH *bvh; const TriMesh *mesh; int axis;
+    CentroidLess(const ElementBVH *b, const TriMesh *m, const int &a):bvh(b),mesh(m),axis(a){}
+    bool operator()(const int &a, const int &b) const {
+      return bvh->Centroid(*mesh,a)(axis) < bvh->Centroid(*mesh,b)(axis);
+    }
+  };
+
+  inline int BuildNode(const TriMesh &mesh, const int &first, const int &count){
+    int n = node.size();
+    node.push_back(BVHNode());
+    node[n].left = node[n].right = -1;
+    node[n].first = first; node[n].count = count;
+    if (count <= BVH_LEAF_SIZE) return n;
+
+    //Split at the median centroid along the longest axis of the centroid bounds
+    Vec3_t cmin = Centroid(mesh, elem[first]), cmax = cmin;
+    for (int i=1;i<count;i++){
+      const Vec3_t &c = Centroid(mesh, elem[first+i]);
+      for (int d=0;d<3;d++){
+        if (c(d) < cmin(d)) cmin(d) = c(d);
+        if (c(d) > cmax(d)) cmax(d) = c(d);
+      }
+    }
+    int axis = 0;
+    for (int d=1;d<3;d++) if (cmax(d)-cmin(d) > cmax(axis)-cmin(axis)) axis = d;
+    int half = count/2;
+    std::nth_element(elem.begin()+first, elem.begin()+first+half, elem.begin()+first+count, CentroidLess(this,&mesh,axis));
+
+    int l = BuildNode(mesh, first, half);
+    int r = BuildNode(mesh, first+half, count-half);
+    node[n].left = l; node[n].right = r; //node may have been reallocated
+    node[n].count = 0;
+    return n;
+  }
+};
+
+};
+
+#endif
@@ -3,6 +3,9 @@
 //#include <CompactNSearch> //NEW WAY
 
 using namespace std;
+
+#include "libmorton/libmorton/include/morton.h" //needs std min/max
+
 namespace SPH {
 
 #define NONLOCK_TEST
@@ -11,25 +14,43 @@ inline void Domain::CellInitiate () {
 	if (!(norm(TRPR)>0.0) && !(norm(BLPF)>0.0))
 	{
 		// Calculate Domain Size
-		BLPF = Particles[0]->x;
-		TRPR = Particles[0]->x;
-		hmax = Particles[0]->h;
-		rhomax = Particles[0]->Density;
+		// Parallel reduction: each thread scans a contiguous chunk, partial results are merged after
+		std::vector <Vec3_t> bl(Nproc, Particles[0]->x), tr(Nproc, Particles[0]->x);
+		std::vector <double> hm(Nproc, Particles[0]->h), rm(Nproc, Particles[0]->Density);
+		std::vector <double> mum(Nproc, MuMax), csm(Nproc, CsMax);
+		size_t chunk = (Particles.Size() + Nproc - 1) / Nproc;
 
-		for (size_t i=0; i<Particles.Size(); i++)
+		#pragma omp parallel for schedule (static) num_threads(Nproc)
+		#ifdef __GNUC__
+		for (size_t k=0; k<Nproc;k++)
+		#else
+		for (int k=0; k<Nproc;k++)
+		#endif
 		{
-			if (Particles[i]->x(0) > TRPR(0)) TRPR(0) = Particles[i]->x(0);
-			if (Particles[i]->x(1) > TRPR(1)) TRPR(1) = Particles[i]->x(1);
-			if (Particles[i]->x(2) > TRPR(2)) TRPR(2) = Particles[i]->x(2);
-
-			if (Particles[i]->x(0) < BLPF(0)) BLPF(0) = Particles[i]->x(0);
-			if (Particles[i]->x(1) < BLPF(1)) BLPF(1) = Particles[i]->x(1);
-			if (Particles[i]->x(2) < BLPF(2)) BLPF(2) = Particles[i]->x(2);
-
-			if (Particles[i]->h > hmax) hmax=Particles[i]->h;
-			if (Particles[i]->Density > rhomax) rhomax=Particles[i]->Density;
-			if (Particles[i]->Mu > MuMax) MuMax=Particles[i]->Mu;
-			if (Particles[i]->Cs > CsMax) CsMax=Particles[i]->Cs;
+			size_t end = std::min((size_t)Particles.Size(), (k+1)*chunk);
+			for (size_t i=k*chunk; i<end; i++) {
+				for (int d=0;d<3;d++) {
+					if (Particles[i]->x(d) > tr[k](d)) tr[k](d) = Particles[i]->x(d);
+					if (Particles[i]->x(d) < bl[k](d)) bl[k](d) = Particles[i]->x(d);
+				}
+				if (Particles[i]->h > hm[k]) hm[k]=Particles[i]->h;
+				if (Particles[i]->Density > rm[k]) rm[k]=Particles[i]->Density;
+				if (Particles[i]->Mu > mum[k]) mum[k]=Particles[i]->Mu;
+				if (Particles[i]->Cs > csm[k]) csm[k]=Particles[i]->Cs;
+			}
+		}
+		BLPF = bl[0]; TRPR = tr[0];
+		hmax = hm[0]; rhomax = rm[0];
+		MuMax = mum[0]; CsMax = csm[0];
+		for (size_t k=1; k<Nproc;k++) {
+			for (int d=0;d<3;d++) {
+				if (tr[k](d) > TRPR(d)) TRPR(d) = tr[k](d);
+				if (bl[k](d) < BLPF(d)) BLPF(d) = bl[k](d);
+			}
+			if (hm[k]  > hmax)   hmax   = hm[k];
+			if (rm[k]  > rhomax) rhomax = rm[k];
+			if (mum[k] > MuMax)  MuMax  = mum[k];
+			if (csm[k] > CsMax)  CsMax  = csm[k];
 		}
 	}
 
@@ -55,15 +76,15 @@ inline void Domain::CellInitiate () {
     // Calculate Cells Properties
 	switch (Dimension)
 	{case 2:
-		if (double (ceil(((TRPR(0)-BLPF(0))/(Cellfac*hmax)))-((TRPR(0)-BLPF(0))/(Cellfac*hmax)))<(hmax/10.0))
-			CellNo[0] = int(ceil((TRPR(0)-BLPF(0))/(Cellfac*hmax)));
+		if (double (ceil(((TRPR(0)-BLPF(0))/(Cellfac*hmax + nb_skin)))-((TRPR(0)-BLPF(0))/(Cellfac*hmax + nb_skin)))<(hmax/10.0))
+			CellNo[0] = int(ceil((TRPR(0)-BLPF(0))/(Cellfac*hmax + nb_skin)));
 		else
-			CellNo[0] = int(floor((TRPR(0)-BLPF(0))/(Cellfac*hmax)));
+			CellNo[0] = int(floor((TRPR(0)-BLPF(0))/(Cellfac*hmax + nb_skin)));
 
-		if (double (ceil(((TRPR(1)-BLPF(1))/(Cellfac*hmax)))-((TRPR(1)-BLPF(1))/(Cellfac*hmax)))<(hmax/10.0))
-			CellNo[1] = int(ceil((TRPR(1)-BLPF(1))/(Cellfac*hmax)));
+		if (double (ceil(((TRPR(1)-BLPF(1))/(Cellfac*hmax + nb_skin)))-((TRPR(1)-BLPF(1))/(Cellfac*hmax + nb_skin)))<(hmax/10.0))
+			CellNo[1] = int(ceil((TRPR(1)-BLPF(1))/(Cellfac*hmax + nb_skin)));
 		else
-			CellNo[1] = int(floor((TRPR(1)-BLPF(1))/(Cellfac*hmax)));
+			CellNo[1] = int(floor((TRPR(1)-BLPF(1))/(Cellfac*hmax + nb_skin)));
 
 		CellNo[2] = 1;
 
@@ -71,20 +92,20 @@ inline void Domain::CellInitiate () {
 		break;
 
 	case 3:
-		if (double (ceil(((TRPR(0)-BLPF(0))/(Cellfac*hmax)))-((TRPR(0)-BLPF(0))/(Cellfac*hmax)))<(hmax/10.0))
-			CellNo[0] = int(ceil((TRPR(0)-BLPF(0))/(Cellfac*hmax)));
+		if (double (ceil(((TRPR(0)-BLPF(0))/(Cellfac*hmax + nb_skin)))-((TRPR(0)-BLPF(0))/(Cellfac*hmax + nb_skin)))<(hmax/10.0))
+			CellNo[0] = int(ceil((TRPR(0)-BLPF(0))/(Cellfac*hmax + nb_skin)));
 		else
-			CellNo[0] = int(floor((TRPR(0)-BLPF(0))/(Cellfac*hmax)));
+			CellNo[0] = int(floor((TRPR(0)-BLPF(0))/(Cellfac*hmax + nb_skin)));
 
-		if (double (ceil(((TRPR(1)-BLPF(1))/(Cellfac*hmax)))-((TRPR(1)-BLPF(1))/(Cellfac*hmax)))<(hmax/10.0))
-			CellNo[1] = int(ceil((TRPR(1)-BLPF(1))/(Cellfac*hmax)));
+		if (double (ceil(((TRPR(1)-BLPF(1))/(Cellfac*hmax + nb_skin)))-((TRPR(1)-BLPF(1))/(Cellfac*hmax + nb_skin)))<(hmax/10.0))
+			CellNo[1] = int(ceil((TRPR(1)-BLPF(1))/(Cellfac*hmax + nb_skin)));
 		else
-			CellNo[1] = int(floor((TRPR(1)-BLPF(1))/(Cellfac*hmax)));
+			CellNo[1] = int(floor((TRPR(1)-BLPF(1))/(Cellfac*hmax + nb_skin)));
 
-		if (double (ceil(((TRPR(2)-BLPF(2))/(Cellfac*hmax)))-((TRPR(2)-BLPF(2))/(Cellfac*hmax)))<(hmax/10.0))
-			CellNo[2] = int(ceil((TRPR(2)-BLPF(2))/(Cellfac*hmax)));
+		if (double (ceil(((TRPR(2)-BLPF(2))/(Cellfac*hmax + nb_skin)))-((TRPR(2)-BLPF(2))/(Cellfac*hmax + nb_skin)))<(hmax/10.0))
+			CellNo[2] = int(ceil((TRPR(2)-BLPF(2))/(Cellfac*hmax + nb_skin)));
 		else
-			CellNo[2] = int(floor((TRPR(2)-BLPF(2))/(Cellfac*hmax)));
+			CellNo[2] = int(floor((TRPR(2)-BLPF(2))/(Cellfac*hmax + nb_skin)));
 
 		CellSize  = Vec3_t ((TRPR(0)-BLPF(0))/CellNo[0],(TRPR(1)-BLPF(1))/CellNo[1],(TRPR(2)-BLPF(2))/CellNo[2]);
 		break;
@@ -104,18 +125,10 @@ inline void Domain::CellInitiate () {
     if (BC.Periodic[1]) DomSize[1] = (TRPR(1)-BLPF(1));
     if (BC.Periodic[2]) DomSize[2] = (TRPR(2)-BLPF(2));
 
-    // Initiate Head of Chain array for Linked-List
-    if (CellNo[0] ==0) cout << "ERROR Generating HOC "<<endl;
-    HOC = new int**[(int) CellNo[0]];
-    for(int i =0; i<CellNo[0]; i++){
-       HOC[i] = new int*[CellNo[1]];
-       for(int j =0; j<CellNo[1]; j++){
-           HOC[i][j] = new int[CellNo[2]];
-           for(int k = 0; k<CellNo[2];k++){
-              HOC[i][j][k] = -1;
-           }
-       }
-    }
+    // Initiate flat cell grid (particles are sorted by cell in ListGenerate)
+    if (CellNo[0] ==0) cout << "ERROR Generating cell grid "<<endl;
+    cell_start.assign(CellNo[0]*CellNo[1]*CellNo[2], 0);
+    cell_count.assign(CellNo[0]*CellNo[1]*CellNo[2], 0);
     // Initiate Pairs array for neibour searching
     for(size_t i=0 ; i<Nproc ; i++) {
 			SMPairs.Push(Initial);
@@ -138,149 +151,119 @@ inline void Domain::CellInitiate () {
     }
 }
 
+// Counting sort of particles by cell: cell_part holds the particle indices
+// of cell c in [cell_start[c], cell_start[c] + cell_count[c])
+// There is a single shared histogram (atomic increments), so memory and work
+// follow the cell count once and not once per thread. Particles are scattered
+// with atomic write positions and each cell range is then sorted, so the result
+// is the same as the serial sort (ascending index in each cell)
 inline void Domain::ListGenerate ()
 {
-	int i, j, k, temp=0;
-	switch (Dimension)
-	{case 2:
-		for (size_t a=0; a<Particles.Size(); a++)
-		{
-			i= (int) (floor((Particles[a]->x(0) - BLPF(0)) / CellSize(0)));
-			j= (int) (floor((Particles[a]->x(1) - BLPF(1)) / CellSize(1)));
-
-			if (i<0) i = 0;
-            // {
-                    // if ((BLPF(0) - Particles[a]->x(0)) <= hmax) i=0;
-                            // else std::cout<<"Leaving i<0"<<std::endl;
-            // }
-            if (j<0) j = 0;
-            // {
-                    // if ((BLPF(1) - Particles[a]->x(1)) <= hmax) j=0;
-                            // else std::cout<<"Leaving j<0"<<std::endl;
-            // }
-			if (i>=CellNo[0])i=CellNo[0]-1;
-			// {
-					// if ((Particles[a]->x(0) - TRPR(0)) <= hmax) i=CellNo[0]-1;
-							// else std::cout<<"Leaving i>=CellNo"<<std::endl;
-			// }
-            if (j>=CellNo[1]) j=CellNo[1]-1;
-            // {
-                    // if ((Particles[a]->x(1) - TRPR(1)) <= hmax) j=CellNo[1]-1;
-                            // else std::cout<<"Leaving j>=CellNo"<<std::endl;
-            // }
-			temp = HOC[i][j][0];
-
-			HOC[i][j][0] = a;
-			Particles[a]->LL = temp;
-			Particles[a]->CC[0] = i;
-			Particles[a]->CC[1] = j;
-			Particles[a]->CC[2] = 0;
-			if (!Particles[a]->IsFree) FixedParticles.Push(a);
-		}
-		break;
+	if (Dimension != 2 && Dimension != 3) {
+		std::cout << "Please correct the dimension (2=>2D or 3=>3D) and run again" << std::endl;
+		abort();
+	}
+	int ncells = CellNo[0]*CellNo[1]*CellNo[2];
+	int np = GridParticleCount(); //Contact particles are not binned with bvh_contact
+	part_cell.resize(Particles.Size());
+	cell_part.resize(np);
+	cell_fill.resize(ncells);
+	std::vector < std::vector <size_t> > fixed_perproc(Nproc);
 
-	case 3:
-		for (size_t a=0; a<Particles.Size(); a++)
-		{
-			i= (int) (floor((Particles[a]->x(0) - BLPF(0)) / CellSize(0)));
-			j= (int) (floor((Particles[a]->x(1) - BLPF(1)) / CellSize(1)));
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (int c=0; c<ncells; c++)
+		cell_count[c] = 0;
+
+	//Cell of each particle and cell totals
+	//(static schedule: thread chunks are contiguous and in order, so are the fixed particles)
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (int a=0; a<np; a++) {
+		int i, j, k = 0;
+		i= (int) (floor((Particles[a]->x(0) - BLPF(0)) / CellSize(0)));
+		j= (int) (floor((Particles[a]->x(1) - BLPF(1)) / CellSize(1)));
+		if (Dimension == 3)
 			k= (int) (floor((Particles[a]->x(2) - BLPF(2)) / CellSize(2)));
 
-            if (i<0) i = 0;
-            // {
-                    // if ((BLPF(0) - Particles[a]->x(0))<=hmax) i=0;
-                            // else std::cout<<"Leaving, particle "<<a<< "yield "<<Particles[a]->Sigmay<<", eff_str_rate "<<Particles[a]->eff_strain_rate<<std::endl;
-            // }
-            if (j<0) j = 0 ;
-            // {
-                    // if ((BLPF(1) - Particles[a]->x(1))<=hmax) j=0;
-                            // else std::cout<<"Leaving particle "<<a<<"yield "<<Particles[a]->Sigmay<<", eff_str_rate "<<Particles[a]->eff_strain_rate<<std::endl;
-            // }
-            if (k<0) k = 0;
-            // {
-                    // if ((BLPF(2) - Particles[a]->x(2))<=hmax) k=0;
-                            // else std::cout<<"Leaving particle"<< a << "yield "<<Particles[a]->Sigmay<<", eff_str_rate "<<Particles[a]->eff_strain_rate<<std::endl;
-            // }
-			if (i>=CellNo[0])i=CellNo[0]-1;
-			// {
-					// if ((Particles[a]->x(0) - TRPR(0))<=hmax) i=CellNo[0]-1;
-							// else std::cout<<"Leavin particle "<<a<< "yield "<<Particles[a]->Sigmay<<", eff_str_rate "<<Particles[a]->eff_strain_rate<<std::endl;
-			// }
-            if (j>=CellNo[1])j=CellNo[1]-1;
-            // {
-                    // if ((Particles[a]->x(1) - TRPR(1))<=hmax) j=CellNo[1]-1;
-                            // else std::cout<<"Leaving particle "<<a<<"yield "<<Particles[a]->Sigmay<<", eff_str_rate "<<Particles[a]->eff_strain_rate<<std::endl;
-            // }
-            if (k>=CellNo[2])k=CellNo[2]-1;
-            // {
-                    // if ((Particles[a]->x(2) - TRPR(2))<=hmax) k=CellNo[2]-1;
-                            // else std::cout<<"Leaving particle"<<a<<"yield "<<Particles[a]->Sigmay<<", eff_str_rate "<<Particles[a]->eff_strain_rate<<std::endl;
-            // }
-
-            temp = HOC[i][j][k];
-			HOC[i][j][k] = a;
-			Particles[a]->LL = temp;
-			Particles[a]->CC[0] = i;
-			Particles[a]->CC[1] = j;
-			Particles[a]->CC[2] = k;
-			if (!Particles[a]->IsFree) FixedParticles.Push(a);
-		}
-		break;
+		if (i<0) i = 0;
+		if (j<0) j = 0;
+		if (k<0) k = 0;
+		if (i>=CellNo[0]) i=CellNo[0]-1;
+		if (j>=CellNo[1]) j=CellNo[1]-1;
+		if (k>=CellNo[2]) k=CellNo[2]-1;
+
+		Particles[a]->CC[0] = i;
+		Particles[a]->CC[1] = j;
+		Particles[a]->CC[2] = k;
+		int c = CellIdx(i,j,k);
+		part_cell[a] = c;
+		#pragma omp atomic
+		cell_count[c]++;
+		if (!Particles[a]->IsFree) fixed_perproc[omp_get_thread_num()].push_back(a);
+	}
 
-	default:
-    	std::cout << "Please correct the dimension (2=>2D or 3=>3D) and run again" << std::endl;
-		abort();
-		break;
+	cell_start[0] = 0;
+	for (int c=1; c<ncells; c++)
+		cell_start[c] = cell_start[c-1] + cell_count[c-1];
+
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (int c=0; c<ncells; c++)
+		cell_fill[c] = cell_start[c];
+
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (int a=0; a<np; a++) {
+		int pos;
+		#pragma omp atomic capture
+		pos = cell_fill[part_cell[a]]++;
+		cell_part[pos] = a;
 	}
 
+	//Cells hold a few particles, restores the ascending order
+	#pragma omp parallel for schedule (dynamic,1024) num_threads(Nproc)
+	for (int c=0; c<ncells; c++)
+		if (cell_count[c] > 1)
+			std::sort(cell_part.begin() + cell_start[c], cell_part.begin() + cell_start[c] + cell_count[c]);
+
+	for (int p=0; p<Nproc; p++)
+		for (size_t f=0; f<fixed_perproc[p].size(); f++)
+			FixedParticles.Push(fixed_perproc[p][f]);
+
+	//Periodic cells point to the same particle range than their images
 	if (BC.Periodic[0]) {
 	   for(int j =0; j<CellNo[1]; j++)
 		   for(int k =0; k<CellNo[2]; k++) {
-			  HOC[CellNo[0]-1][j][k] =  HOC[1][j][k];
-			  HOC[CellNo[0]-2][j][k] =  HOC[0][j][k];
+			  cell_start[CellIdx(CellNo[0]-1,j,k)] = cell_start[CellIdx(1,j,k)];
+			  cell_count[CellIdx(CellNo[0]-1,j,k)] = cell_count[CellIdx(1,j,k)];
+			  cell_start[CellIdx(CellNo[0]-2,j,k)] = cell_start[CellIdx(0,j,k)];
+			  cell_count[CellIdx(CellNo[0]-2,j,k)] = cell_count[CellIdx(0,j,k)];
 		   }
-	} 
+	}
 	if (BC.Periodic[1]) {
 	   for(int i =0; i<CellNo[0]; i++)
 		   for(int k =0; k<CellNo[2]; k++) {
-			  HOC[i][CellNo[1]-1][k] =  HOC[i][1][k];
-			  HOC[i][CellNo[1]-2][k] =  HOC[i][0][k];
+			  cell_start[CellIdx(i,CellNo[1]-1,k)] = cell_start[CellIdx(i,1,k)];
+			  cell_count[CellIdx(i,CellNo[1]-1,k)] = cell_count[CellIdx(i,1,k)];
+			  cell_start[CellIdx(i,CellNo[1]-2,k)] = cell_start[CellIdx(i,0,k)];
+			  cell_count[CellIdx(i,CellNo[1]-2,k)] = cell_count[CellIdx(i,0,k)];
 		   }
 	}
 	if (BC.Periodic[2]) {
 	   for(int i =0; i<CellNo[0]; i++)
 		   for(int j =0; j<CellNo[1]; j++) {
-				  HOC[i][j][CellNo[2]-1] =  HOC[i][j][1];
-				  HOC[i][j][CellNo[2]-2] =  HOC[i][j][0];
-			   }
+			  cell_start[CellIdx(i,j,CellNo[2]-1)] = cell_start[CellIdx(i,j,1)];
+			  cell_count[CellIdx(i,j,CellNo[2]-1)] = cell_count[CellIdx(i,j,1)];
+			  cell_start[CellIdx(i,j,CellNo[2]-2)] = cell_start[CellIdx(i,j,0)];
+			  cell_count[CellIdx(i,j,CellNo[2]-2)] = cell_count[CellIdx(i,j,0)];
+		   }
 	}
 }
 
 inline void Domain::CellReset ()
 {
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (int c=0; c<cell_count.size(); c++)
+		cell_count[c] = 0;
 
-    #pragma omp parallel for schedule (static) num_threads(Nproc)
-
-    for(int i =0; i<CellNo[0]; i++)
-    {
-		for(int j =0; j<CellNo[1]; j++)
-		for(int k =0; k<CellNo[2];k++)
-		{
-			HOC[i][j][k] = -1;
-		}
-    }
-	#pragma omp parallel for schedule(static) num_threads(Nproc)
-	#ifdef __GNUC__
-	for (size_t a=0; a<Particles.Size(); a++)	//Like in Domain::Move
-	#else
-	for (int a=0; a<Particles.Size(); a++)//Like in Domain::Move
-	#endif
-	{
-
-    	Particles[a]->LL = -1;
-    }
-
-    FixedParticles.Clear();
+	FixedParticles.Clear();
 }
 
 //using namespace CompactNSearch;
@@ -356,16 +339,20 @@ inline void Domain::MainNeighbourSearch() {
  
 	
   m_isNbDataCleared = false;
+  m_gather_nb_valid = false;
+  m_pair_cache_valid = false;
+  m_color_valid = false;
+  m_nb_min_dist_valid = false;
 }
 
-inline bool  Domain::CheckRadius(Particle* P1, Particle *P2){
+inline bool  Domain::CheckRadius(Particle* P1, Particle *P2, const double &skin){
 	bool ret = false;
 	
 	double h	= (P1->h+P2->h)/2;
 	Vec3_t xij	= P1->x - P2->x;
 	Periodic_X_Correction(xij, h, P1, P2);
 	double rij	= norm(xij);
-	if ((rij/h)<=Cellfac) ret = true;
+	if (((rij-skin)/h)<=Cellfac) ret = true;
 	// cout << "Checking radius "<<endl;
 	// cout << "rij h rij/h cellfac "<<rij<<", "<< h << ", " << rij/h<<", "<<Cellfac<<endl;
 	return ret;
@@ -396,7 +383,7 @@ inline void Domain::AllocateNbPair(const int &temp1, const int &temp2, const int
 		
 	}
 	int i,j;
-	if ( CheckRadius(Particles[temp1],Particles[temp2])){
+	if ( CheckRadius(Particles[temp1],Particles[temp2],nb_skin)){
 		if (Particles[temp1]->IsFree || Particles[temp2]->IsFree) {
 			if (Particles[temp1]->Material == Particles[temp2]->Material)
 			{
@@ -415,87 +402,226 @@ inline void Domain::AllocateNbPair(const int &temp1, const int &temp2, const int
 		}
 	}
 }
+inline void Domain::AllocateCellPairs(const int &temp1, const int &cell, const int &T){
+	int end = cell_start[cell] + cell_count[cell];
+	for (int n=cell_start[cell]; n<end; n++)
+		AllocateNbPair(temp1,cell_part[n],T);
+}
+
 inline void Domain::YZPlaneCellsNeighbourSearch(int q1) {
 	int q3,q2;
 	size_t T = omp_get_thread_num();
 
 	for (BC.Periodic[2] ? q3=1 : q3=0;BC.Periodic[2] ? (q3<(CellNo[2]-1)) : (q3<CellNo[2]); q3++)
 	for (BC.Periodic[1] ? q2=1 : q2=0;BC.Periodic[1] ? (q2<(CellNo[1]-1)) : (q2<CellNo[1]); q2++) {
-		if (HOC[q1][q2][q3]==-1) continue;
-		else {
-			int temp1, temp2;
-			temp1 = HOC[q1][q2][q3];
-
-			while (temp1 != -1) {// The current cell  => self cell interactions
-				temp2 = Particles[temp1]->LL;
-				while (temp2 != -1){
-						AllocateNbPair(temp1,temp2,T);
-						temp2 = Particles[temp2]->LL;
-				}//while
-
-				// (q1 + 1, q2 , q3)
-				if (q1+1< CellNo[0]) {
-					temp2 = HOC[q1+1][q2][q3];
-					while (temp2 != -1) {
-						AllocateNbPair(temp1,temp2,T);
-						temp2 = Particles[temp2]->LL;
-					}//while temp2!=-1
-				}// (q1 + 1, q2 , q3)
-
-				// (q1 + a, q2 + 1, q3) & a[-1,1]
-				if (q2+1< CellNo[1]) {
-					for (int i = q1-1; i <= q1+1; i++) {
-						if (i<CellNo[0] && i>=0) {
-							temp2 = HOC[i][q2+1][q3];
-							while (temp2 != -1)
-							{
-								AllocateNbPair(temp1,temp2,T);
-								temp2 = Particles[temp2]->LL;
-							}
-						}
-					}
-				}
+		int cell = CellIdx(q1,q2,q3);
+		if (cell_count[cell]==0) continue;
+		int end = cell_start[cell] + cell_count[cell];
+
+		for (int n1=cell_start[cell]; n1<end; n1++) {
+			int temp1 = cell_part[n1];
+			// The current cell  => self cell interactions
+			for (int n2=n1+1; n2<end; n2++)
+				AllocateNbPair(temp1,cell_part[n2],T);
+
+			// (q1 + 1, q2 , q3)
+			if (q1+1< CellNo[0])
+				AllocateCellPairs(temp1,CellIdx(q1+1,q2,q3),T);
+
+			// (q1 + a, q2 + 1, q3) & a[-1,1]
+			if (q2+1< CellNo[1]) {
+				for (int i = q1-1; i <= q1+1; i++)
+					if (i<CellNo[0] && i>=0)
+						AllocateCellPairs(temp1,CellIdx(i,q2+1,q3),T);
+			}
 
-				// (q1 + a, q2 + b, q3 + 1) & a,b[-1,1] => all 9 cells above the current cell
-				if (q3+1< CellNo[2]) {
-					for (int j=q2-1; j<=q2+1; j++)
-					for (int i=q1-1; i<=q1+1; i++) {
-						if (i<CellNo[0] && i>=0 && j<CellNo[1] && j>=0) {
-							temp2 = HOC[i][j][q3+1];
-							while (temp2 != -1)
-							{
-								AllocateNbPair(temp1,temp2,T);
-								temp2 = Particles[temp2]->LL;
-							}
-						}
-					}
-				}
-				temp1 = Particles[temp1]->LL;
-			}//while temp1 !=-1
-		}
+			// (q1 + a, q2 + b, q3 + 1) & a,b[-1,1] => all 9 cells above the current cell
+			if (q3+1< CellNo[2]) {
+				for (int j=q2-1; j<=q2+1; j++)
+				for (int i=q1-1; i<=q1+1; i++)
+					if (i<CellNo[0] && i>=0 && j<CellNo[1] && j>=0)
+						AllocateCellPairs(temp1,CellIdx(i,j,q3+1),T);
+			}
+		}//n1
 	}
 }
 
+// Pair buffers keep their memory between searches (never shrunk), with 10% room over
+// the last count, so a rebuild with a similar pair count does no heap allocation
+template <typename T> inline void ResetPairBuffer(Array<T> &a){
+	a.Reserve(a.Size() + a.Size()/10);
+	a.Reset();
+}
+
 inline void Domain::ClearNbData(){
 
 	#pragma omp parallel for schedule (dynamic) num_threads(Nproc)
 	for (int i=0 ; i<Nproc ; i++) { //In the original version this was calculated after
-		SMPairs[i].Clear();
-		FSMPairs[i].Clear();
-		NSMPairs[i].Clear();
-		RIGPairs[i].Clear();
-		ContPairs[i].Clear();//New
+		ResetPairBuffer(SMPairs[i]);
+		ResetPairBuffer(FSMPairs[i]);
+		ResetPairBuffer(NSMPairs[i]);
+		ResetPairBuffer(RIGPairs[i]);
+		ResetPairBuffer(ContPairs[i]);//New
 		if (model_damage){
-			dam_D[i].Clear();
-      dam_pair[i].Clear();
-			dam_rf0[i].Clear();
+			ResetPairBuffer(dam_D[i]);
+      ResetPairBuffer(dam_pair[i]);
+			ResetPairBuffer(dam_rf0[i]);
 		}
 	}
+	if (reorder_nb_inc > 0){
+		if (m_reorder_count == reorder_nb_inc - 1)
+			ReorderParticles();
+		m_reorder_count = (m_reorder_count + 1) % reorder_nb_inc;
+	}
 	CellReset();
 	ListGenerate();
 	m_isNbDataCleared = true;
 }
 
+// Sorts solid particles along a Morton (Z-order) curve, so that neighbours in space are
+// close in memory. Rigid (contact) particles remain at the end, so first_fem_particle_idx
+// and solid_part_count are still valid. Particle objects are moved, so all per particle
+// data (ID, print_history, etc) goes with them; index holding structures are remapped.
+// Pair lists are empty when called from ClearNbData, but are remapped anyway.
+inline void Domain::ReorderParticles(){
+	int n = Particles.Size();
+	if (contact && first_fem_particle_idx.size() > 0) n = first_fem_particle_idx[0];
+	if (solid_part_count > 0 && solid_part_count < n) n = solid_part_count;
+	if (n < 2) return;
+	
+	//Keys are quantized with hmax, 21 bits per axis in 3D
+	uint_fast32_t maxq = (Dimension == 3) ? 0x1FFFFF : 0xFFFFFFFF;
+	std::vector < std::pair <uint_fast64_t, int> > key(n);
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (int i=0; i<n; i++){
+		uint_fast32_t q[3];
+		for (int d=0; d<3; d++) {
+			double c = floor((Particles[i]->x(d) - BLPF(d)) / hmax);
+			if (c < 0.) c = 0.;
+			if (c > (double)maxq) c = (double)maxq;
+			q[d] = (uint_fast32_t)c;
+		}
+		if (Dimension == 3)	key[i].first = morton3D_64_encode(q[0],q[1],q[2]);
+		else								key[i].first = morton2D_64_encode(q[0],q[1]);
+		key[i].second = i;
+	}
+	std::sort(key.begin(), key.end());
+	
+	std::vector <int> newidx(Particles.Size()); //old to new
+	std::vector <Particle*> ptemp(n);
+	for (int i=0; i<n; i++) {
+		newidx[key[i].second] = i;
+		ptemp[i] = Particles[key[i].second];
+	}
+	for (int i=n; i<Particles.Size(); i++) newidx[i] = i;
+	for (int i=0; i<n; i++) Particles[i] = ptemp[i];
+	
+	for (int i=0; i<Particles.Size(); i++)
+		if (Particles[i]->inner_mirr_part >= 0 && Particles[i]->inner_mirr_part < n)
+			Particles[i]->inner_mirr_part = newidx[Particles[i]->inner_mirr_part];
+	for (size_t a=0; a<GhostPairs.Size(); a++)
+		GhostPairs[a] = std::make_pair(newidx[GhostPairs[a].first],newidx[GhostPairs[a].second]);
+	
+	Array<Array<std::pair<size_t,size_t> > > *pairs[] = {&SMPairs, &NSMPairs, &FSMPairs, &RIGPairs, &ContPairs,
+																												&SMPairs_nb, &FSMPairs_nb, &NSMPairs_nb};
+	for (int l=0; l<8; l++)
+		for (size_t k=0; k<pairs[l]->Size(); k++)
+			for (size_t a=0; a<(*pairs[l])[k].Size(); a++)
+				(*pairs[l])[k][a] = std::make_pair(newidx[(*pairs[l])[k][a].first],newidx[(*pairs[l])[k][a].second]);
+	
+	for (size_t a=0; a<FixedParticles.Size(); a++) FixedParticles[a] = newidx[FixedParticles[a]];
+	for (size_t a=0; a<BC.InPart.Size(); a++)  BC.InPart[a]  = newidx[BC.InPart[a]];
+	for (size_t a=0; a<BC.OutPart.Size(); a++) BC.OutPart[a] = newidx[BC.OutPart[a]];
+	if (min_ts_acc_part_id >= 0 && min_ts_acc_part_id < Particles.Size()) 
+		min_ts_acc_part_id = newidx[min_ts_acc_part_id];
+	if (min_ts_vel_part_id >= 0 && min_ts_vel_part_id < Particles.Size()) 
+		min_ts_vel_part_id = newidx[min_ts_vel_part_id];
+	
+	x_nb.clear(); //Forces a new Verlet list search
+	soa_live = false; //Reloaded in the new order
+	if (numa_first_touch) PlaceParticles(); //Index to thread mapping changed
+}
+
+// Verlet list (skin) mode: pairs are searched with radius Cellfac*h + nb_skin and kept as
+// candidates. A pair outside the candidate list can only enter the kernel support if
+// 2*max displacement + Cellfac*(h growth) > nb_skin, only then the search is repeated.
+// Every step the solver pair lists are filtered from the candidates with the actual radius.
+// Returns true if a new search was done
+inline bool Domain::VerletNbUpdate(){
+	bool rebuild = m_isNbDataCleared || x_nb.size() != Particles.Size();
+	
+	if (!rebuild) {
+		std::vector <double> dmax(Nproc,0.), dhmax(Nproc,0.);
+		#pragma omp parallel for schedule (static) num_threads(Nproc)
+		for (int i=0; i<Particles.Size(); i++){
+			int T = omp_get_thread_num();
+			Vec3_t dx = Particles[i]->x - x_nb[i];
+			double d  = dot(dx,dx);
+			double dh = Particles[i]->h - h_nb[i];
+			if (d  > dmax[T])  dmax[T]  = d;
+			if (dh > dhmax[T]) dhmax[T] = dh;
+		}
+		double d = 0., dh = 0.;
+		for (int k=0; k<Nproc; k++){
+			if (dmax[k]  > d)  d  = dmax[k];
+			if (dhmax[k] > dh) dh = dhmax[k];
+		}
+		rebuild = (2.*sqrt(d) + Cellfac * dh > nb_skin);
+	}
+	
+	if (rebuild) {
+		if (!m_isNbDataCleared) ClearNbData();
+		MainNeighbourSearch();
+		if (SMPairs_nb.Size() != Nproc)
+			for (int k=0; k<Nproc; k++){
+				SMPairs_nb.Push(Initial); FSMPairs_nb.Push(Initial); NSMPairs_nb.Push(Initial);
+			}
+		for (int k=0; k<Nproc; k++){
+			SMPairs_nb[k]  = SMPairs[k];
+			FSMPairs_nb[k] = FSMPairs[k];
+			NSMPairs_nb[k] = NSMPairs[k];
+		}
+		x_nb.resize(Particles.Size());
+		h_nb.resize(Particles.Size());
+		#pragma omp parallel for schedule (static) num_threads(Nproc)
+		for (int i=0; i<Particles.Size(); i++){
+			x_nb[i] = Particles[i]->x;
+			h_nb[i] = Particles[i]->h;
+		}
+	}
+	
+	//Filter candidates with actual radius. RIGPairs are kept, ContactNbSearch filters them
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	#ifdef __GNUC__
+	for (size_t k=0; k<Nproc;k++) 
+	#else
+	for (int k=0; k<Nproc;k++) 
+	#endif
+	{
+		//Candidate counts are upper bounds, filtering does not allocate
+		SMPairs[k].Reset();		SMPairs[k].Reserve(SMPairs_nb[k].Size());
+		FSMPairs[k].Reset();	FSMPairs[k].Reserve(FSMPairs_nb[k].Size());
+		NSMPairs[k].Reset();	NSMPairs[k].Reserve(NSMPairs_nb[k].Size());
+		ContPairs[k].Reset();
+		for (size_t a=0; a<SMPairs_nb[k].Size();a++)
+			if (CheckRadius(Particles[SMPairs_nb[k][a].first],Particles[SMPairs_nb[k][a].second]))
+				SMPairs[k].Push(SMPairs_nb[k][a]);
+		for (size_t a=0; a<FSMPairs_nb[k].Size();a++)
+			if (CheckRadius(Particles[FSMPairs_nb[k][a].first],Particles[FSMPairs_nb[k][a].second]))
+				FSMPairs[k].Push(FSMPairs_nb[k][a]);
+		for (size_t a=0; a<NSMPairs_nb[k].Size();a++)
+			if (CheckRadius(Particles[NSMPairs_nb[k][a].first],Particles[NSMPairs_nb[k][a].second]))
+				NSMPairs[k].Push(NSMPairs_nb[k][a]);
+	}
+	m_isNbDataCleared = false;
+	m_gather_nb_valid = false;
+	m_pair_cache_valid = false;
+	m_color_valid = false;
+	m_nb_min_dist_valid = false;
+	
+	return rebuild;
+}
+
 inline void Domain::SaveNeighbourData(){
 		std::vector <int> nb(Particles.Size());
 		std::vector <int> contnb(Particles.Size());
@@ -568,24 +694,46 @@ int Domain::AvgNeighbourCount(){
 }
 
 void Domain::InitReductionArraysOnce(){
-  //ipair_SM
-  ipl_SM.resize(Particles.Size()); //NOT USED
-  
   ipair_SM.resize(Particles.Size());
   jpair_SM.resize(Particles.Size());
-  
-  
   first_pair_perproc.resize(Nproc);
-  std::vector<size_t> nei(MAX_NB_PER_PART);
-  for (int i=0;i<Particles.Size();i++){
-    Anei.push_back(nei);
-    Aref.push_back(nei);
-  }
 }
 inline void Domain::ResetReductionArrays(){
 
 }
 
+// Exclusive prefix sum, start has count.size()+1 entries and start[n] is the total
+// Each thread scans its own block, block offsets are then added
+inline void Domain::PrefixSum(const std::vector<size_t> &count, std::vector<size_t> &start){
+  size_t n = count.size();
+  start.resize(n+1);
+  std::vector<size_t> block(Nproc+1,0);
+  size_t bs = (n + Nproc - 1) / Nproc;
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+	#ifdef __GNUC__
+	for (size_t k=0; k<Nproc;k++) 
+	#else
+	for (int k=0; k<Nproc;k++) 
+	#endif	
+  {
+    size_t sum = 0;
+    for (size_t i=k*bs; i<std::min(n,(k+1)*bs); i++) sum += count[i];
+    block[k+1] = sum;
+  }
+  for (int k=0; k<Nproc; k++) block[k+1] += block[k];
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+	#ifdef __GNUC__
+	for (size_t k=0; k<Nproc;k++) 
+	#else
+	for (int k=0; k<Nproc;k++) 
+	#endif	
+  {
+    size_t sum = block[k];
+    for (size_t i=k*bs; i<std::min(n,(k+1)*bs); i++) {start[i] = sum; sum += count[i];}
+  }
+  start[n] = block[Nproc];
+}
+
 #ifdef NONLOCK_TEST
 void Domain::CheckParticlePairs(const int &i){
   cout << "Particle i: "<<i<<endl;
@@ -593,48 +741,44 @@ void Domain::CheckParticlePairs(const int &i){
   cout << "ipairs: "<<ipair_SM[i]<<endl;
   cout << "jpairs: "<<jpair_SM[i]<<endl;
   
-  cout << "First pair pos"<<ipl_SM[i]<<endl;
+  cout << "First pair pos"<<Anei_start[i]<<endl;
   cout << "Nb list"<<endl;
-  for (int n=0;n< MAX_NB_PER_PART;n++){
-    cout << Anei[i][n] <<", ";
+  for (size_t n=Anei_start[i];n< Anei_start[i+1];n++){
+    cout << Anei[n] <<", ";
   } 
   cout  << endl<<"Ref list "<<endl;
-  for (int n=0;n< MAX_NB_PER_PART;n++)
-    cout << Aref[i][n]<<", ";
+  for (size_t n=Anei_start[i];n< Anei_start[i+1];n++)
+    cout << Aref[n]<<", ";
   cout << endl;
   cout << "Pair detail "<<endl;
   cout << "i<j pairs"<<endl;
   for (int n=0;n< ipair_SM[i];n++)
-    cout << pair_test[Aref[i][n]].first<<", "<<pair_test[Aref[i][n]].second<<endl;
+    cout << pair_test[Aref[Anei_start[i]+n]].first<<", "<<pair_test[Aref[Anei_start[i]+n]].second<<endl;
   cout <<"j>i pairs"<<endl;
   for (int n = 0;n< jpair_SM[i];n++)
-    cout <<pair_test[Aref[i][MAX_NB_PER_PART-1-n]].first<<", "<<pair_test[Aref[i][MAX_NB_PER_PART-1-n]].second<<endl;
+    cout <<pair_test[Aref[Anei_start[i]+ipair_SM[i]+n]].first<<", "<<pair_test[Aref[Anei_start[i]+ipair_SM[i]+n]].second<<endl;
   
   cout << "Done. "<<endl;
 }
 #endif
 // Calculate All things for new reduction
+// Neighbour (Anei) and pair reference (Aref) tables in CSR form, sized to the actual 
+// pair count. Row i starts at Anei_start[i], first the ipair_SM[i] neighbours j > i, 
+// then the jpair_SM[i] neighbours j < i. Each part is sorted by pair, as the serial fill
 inline void Domain::CalcPairPosList(){                             //Calculate position list for every particle
   
   #ifdef NONLOCK_TEST
     pair_test.clear();
   #endif
+  first_pair_perproc.resize(Nproc);
+  ipair_SM.resize(Particles.Size());
+  jpair_SM.resize(Particles.Size());
   first_pair_perproc[0] = 0;
   pair_count = 0;
-  for (int p=0;p<Nproc;p++)first_pair_perproc[p] = 0;
-  int count = 0;
   for (int p=0;p<Nproc;p++) {
-    if (p > 0 ){
-      for (int j=0;j<p;j++)
-        first_pair_perproc[p]+=SMPairs[j].Size();
-    }
+    first_pair_perproc[p] = pair_count;
     pair_count += SMPairs[p].Size();
   }
-  // cout << "Pairs per proc"<<endl;
-  // for (int p=0;p<Nproc;p++)
-    // cout << SMPairs[p].Size()<<endl;
-   // cout << "First index per proc "<<endl;
-  // for (int p=0;p<Nproc;p++) cout << first_pair_perproc[p]<<endl;
 
   pair_force.resize(pair_count);
   temp_force.resize(pair_count);
@@ -644,53 +788,253 @@ inline void Domain::CalcPairPosList(){                             //Calculate p
   //cout << "Pair Count: " << pair_count << endl;
 
   #pragma omp parallel for schedule (static) num_threads(Nproc)
-    for (int i = 0;i<Particles.Size();i++){
-      ipair_SM[i]=0;jpair_SM[i]=0;
-      //ipl_SM[i]=0;  
-      for (int n=0;n<MAX_NB_PER_PART;n++){
-        Anei[i][n]=0;
-        Aref[i][n]=0;
-      }
-    }
- 
-  //cout << "calc tables "<<endl;
-  //TODO: parallelize?
-  //#pragma omp parallel for schedule (static) num_threads(Nproc)
-  for (int k=0;k<Nproc;k++){
-    for (int pp=0;pp<SMPairs[k].Size();pp++){
-      //int p = first_pair_perproc[k] + pp;
-
-      int i = std::min(SMPairs[k][pp].first,SMPairs[k][pp].second);
-      int j = std::max(SMPairs[k][pp].first,SMPairs[k][pp].second);
-      #ifdef NONLOCK_TEST
-        pair_test.push_back(std::make_pair(i,j)); //ONLY FOR TEST
-      #endif
-      // if (i==2000||j==2000){ 
-        // cout << "Pair i j "<< i << ", "<<j<<", "<<first_pair_perproc[k]+pp<<endl;
-        // cout << "k pp "<<k <<", "<<pp<<endl;
-      // }
-      Anei[i][ipair_SM[i]] = j; //Only stores j>i
-      Anei[j][MAX_NB_PER_PART - 1 - jpair_SM[j]] = i; //Only stores j>i
-      Aref[i][ipair_SM[i]] = first_pair_perproc[k]+pp;
-      Aref[j][MAX_NB_PER_PART - 1 - jpair_SM[j]] = first_pair_perproc[k]+pp;
+  for (int i = 0;i<Particles.Size();i++){
+    ipair_SM[i]=0;jpair_SM[i]=0;
+  }
+  
+  //Count
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+	#ifdef __GNUC__
+	for (size_t k=0; k<Nproc;k++) 
+	#else
+	for (int k=0; k<Nproc;k++) 
+	#endif	
+  {
+    for (size_t pp=0;pp<SMPairs[k].Size();pp++){
+      size_t i = std::min(SMPairs[k][pp].first,SMPairs[k][pp].second);
+      size_t j = std::max(SMPairs[k][pp].first,SMPairs[k][pp].second);
+      #pragma omp atomic
       ipair_SM[i]++;            //ngji in 
+      #pragma omp atomic
       jpair_SM[j]++;            //njli, pairs in which j has particles with index smaller than it
+    }
+  }
+  
+  std::vector<size_t> nbcount(Particles.Size());
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+  for (int i = 0;i<Particles.Size();i++)
+    nbcount[i] = ipair_SM[i] + jpair_SM[i];
+  PrefixSum(nbcount, Anei_start);
+  Anei.resize(Anei_start[Particles.Size()]);
+  Aref.resize(Anei_start[Particles.Size()]);
+  
+  //Fill, cursors for i < j and j < i parts
+  std::vector<size_t> icur(Particles.Size()), jcur(Particles.Size());
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+  for (int i = 0;i<Particles.Size();i++){
+    icur[i] = Anei_start[i];
+    jcur[i] = Anei_start[i] + ipair_SM[i];
+  }
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+	#ifdef __GNUC__
+	for (size_t k=0; k<Nproc;k++) 
+	#else
+	for (int k=0; k<Nproc;k++) 
+	#endif	
+  {
+    for (size_t pp=0;pp<SMPairs[k].Size();pp++){
+      size_t i = std::min(SMPairs[k][pp].first,SMPairs[k][pp].second);
+      size_t j = std::max(SMPairs[k][pp].first,SMPairs[k][pp].second);
+      size_t n;
+      #if _OPENMP >= 201107
+      #pragma omp atomic capture
+      #else
+      #pragma omp critical (pair_pos)
+      #endif
+      n = icur[i]++;
+      Anei[n] = j; Aref[n] = first_pair_perproc[k]+pp;
+      #if _OPENMP >= 201107
+      #pragma omp atomic capture
+      #else
+      #pragma omp critical (pair_pos)
+      #endif
+      n = jcur[j]++;
+      Anei[n] = i; Aref[n] = first_pair_perproc[k]+pp;
     }//Pairs
   }//Proc
   
-  // ipl_SM[0] = 0;
-  // #pragma omp parallel for schedule (static) num_threads(Nproc)
-  // for (int i=0; i<Particles.Size();i++){
-    // for (int j=0; j<i;j++)
-      // ipl_SM[i] += ipair_SM[j];//Nisimura 2015 Eqn 6
-  // }
+  //Order by pair reference, sums do not depend on thread scheduling
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+  for (int i = 0;i<Particles.Size();i++){
+    std::vector< std::pair<size_t,size_t> > row;
+    size_t b[3] = {Anei_start[i], Anei_start[i] + ipair_SM[i], Anei_start[i+1]};
+    for (int part=0;part<2;part++){
+      row.clear();
+      for (size_t n=b[part];n<b[part+1];n++) row.push_back(std::make_pair(Aref[n],Anei[n]));
+      std::sort(row.begin(),row.end());
+      for (size_t n=b[part];n<b[part+1];n++) {Aref[n] = row[n-b[part]].first; Anei[n] = row[n-b[part]].second;}
+    }
+  }
   
-  int max_nb=0;
-  for (int i=0; i<Particles.Size();i++){
-    if (ipair_SM[i]+jpair_SM[i]>max_nb)
-      max_nb = ipair_SM[i]+jpair_SM[i];
+  #ifdef NONLOCK_TEST
+  for (int k=0;k<Nproc;k++)
+    for (int pp=0;pp<SMPairs[k].Size();pp++)
+      pair_test.push_back(std::make_pair(std::min(SMPairs[k][pp].first,SMPairs[k][pp].second),
+                                         std::max(SMPairs[k][pp].first,SMPairs[k][pp].second))); //ONLY FOR TEST
+  #endif
+}
+
+// Pair geometry cache: xij, rij, h, kernel and gradient factor of every SMPairs pair, 
+// stored in pair order so each pass streams it once. Rebuilt if the pair list changed
+// or any position or smoothing length differs from the ones it was built with, so the
+// pair passes of a step (accel, density, rate tensors, temperature) share it
+inline bool Domain::UsePairCache(){
+  if (!pair_cache) return false;
+  int np = Particles.Size();
+  int changed = (!m_pair_cache_valid || pgeom_x.size() != np) ? 1 : 0;
+  if (!changed) {
+    #pragma omp parallel for schedule (static) reduction(+:changed) num_threads(Nproc)
+    for (int i=0; i<np; i++){
+      const Vec3_t &x = Particles[i]->x;
+      if (x(0) != pgeom_x[i](0) || x(1) != pgeom_x[i](1) || x(2) != pgeom_x[i](2) || Particles[i]->h != pgeom_h[i])
+        changed = 1;
+    }
   }
-  //cout << "Max nb"<<max_nb<<endl;
+  if (changed) BuildPairCache();
+  return true;
+}
+
+inline void Domain::BuildPairCache(){
+  pgeom_off.resize(Nproc);
+  size_t count = 0;
+  for (int k=0; k<Nproc; k++) {pgeom_off[k] = count; count += SMPairs[k].Size();}
+  if (pgeom.size() < count) pgeom.resize(count); //Never shrunk
+  
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+	#ifdef __GNUC__
+	for (size_t k=0; k<Nproc;k++) 
+	#else
+	for (int k=0; k<Nproc;k++) 
+	#endif	
+  {
+    for (size_t p=0; p<SMPairs[k].Size();p++){
+      Particle *P1 = Particles[SMPairs[k][p].first];
+      Particle *P2 = Particles[SMPairs[k][p].second];
+      PairGeom &g = pgeom[pgeom_off[k]+p];
+      for (int c=0;c<3;c++) g.xij[c] = P1->x(c) - P2->x(c);
+      g.h   = 0.5*(P1->h + P2->h);
+      g.rij = sqrt(g.xij[0]*g.xij[0] + g.xij[1]*g.xij[1] + g.xij[2]*g.xij[2]);
+      g.GK  = m_kernel.gradW(g.rij/g.h, g.h);
+      g.K   = m_kernel.W    (g.rij/g.h, g.h);
+    }
+  }
+  
+  pgeom_x.resize(Particles.Size());
+  pgeom_h.resize(Particles.Size());
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+  for (int i=0; i<Particles.Size(); i++){
+    pgeom_x[i] = Particles[i]->x;
+    pgeom_h[i] = Particles[i]->h;
+  }
+  m_pair_cache_valid = true;
+}
+
+//swap: pair taken as (second, first), xij changes sign
+inline void Domain::GetPairGeom(const int &k, const size_t &p, const bool &swap, Vec3_t &xij, double &rij, double &h, double &GK, double &K){
+  const PairGeom &g = pgeom[pgeom_off[k]+p];
+  double s = swap ? -1.0 : 1.0;
+  xij = Vec3_t(s*g.xij[0], s*g.xij[1], s*g.xij[2]);
+  rij = g.rij;  h = g.h;
+  GK  = g.GK;   K = g.K;
+}
+
+// Pair coloring: each pair of SMPairs gets the lowest color not used yet by any of 
+// its two particles (greedy edge coloring, about the max neighbour count colors). 
+// All threads sweep the same color at a time, so no particle is written by two threads 
+// and the scatter needs no locks. Rebuilt only after the pair lists change.
+inline bool Domain::ColoredSum(){
+  return colored_sum && !nonlock_sum && !LockFreeSum() && !GatherKernels();
+}
+
+inline void Domain::BuildPairColoring(){
+  size_t np = Particles.Size();
+  std::vector <size_t> off(Nproc+1);
+  size_t count = 0;
+  for (int k=0; k<Nproc; k++) {off[k] = count; count += SMPairs[k].Size();}
+  off[Nproc] = count;
+  
+  std::vector <int> color(count);
+  std::vector <unsigned long long> used; //Color bits already taken by each particle
+  int words = 2;
+  bool done = false;
+  while (!done) {
+    used.assign(np*words, 0ULL);
+    m_ncolors = 0;
+    done = true;
+    for (int k=0; k<Nproc && done; k++)
+      for (size_t p=0; p<SMPairs[k].Size(); p++){
+        unsigned long long *ui = &used[SMPairs[k][p].first *words];
+        unsigned long long *uj = &used[SMPairs[k][p].second*words];
+        int c = -1;
+        for (int w=0; w<words && c<0; w++){
+          unsigned long long fr = ~(ui[w] | uj[w]);
+          if (fr) {
+            int b = 0;
+            while (!((fr>>b) & 1ULL)) b++;
+            c = 64*w + b;
+          }
+        }
+        if (c < 0) {words *= 2; done = false; break;} //Out of bits, start again with more
+        ui[c/64] |= 1ULL<<(c%64);
+        uj[c/64] |= 1ULL<<(c%64);
+        color[off[k]+p] = c;
+        if (c >= m_ncolors) m_ncolors = c+1;
+      }
+  }
+  
+  //Counting sort of each thread list by color, pair order kept inside a color
+  int nc1 = m_ncolors+1;
+  col_start.assign(Nproc*nc1, 0);
+  col_p.resize(count);
+  #pragma omp parallel for schedule (static) num_threads(Nproc)
+	#ifdef __GNUC__
+	for (size_t k=0; k<Nproc;k++) 
+	#else
+	for (int k=0; k<Nproc;k++) 
+	#endif	
+  {
+    size_t *cs = &col_start[k*nc1];
+    for (size_t p=0; p<SMPairs[k].Size(); p++) cs[color[off[k]+p]+1]++;
+    cs[0] = off[k];
+    for (int c=1; c<nc1; c++) cs[c] += cs[c-1];
+    std::vector <size_t> pos(cs, cs+m_ncolors);
+    for (size_t p=0; p<SMPairs[k].Size(); p++) col_p[pos[color[off[k]+p]]++] = p;
+  }
+  m_color_valid = true;
+}
+
+//Returns the number of sweeps of a pair pass, 1 if not colored
+inline int Domain::BeginPairSweeps(const bool &colored){
+  m_colored_pass = false;
+  if (!colored) return 1;
+  if (!m_color_valid) BuildPairColoring();
+  m_colored_pass = true;
+  return m_ncolors;
+}
+
+inline void Domain::EndPairSweeps(){
+  m_colored_pass = false;
+}
+
+//Range of q for thread k in sweep col, the pair index is ColorPair(q)
+inline size_t Domain::ColorBegin(const int &k, const int &col){
+  return m_colored_pass ? col_start[k*(m_ncolors+1)+col] : 0;
+}
+
+inline size_t Domain::ColorEnd(const int &k, const int &col){
+  return m_colored_pass ? col_start[k*(m_ncolors+1)+col+1] : SMPairs[k].Size();
+}
+
+inline size_t Domain::ColorPair(const size_t &q){
+  return m_colored_pass ? col_p[q] : q;
+}
+
+inline void Domain::PairLock(Particle *P){
+  if (!m_colored_pass) omp_set_lock(&P->my_lock);
+}
+
+inline void Domain::PairUnlock(Particle *P){
+  if (!m_colored_pass) omp_unset_lock(&P->my_lock);
 }
 
 // Nishimura (2011)
@@ -712,29 +1056,4 @@ inline void Domain::CalcPairPosList(){                             //Calculate p
 // 13: end do
 // 14: end do
 
-// OLD: DO NOT USE
-inline void Domain::CalcRefTable(){
-
-  #pragma omp parallel for schedule (static) num_threads(Nproc)
-    for (int i = 0;i<Particles.Size();i++){
-      for (int n=0;n < ipair_SM[i];n++){ //neighbour i < j count 
-        int pair = ipl_SM[i] + n; //According with ipl_SM[i]
-        // if (pair >= pair_count) {
-          // cout << "ERROR pair " <<pair << "> pair_count "<< pair_count << endl;
-          // cout << "i n "<<i<<", "<<n<<endl;
-          // throw new Fatal("ERROR");
-        // }
-        Aref [i][n] = pair;
-        int j = Anei[i][n];
-        for (int k=0; k < jpair_SM[j];k++){
-          if ( Anei[j][MAX_NB_PER_PART-1-k] == i)
-            //Aref [j][ipair_SM[j]+k]= pair;
-            Aref [j][MAX_NB_PER_PART-1-k]= pair;
-        }
-      }//nb
-    }//particle
-    
-  //cout << "aref "<<Aref[0][0]<<endl;
-}
-
 }; //SPH
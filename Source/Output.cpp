@@ -72,221 +72,90 @@ inline void Domain::PrintInput(char const * FileKey)
 	of.close();
 }
 
-inline void Domain::WriteXDMF (char const * FileKey)
+//Writes the files of a staged frame. Called by the output thread if async_output is set,
+//so it only uses the frame and not the domain
+inline void WriteOutputFrame (const OutputFrame &f)
 {
-    String fn(FileKey);
+  if (f.xdmf) {
+    String fn(f.key.c_str());
     fn.append(".hdf5");
     hid_t file_id;
     file_id = H5Fcreate(fn.CStr(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
 
-
-    float * Posvec	= new float[3*Particles.Size()];
-    float * Velvec	= new float[3*Particles.Size()];
-    float * ACCvec	= new float[3*Particles.Size()];
-    float * Pressure	= new float[  Particles.Size()];
-    float * Prop1	= new float[  Particles.Size()];
-    float * Prop2	= new float[  Particles.Size()];
-    float * Prop3	= new float[  Particles.Size()];
-    float * Density	= new float[  Particles.Size()];
-    float * Mass	= new float[  Particles.Size()];
-    float * sh		= new float[  Particles.Size()];
-    int   * Tag			= new int  [  Particles.Size()];
-    float * Sigma		= new float[6*Particles.Size()];
-    float * ShearS   	= new float[6*Particles.Size()]; 	//LUCIANO
-    float * Strain		= new float[6*Particles.Size()];
-    float * StrainRate	= new float[6*Particles.Size()];
-	float * Strain_pl		= new float[6*Particles.Size()];
-	float * Sigma_eq		= new float[  Particles.Size()];	//LUCIANO
-	float * Temp				= new float[  Particles.Size()];	//LUCIANO
-	float * Pl_Strain		= new float[  Particles.Size()];	//LUCIANO
-	int   * Nb					= new int  [  Particles.Size()];	//LUCIANO
-	int   * ContNb			= new int  [  Particles.Size()];	//LUCIANO
-    float * Disvec	= new float[3*Particles.Size()];		//LUCIANO
-		float * ContForce	= new float[3*Particles.Size()];		//LUCIANO
-		// float * TgDir 		= new float[3*Particles.Size()];
-    // float * Normvec	= new float[3*Particles.Size()];
-    float * deltacont	= new float[Particles.Size()];		//LUCIANO
-		float * eff_str_rate	= new float[ Particles.Size()];		//LUCIANO
-		float * gradcorrmat = new float [6 * Particles.Size()];
-		float * q_friction  = new float [Particles.Size()];
-    float * c_shearabs  = new float [Particles.Size()];
-    float * ps_en  = new float [Particles.Size()];
-		
-		float * Damage = new float [Particles.Size()];
-    
-	double P1,P2,P3;
-
-    #pragma omp parallel for schedule (static) private(P1,P2,P3) num_threads(Nproc)
-    for (int i=0;i<Particles.Size();i++)
-    {
-		//LUCIANO 
-		Particles[i]->CalculateEquivalentStress();
-		
-        Posvec  [3*i  ] = float(Particles[i]->x(0));
-        Posvec  [3*i+1] = float(Particles[i]->x(1));
-        Posvec  [3*i+2] = float(Particles[i]->x(2));
-        Velvec  [3*i  ] = float(Particles[i]->v(0));
-        Velvec  [3*i+1] = float(Particles[i]->v(1));
-        Velvec  [3*i+2] = float(Particles[i]->v(2));
-        ACCvec  [3*i  ] = float(Particles[i]->a(0));
-        ACCvec  [3*i+1] = float(Particles[i]->a(1));
-        ACCvec  [3*i+2] = float(Particles[i]->a(2));
-       	Pressure[i    ] = float(Particles[i]->Pressure);
-        Density [i    ] = float(Particles[i]->Density);
-        Mass	[i    ] = float(Particles[i]->Mass);
-        sh		[i    ] = float(Particles[i]->h);
-        Tag     [i    ] = int  (Particles[i]->ID);
-        Sigma   [6*i  ] = float(Particles[i]->Sigma(0,0));  //Originally0,0
-        Sigma   [6*i+1] = float(Particles[i]->Sigma(1,1));	//Originally0,1
-        Sigma   [6*i+2] = float(Particles[i]->Sigma(2,2));  //Originally0,2
-        Sigma   [6*i+3] = float(Particles[i]->Sigma(0,1));  //Originally1,1
-        Sigma   [6*i+4] = float(Particles[i]->Sigma(1,2));  //Originally1,2
-        Sigma   [6*i+5] = float(Particles[i]->Sigma(0,2));  //Originally2,2
-        ShearS   [6*i  ] = float(Particles[i]->ShearStress(0,0)); //Originally0,0
-        ShearS   [6*i+1] = float(Particles[i]->ShearStress(1,1));//Originally0,1
-        ShearS   [6*i+2] = float(Particles[i]->ShearStress(2,2)); //Originally0,2
-        ShearS   [6*i+3] = float(Particles[i]->ShearStress(0,1)); //Originally1,1
-        ShearS   [6*i+4] = float(Particles[i]->ShearStress(1,2)); //Originally1,2
-        ShearS   [6*i+5] = float(Particles[i]->ShearStress(0,2)); //Originally2,2
-        Strain  [6*i  ] = float(Particles[i]->Strain(0,0));
-        Strain  [6*i+1] = float(Particles[i]->Strain(1,1));
-        Strain  [6*i+2] = float(Particles[i]->Strain(2,2));
-        Strain  [6*i+3] = float(Particles[i]->Strain(0,1));
-        Strain  [6*i+4] = float(Particles[i]->Strain(1,2));
-        Strain  [6*i+5] = float(Particles[i]->Strain(0,2));
-        StrainRate  [6*i  ] = float(Particles[i]->StrainRate(0,0));
-        StrainRate  [6*i+1] = float(Particles[i]->StrainRate(1,1));
-        StrainRate  [6*i+2] = float(Particles[i]->StrainRate(2,2));
-        StrainRate  [6*i+3] = float(Particles[i]->StrainRate(0,1));
-        StrainRate  [6*i+4] = float(Particles[i]->StrainRate(1,2));
-        StrainRate  [6*i+5] = float(Particles[i]->StrainRate(0,2));
-        Strain_pl  [6*i  ] = float(Particles[i]->Strain_pl(0,0));
-        Strain_pl  [6*i+1] = float(Particles[i]->Strain_pl(1,1));
-        Strain_pl  [6*i+2] = float(Particles[i]->Strain_pl(2,2));
-        Strain_pl  [6*i+3] = float(Particles[i]->Strain_pl(0,1));
-        Strain_pl  [6*i+4] = float(Particles[i]->Strain_pl(1,2));
-        Strain_pl  [6*i+5] = float(Particles[i]->Strain_pl(0,2));
-        
-				gradcorrmat  [6*i  ] = float(Particles[i]->gradCorrM(0,0));
-        gradcorrmat  [6*i+1] = float(Particles[i]->gradCorrM(1,1));
-        gradcorrmat  [6*i+2] = float(Particles[i]->gradCorrM(2,2));
-        gradcorrmat  [6*i+3] = float(Particles[i]->gradCorrM(0,1));
-        gradcorrmat  [6*i+4] = float(Particles[i]->gradCorrM(1,2));
-        gradcorrmat  [6*i+5] = float(Particles[i]->gradCorrM(0,2));
-				
-				Sigma_eq[i    ] 	= float(Particles[i]->Sigma_eq);
-				Temp	[i    ] 		= float(Particles[i]->T);
-				Pl_Strain	[i] 		= float(Particles[i]->pl_strain);
-				Nb		[i    ] 		= int(Particles[i]->Nb); //All neighbours
-				ContNb		[i    ] = int(Particles[i]->ContNb); //Contact Neighbours
-		
-        Disvec  [3*i  ] = float(Particles[i]->Displacement(0));
-        Disvec  [3*i+1] = float(Particles[i]->Displacement(1));
-        Disvec  [3*i+2] = float(Particles[i]->Displacement(2));		
-
-        ContForce  [3*i  ] = float(Particles[i]->contforce(0));
-        ContForce  [3*i+1] = float(Particles[i]->contforce(1));
-        ContForce  [3*i+2] = float(Particles[i]->contforce(2));	
-        
-        q_friction [i] = float(Particles[i]->friction_hfl);
-        c_shearabs [i] = float(Particles[i]->cshearabs); 
-        ps_en [i] = float(Particles[i]->ps_energy);
-        
-        // TgDir  [3*i  ] 	= float(Particles[i]->tgdir(0));
-        // TgDir  [3*i+1] 	= float(Particles[i]->tgdir(1));
-        // TgDir	[3*i+2] 	= float(Particles[i]->tgdir(2));	
-
-        // Normvec  [3*i  ] 	= float( Particles[i]->normal(0));
-        // Normvec  [3*i+1] 	= float(Particles[i]->normal(1));
-        // Normvec	[3*i+2] 	= float(Particles[i]->normal(2));	
-				
-        deltacont [i] =float(Particles[i]->delta_cont);       
-        
-        eff_str_rate [i] = float(Particles[i]->eff_strain_rate);
-
-				if (model_damage)
-					Damage [i] = float(Particles[i]->dam_D);
-				
-	UserOutput(Particles[i],P1,P2,P3);
-        Prop1	[i    ] = float(P1);
-        Prop2	[i    ] = float(P2);
-        Prop3	[i    ] = float(P3);
-   }
-
     int data[1];
     String dsname;
     hsize_t dims[1];
     dims[0]=1;
-    data[0]=Particles.Size();
+    data[0]=int(f.np);
     dsname.Printf("/NP");
     H5LTmake_dataset_int(file_id,dsname.CStr(),1,dims,data);
-    dims[0] = 3*Particles.Size();
+    dims[0] = 3*f.np;
     dsname.Printf("Position");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Posvec);
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.pos[0]);
     dsname.Printf("Velocity");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Velvec);
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.vel[0]);
     dsname.Printf("Acceleration");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,ACCvec);
-    dims[0] = Particles.Size();
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.acc[0]);
+    dims[0] = f.np;
     dsname.Printf("Tag");
-    H5LTmake_dataset_int(file_id,dsname.CStr(),1,dims,Tag);
+    H5LTmake_dataset_int(file_id,dsname.CStr(),1,dims,&f.tag[0]);
     dsname.Printf("Pressure");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Pressure);
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.pressure[0]);
     dsname.Printf("Density");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Density);
-    dsname.Printf(OutputName[0]);
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Prop1);
-    dsname.Printf(OutputName[1]);
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Prop2);
-    dsname.Printf(OutputName[2]);
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Prop3);
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.density[0]);
+    dsname.Printf("%s",f.name[0].c_str());
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.prop[0][0]);
+    dsname.Printf("%s",f.name[1].c_str());
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.prop[1][0]);
+    dsname.Printf("%s",f.name[2].c_str());
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.prop[2][0]);
     dsname.Printf("Mass");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Mass);
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.mass[0]);
     dsname.Printf("h");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,sh);
-    dims[0] = 6*Particles.Size();
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.h[0]);
+    dims[0] = 6*f.np;
     dsname.Printf("Sigma");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Sigma);
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.sigma[0]);
     dsname.Printf("ShearS");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Sigma);
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.sigma[0]);
     dsname.Printf("Strain");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Strain);
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.strain[0]);
     dsname.Printf("StrainRate");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,StrainRate);
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.strain_rate[0]);
     dsname.Printf("Strain_pl");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Strain_pl);
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.strain_pl[0]);
     dsname.Printf("gradcorrmat");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,gradcorrmat);
-    dims[0] = Particles.Size();
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.gradcorr[0]);
+    dims[0] = f.np;
 	dsname.Printf("Sigma_eq");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Sigma_eq);
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.sigma_eq[0]);
 	dsname.Printf("Temperature");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Temp);
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.temp[0]);
     dsname.Printf("Pl_Strain");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Pl_Strain);
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.pl_strain[0]);
     dsname.Printf("Neighbors");
-    H5LTmake_dataset_int(file_id,dsname.CStr(),1,dims,Nb);
+    H5LTmake_dataset_int(file_id,dsname.CStr(),1,dims,&f.nb[0]);
     dsname.Printf("ContNeib");
-    H5LTmake_dataset_int(file_id,dsname.CStr(),1,dims,ContNb);
+    H5LTmake_dataset_int(file_id,dsname.CStr(),1,dims,&f.contnb[0]);
     dsname.Printf("q_friction");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,q_friction);
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.q_friction[0]);
     dsname.Printf("c_shearabs");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,c_shearabs);
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.c_shearabs[0]);
 
     dsname.Printf("ps_en");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,ps_en);
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.ps_en[0]);
 
-		if (model_damage){
+		if (f.damage){
 			dsname.Printf("Damage");
-			H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Damage);			
+			H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.dam[0]);			
 			
 		}
     
-    dims[0] = 3*Particles.Size();
+    dims[0] = 3*f.np;
 	dsname.Printf("Displacement");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Disvec);
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.disp[0]);
 	dsname.Printf("Contact Force");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,ContForce);	
+    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,&f.cforce[0]);	
 		
 
 
@@ -299,39 +168,6 @@ inline void Domain::WriteXDMF (char const * FileKey)
 	// dsname.Printf("Eff Strain Rate");
     // H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,eff_str_rate);	
 		
-    delete [] Posvec;
-    delete [] Velvec;
-    delete [] ACCvec;
-    delete [] Pressure;
-    delete [] Prop1;
-    delete [] Prop2;
-    delete [] Prop3;
-    delete [] Density;
-    delete [] Mass;
-    delete [] sh;
-    delete [] Tag;
-    delete [] Sigma;
-    delete [] ShearS;
-    delete [] Strain;
-    delete [] StrainRate;
-    delete [] Strain_pl;
-	delete [] Temp;
-	delete [] Sigma_eq;
-	delete [] Pl_Strain;
-	delete [] Nb;
-	delete [] ContNb;
-	delete [] Disvec;
-	delete [] ContForce;
-	// delete [] TgDir;
-  // delete [] Normvec;
-  // delete [] deltacont;
-	//delete [] eff_str_rate;
-	delete [] gradcorrmat;
-  delete [] q_friction;
-  delete [] c_shearabs;
-  delete [] ps_en;
-	delete [] Damage;
-	
    //Closing the file
     H5Fflush(file_id,H5F_SCOPE_GLOBAL);
     H5Fclose(file_id);
@@ -343,166 +179,166 @@ inline void Domain::WriteXDMF (char const * FileKey)
     oss << "<Xdmf Version=\"2.0\">\n";
     oss << " <Domain>\n";
     oss << "   <Grid Name=\"SPHCenter\" GridType=\"Uniform\">\n";
-    oss << "     <Topology TopologyType=\"Polyvertex\" NumberOfElements=\"" << Particles.Size() << "\"/>\n";
+    oss << "     <Topology TopologyType=\"Polyvertex\" NumberOfElements=\"" << f.np << "\"/>\n";
     oss << "     <Geometry GeometryType=\"XYZ\">\n";
-    oss << "       <DataItem Format=\"HDF\" NumberType=\"Float\" Precision=\"10\" Dimensions=\"" << Particles.Size() << " 3\" >\n";
+    oss << "       <DataItem Format=\"HDF\" NumberType=\"Float\" Precision=\"10\" Dimensions=\"" << f.np << " 3\" >\n";
     oss << "        " << fn.CStr() <<":/Position \n";
     oss << "       </DataItem>\n";
     oss << "     </Geometry>\n";
     oss << "     <Attribute Name=\"Tag\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Int\" Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Int\" Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/Tag \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"Position\" AttributeType=\"Vector\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 3\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << " 3\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/Position \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"Velocity\" AttributeType=\"Vector\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 3\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << " 3\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/Velocity \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"Acceleration\" AttributeType=\"Vector\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 3\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << " 3\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/Acceleration \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"Density\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/Density \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"h\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/h \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"Pressure\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/Pressure \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
-    oss << "     <Attribute Name=\"" << OutputName[0] << "\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
-    oss << "        " << fn.CStr() <<":/" << OutputName[0] << " \n";
+    oss << "     <Attribute Name=\"" << f.name[0] << "\" AttributeType=\"Scalar\" Center=\"Node\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
+    oss << "        " << fn.CStr() <<":/" << f.name[0] << " \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
-    oss << "     <Attribute Name=\"" << OutputName[1] << "\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
-    oss << "        " << fn.CStr() <<":/" << OutputName[1] << " \n";
+    oss << "     <Attribute Name=\"" << f.name[1] << "\" AttributeType=\"Scalar\" Center=\"Node\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
+    oss << "        " << fn.CStr() <<":/" << f.name[1] << " \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
-    oss << "     <Attribute Name=\"" << OutputName[2] << "\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
-    oss << "        " << fn.CStr() <<":/" << OutputName[2] << " \n";
+    oss << "     <Attribute Name=\"" << f.name[2] << "\" AttributeType=\"Scalar\" Center=\"Node\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
+    oss << "        " << fn.CStr() <<":/" << f.name[2] << " \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"Sigma\" AttributeType=\"Tensor6\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 6\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << " 6\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/Sigma \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
 	oss << "     <Attribute Name=\"ShearS\" AttributeType=\"Tensor6\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 6\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << " 6\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/ShearS \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"Strain\" AttributeType=\"Tensor6\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 6\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << " 6\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/Strain \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"StrainRate\" AttributeType=\"Tensor6\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 6\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << " 6\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/StrainRate \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"Strain_pl\" AttributeType=\"Tensor6\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 6\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << " 6\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/Strain_pl \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"gradcorrmat\" AttributeType=\"Tensor6\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 6\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << " 6\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/gradcorrmat \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"Temperature\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/Temperature \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"Sigma_eq\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/Sigma_eq \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"Pl_Strain\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/Pl_Strain \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"Neighbors\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Int\" Precision=\"10\"  Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Int\" Precision=\"10\"  Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/Neighbors \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"ContNeib\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Int\" Precision=\"10\"  Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Int\" Precision=\"10\"  Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/ContNeib \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"Displacement\" AttributeType=\"Vector\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 3\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << " 3\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/Displacement \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"Contact Force\" AttributeType=\"Vector\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 3\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << " 3\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/Contact Force \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n";
     oss << "     <Attribute Name=\"q_friction\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/q_friction \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n"; 
     oss << "     <Attribute Name=\"c_shearabs\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/c_shearabs \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n"; 
     oss << "     <Attribute Name=\"ps_en\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
+    oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
     oss << "        " << fn.CStr() <<":/ps_en \n";
     oss << "       </DataItem>\n";
     oss << "     </Attribute>\n"; 
-		if (model_damage){
+		if (f.damage){
 			oss << "     <Attribute Name=\"Damage\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-			oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
+			oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
 			oss << "        " << fn.CStr() <<":/Damage \n";
 			oss << "       </DataItem>\n";
 			oss << "     </Attribute>\n"; 			
 		}
   // oss << "     <Attribute Name=\"Tg Dir\" AttributeType=\"Vector\" Center=\"Node\">\n";
-    // oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 3\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
+    // oss << "       <DataItem Dimensions=\"" << f.np << " 3\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
     // oss << "        " << fn.CStr() <<":/Tg Dir \n";
     // oss << "       </DataItem>\n";
     // oss << "     </Attribute>\n";
     // oss << "     <Attribute Name=\"Normal Vec\" AttributeType=\"Vector\" Center=\"Node\">\n";
-    // oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 3\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
+    // oss << "       <DataItem Dimensions=\"" << f.np << " 3\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
     // oss << "        " << fn.CStr() <<":/Normal Vec \n";
     // oss << "       </DataItem>\n";
     // oss << "     </Attribute>\n";
     // oss << "     <Attribute Name=\"deltacont\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    // oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Int\" Precision=\"10\"  Format=\"HDF\">\n";
+    // oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Int\" Precision=\"10\"  Format=\"HDF\">\n";
     // oss << "        " << fn.CStr() <<":/deltacont \n";
     // oss << "       </DataItem>\n";
     // oss << "     </Attribute>\n";
     // oss << "     <Attribute Name=\"Eff Strain Rate\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    // oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
+    // oss << "       <DataItem Dimensions=\"" << f.np << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
     // oss << "        " << fn.CStr() <<":/Eff Strain Rate \n";
     // oss << "       </DataItem>\n";
     // oss << "     </Attribute>\n";
@@ -511,45 +347,145 @@ inline void Domain::WriteXDMF (char const * FileKey)
     oss << "</Xdmf>\n";
 
 
-    fn = FileKey;
+
+    fn = f.key.c_str();
     fn.append(".xmf");
     std::ofstream of(fn.CStr(), std::ios::out);
     of << oss.str();
     of.close();
+  }
+  
+  if (f.csv) {
+    std::ostringstream oss;
+    oss << "X, Y, Z, ID, Sigma_eq, Pl_Strain, vx, vy, vz, ax, ay, az, CFx, CFy, CZFz, p, Temp"<<endl;
+    for (size_t i=0; i<f.np; i++){
+      const double *v = &f.csv_val[CSV_COLS*i];
+      oss << v[0];
+      for (int j=1;j<CSV_COLS;j++)
+        oss << ", " << v[j];
+      oss << endl;
+    }
+    String fn(f.key.c_str());
+    fn.append(".csv");	
+    std::ofstream of(fn.CStr(), std::ios::out);
+    of << oss.str();
+    of.close();
+  }
+}
+
+//Writes the frame now or hands it to the output thread
+inline void Domain::SubmitOutput(OutputFrame &f)
+{
+  if (async_output) {
+    if (!out_writer.Running()) out_writer.Start(WriteOutputFrame);
+    out_writer.Submit();
+  } else
+    WriteOutputFrame(f);
+}
+
+inline void Domain::FlushOutput()
+{
+  out_writer.Flush();
+}
+
+inline void Domain::WriteXDMF (char const * FileKey)
+{
+  //Staging buffers are reused between outputs, values are converted to float while gathered
+  OutputFrame &f = out_writer.Acquire();
+  f.key = FileKey;
+  f.np = Particles.Size();
+  f.xdmf = true; f.csv = false;
+  f.damage = model_damage;
+  for (int k=0;k<3;k++) f.name[k] = OutputName[k];
+  f.ResizeXDMF(f.np);
+    
+	double P1,P2,P3;
+
+    #pragma omp parallel for schedule (static) private(P1,P2,P3) num_threads(Nproc)
+    for (int i=0;i<Particles.Size();i++)
+    {
+		//LUCIANO 
+		Particles[i]->CalculateEquivalentStress();
+		
+        for (int k=0;k<3;k++){
+          f.pos   [3*i+k] = float(Particles[i]->x(k));
+          f.vel   [3*i+k] = float(Particles[i]->v(k));
+          f.acc   [3*i+k] = float(Particles[i]->a(k));
+          f.disp  [3*i+k] = float(Particles[i]->Displacement(k));
+          f.cforce[3*i+k] = float(Particles[i]->contforce(k));
+        }
+       	f.pressure[i] = float(Particles[i]->Pressure);
+        f.density [i] = float(Particles[i]->Density);
+        f.mass    [i] = float(Particles[i]->Mass);
+        f.h       [i] = float(Particles[i]->h);
+        f.tag     [i] = int  (Particles[i]->ID);
+        for (int k=0;k<6;k++){ //Tensor6 order (00,11,22,01,12,02) is the Sym3_t storage order
+          f.sigma      [6*i+k] = float(Particles[i]->Sigma.d[k]);
+          f.strain     [6*i+k] = float(Particles[i]->Strain.d[k]);
+          f.strain_rate[6*i+k] = float(Particles[i]->StrainRate.d[k]);
+          f.strain_pl  [6*i+k] = float(Particles[i]->Strain_pl.d[k]);
+        }
+        
+				f.gradcorr  [6*i  ] = float(Particles[i]->gradCorrM(0,0));
+        f.gradcorr  [6*i+1] = float(Particles[i]->gradCorrM(1,1));
+        f.gradcorr  [6*i+2] = float(Particles[i]->gradCorrM(2,2));
+        f.gradcorr  [6*i+3] = float(Particles[i]->gradCorrM(0,1));
+        f.gradcorr  [6*i+4] = float(Particles[i]->gradCorrM(1,2));
+        f.gradcorr  [6*i+5] = float(Particles[i]->gradCorrM(0,2));
+				
+				f.sigma_eq [i] 	= float(Particles[i]->Sigma_eq);
+				f.temp     [i] 	= float(Particles[i]->T);
+				f.pl_strain[i] 	= float(Particles[i]->pl_strain);
+				f.nb       [i] 	= int(Particles[i]->Nb); //All neighbours
+				f.contnb   [i] 	= int(Particles[i]->ContNb); //Contact Neighbours
+        
+        f.q_friction [i] = float(Particles[i]->friction_hfl);
+        f.c_shearabs [i] = float(Particles[i]->cshearabs); 
+        f.ps_en      [i] = float(Particles[i]->ps_energy);
+
+				if (model_damage)
+					f.dam [i] = float(Particles[i]->dam_D);
+				
+	UserOutput(Particles[i],P1,P2,P3);
+        f.prop[0][i] = float(P1);
+        f.prop[1][i] = float(P2);
+        f.prop[2][i] = float(P3);
+   }
+   
+   SubmitOutput(f);
 }
 
 inline void Domain::WriteCSV(char const * FileKey)
 {
-	//type definition to shorten coding
-	std::ostringstream oss;
-	//Writing in a Log file
-	String fn(FileKey);
-	
-	oss << "X, Y, Z, ID, Sigma_eq, Pl_Strain, vx, vy, vz, ax, ay, az, CFx, CFy, CZFz, p, Temp"<<endl;;
+  OutputFrame &f = out_writer.Acquire();
+  f.key = FileKey;
+  f.np = Particles.Size();
+  f.xdmf = false; f.csv = true;
+  f.ResizeCSV(f.np);
 	
-	//#pragma omp parallel for schedule(static) num_threads(Nproc)
-	// #ifdef __GNUC__
-	// for (size_t i=0; i<Particles.Size(); i++)	//Like in Domain::Move
-	// #else
+	#pragma omp parallel for schedule(static) num_threads(Nproc)
+	#ifdef __GNUC__
+	for (size_t i=0; i<Particles.Size(); i++)	//Like in Domain::Move
+	#else
 	for (int i=0; i<Particles.Size(); i++)//Like in Domain::Move
-	//#endif
+	#endif
 	{
-		for (int j=0;j<3;j++)
-			oss << Particles[i]->x(j)<<", ";
+    double *v = &f.csv_val[CSV_COLS*i];
 		Particles[i]->CalculateEquivalentStress();		//If XML output is active this is calculated twice
-		oss << 		Particles[i]->ID<<", "<<Particles[i]->Sigma_eq<< ", "<< Particles[i]->pl_strain << ", "<<
-    Particles[i]-> v(0) << ", " << Particles[i]-> v(1) << ", " << Particles[i]-> v(2) << ", " <<
-    Particles[i]-> a(0) << ", " << Particles[i]-> a(1) << ", " <<Particles[i]-> a(2) << ", " << 
-    Particles[i]->contforce(0)<< ", " << Particles[i]->contforce(1)<< ", " <<Particles[i]->contforce(2)<<", "<<
-    Particles[i]->Pressure<<", "<<
-    Particles[i]->T<<endl;
+		for (int j=0;j<3;j++){
+			v[j]    = Particles[i]->x(j);
+			v[6+j]  = Particles[i]->v(j);
+			v[9+j]  = Particles[i]->a(j);
+			v[12+j] = Particles[i]->contforce(j);
+    }
+		v[3]  = Particles[i]->ID;
+		v[4]  = Particles[i]->Sigma_eq;
+		v[5]  = Particles[i]->pl_strain;
+		v[15] = Particles[i]->Pressure;
+		v[16] = Particles[i]->T;
 	}
 
-	fn = FileKey;
-	fn.append(".csv");	
-	std::ofstream of(fn.CStr(), std::ios::out);
-	of << oss.str();
-	of.close();
+  SubmitOutput(f);
 }
 
 }; // namespace SPH
\ No newline at end of file
@@ -0,0 +1,134 @@
+#ifndef SPH_OUTPUT_WRITER_H
+#define SPH_OUTPUT_WRITER_H
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace SPH {
+
+//////////////////////////////////////////////////////////////////////////////
+// Asynchronous output. The solver copies the output fields (already as     //
+// float) into one of two staging frames and goes on, a dedicated thread    //
+// writes the HDF5, XMF and CSV files of the frame. A frame is reused only  //
+// when its previous write is done, so at most one output is in flight      //
+// while the next one is being gathered. Staging vectors are never shrunk.  //
+//////////////////////////////////////////////////////////////////////////////
+#define CSV_COLS 17
+
+struct OutputFrame {
+  std::string key;          //File name without extension
+  size_t np;
+  bool xdmf, csv;           //What is written from this frame
+  bool damage;
+  std::string name[3];      //User output names (OutputName)
+
+  std::vector <float> pos, vel, acc, disp, cforce;                  //3 per particle
+  std::vector <float> sigma, strain, strain_rate, strain_pl, gradcorr; //6 per particle
+  std::vector <float> pressure, density, mass, h, prop[3];
+  std::vector <float> sigma_eq, temp, pl_strain, q_friction, c_shearabs, ps_en, dam;
+  std::vector <int>   tag, nb, contnb;
+  std::vector <double> csv_val;                                     //CSV_COLS per particle
+
+  OutputFrame():np(0),xdmf(false),csv(false),damage(false){}
+
+  inline void ResizeXDMF(const size_t &n){
+    if (pos.size() >= 3*n) return;
+    pos.resize(3*n); vel.resize(3*n); acc.resize(3*n); disp.resize(3*n); cforce.resize(3*n);
+    sigma.resize(6*n); strain.resize(6*n); strain_rate.resize(6*n); strain_pl.resize(6*n); gradcorr.resize(6*n);
+    pressure.resize(n); density.resize(n); mass.resize(n); h.resize(n);
+    for (int k=0;k<3;k++) prop[k].resize(n);
+    sigma_eq.resize(n); temp.resize(n); pl_strain.resize(n);
+    q_friction.resize(n); c_shearabs.resize(n); ps_en.resize(n); dam.resize(n);
+    tag.resize(n); nb.resize(n); contnb.resize(n);
+  }
+  inline void ResizeCSV(const size_t &n){
+    if (csv_val.size() < CSV_COLS*n) csv_val.resize(CSV_COLS*n);
+  }
+};
+
+class OutputWriter {
+public:
+  typedef void (*WriteFn) (const OutputFrame &);
+
+  OutputWriter():m_fn(NULL),m_next(0),m_write(0),m_running(false),m_stop(false){
+    m_pending[0] = m_pending[1] = false;
+  }
+  ~OutputWriter(){ Stop(); }
+
+  inline bool Running() const { return m_running; }
+
+  inline void Start(WriteFn fn){
+    if (m_running) return;
+    m_fn = fn;
+    m_stop = false;
+    m_running = true;
+    m_thread = std::thread(&OutputWriter::Run, this);
+  }
+
+  //Next frame to be filled, waits for its previous write if it is still pending
+  inline OutputFrame & Acquire(){
+    std::unique_lock<std::mutex> lock(m_mtx);
+    while (m_pending[m_next]) m_cv.wait(lock);
+    return m_frame[m_next];
+  }
+
+  //Hands the acquired frame to the writer thread
+  inline void Submit(){
+    {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      m_pending[m_next] = true;
+      m_next = 1 - m_next;
+    }
+    m_cv.notify_all();
+  }
+
+  //Waits until every submitted frame is on disk
+  inline void Flush(){
+    std::unique_lock<std::mutex> lock(m_mtx);
+    while (m_pending[0] || m_pending[1]) m_cv.wait(lock);
+  }
+
+  inline void Stop(){
+    if (!m_running) return;
+    Flush();
+    {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      m_stop = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+    m_running = false;
+  }
+
+private:
+  //Frames are submitted alternately, so they are written in the same order
+  inline void Run(){
+    std::unique_lock<std::mutex> lock(m_mtx);
+    while (true) {
+      while (!m_pending[m_write] && !m_stop) m_cv.wait(lock);
+      if (!m_pending[m_write]) break;
+      lock.unlock();
+      m_fn(m_frame[m_write]);
+      lock.lock();
+      m_pending[m_write] = false;
+      m_write = 1 - m_write;
+      m_cv.notify_all();
+    }
+  }
+
+  WriteFn     m_fn;
+  OutputFrame m_frame[2];
+  bool        m_pending[2];
+  int         m_next, m_write;
+  bool        m_running, m_stop;
+  std::thread m_thread;
+  std::mutex  m_mtx;
+  std::condition_variable m_cv;
+};
+
+}; // namespace SPH
+
+#endif // SPH_OUTPUT_WRITER_H
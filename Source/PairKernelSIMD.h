@@ -0,0 +1,437 @@
+#ifndef SPH_PAIR_KERNEL_SIMD_H
+#define SPH_PAIR_KERNEL_SIMD_H
+
+#include <math.h>
+#include "ParticleSOA.h"
+
+//x86 with GCC or Clang: AVX2 and AVX-512 versions compiled with target
+//attributes, selected at run time, in double (4 and 8 lanes) or with 
+//SPH_SINGLE_PRECISION in float (8 and 16 lanes). Otherwise only the scalar version
+#if defined(__GNUC__) && !defined(__INTEL_COMPILER) && defined(__x86_64__) && (__GNUC__ >= 5 || defined(__clang__))
+#define SPH_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#define ACCEL_BATCH 64  //Pairs per batch (buffer size of each thread)
+
+namespace SPH {
+
+//////////////////////////////////////////////////////////////////////////////
+// Batched acceleration pair kernel over ParticleSOA. For the common case:  //
+// cubic or hyperbolic spline, artificial viscosity, no tensile instability,//
+// no gradient correction, damage or axisymmetry (Domain::SIMDKernels).     //
+// For n pairs (i[b], j[b]) writes the pair term f[3b..3b+2], which is      //
+// scattered as mj*f to i and -mi*f to j, same as temp in CalcAccelSOA.     //
+//////////////////////////////////////////////////////////////////////////////
+struct AccelBatchPar {
+  int     dim;        //2 or 3 (plane strain, f[3b+2] = 0)
+  int     kt;         //Kernel type: 0 Cubic spline, 3 Hyperbolic spline
+  double  C;          //Kernel constant, KernelFunctor<dim,kt>::C()
+  int     grad_type;  //Domain::GradientType
+};
+
+typedef void (*AccelBatchFn)(const ParticleSOA &soa, const AccelBatchPar &par,
+                             const size_t *i, const size_t *j, const int &n, double *f);
+
+// Scalar version, also used for the batch tail of the vector versions
+// Pair arithmetic in the field type Real, pair terms returned as double
+template <typename Real>
+inline void AccelBatch_Scalar(const ParticleSOA_T<Real> &soa, const AccelBatchPar &par,
+                              const size_t *pi, const size_t *pj, const int &n, double *f){
+  const Real C = (Real)par.C;
+  for (int b=0; b<n; b++){
+    size_t i = pi[b], j = pj[b];
+    Real xij[3], vij[3];
+    for (int c=0;c<3;c++){
+      xij[c] = soa.x[3*i+c] - soa.x[3*j+c];
+      vij[c] = soa.v[3*i+c] - soa.v[3*j+c];
+    }
+    Real h  = Real(0.5)*(soa.h[i]+soa.h[j]);
+    Real r2 = xij[0]*xij[0] + xij[1]*xij[1] + xij[2]*xij[2];
+    Real q  = sqrt(r2)/h;
+
+    Real hD = (par.dim == 2) ? h*h : h*h*h;
+    Real t  = C/(hD*h)/(q*h);
+    Real b2 = Real(2.0)-q, GK;
+    if (par.kt == 0)  GK = (q<Real(1.0)) ? t*(Real(-3.0)*q+Real(2.25)*q*q) : ((q<Real(2.0)) ? t*(Real(-0.75)*b2*b2)     : Real(0.0));
+    else              GK = (q<Real(1.0)) ? t*(Real(3.0)*q*q-Real(6.0))     : ((q<Real(2.0)) ? t*(Real(3.0)*b2*b2-Real(1.0)) : Real(0.0));
+    if (q == Real(0.0)) GK = Real(0.0); //Coincident particles, xij is zero
+
+    Real di = soa.rho[i], dj = soa.rho[j];
+    Real vx   = vij[0]*xij[0] + vij[1]*xij[1] + vij[2]*xij[2];
+    Real PIij = Real(0.0);
+    if (vx < Real(0.0)) {
+      Real MUij = h*vx/(r2+Real(0.01)*h*h);
+      Real Cij  = Real(0.5)*(soa.cs[i]+soa.cs[j]);
+      PIij = (Real(0.5)*(soa.alpha[i]+soa.alpha[j])*Cij*MUij + Real(0.5)*(soa.beta[i]+soa.beta[j])*MUij*MUij)/(Real(0.5)*(di+dj));
+    }
+
+    const Real *si = &soa.sigma[6*i], *sj = &soa.sigma[6*j];
+    Real M[6];
+    if (par.grad_type == 0){
+      Real fi = Real(1.0)/(di*di), fj = Real(1.0)/(dj*dj);
+      for (int c=0;c<6;c++) M[c] = fi*si[c] + fj*sj[c];
+    } else if (par.grad_type == 1){
+      Real fij = Real(1.0)/(di*dj);
+      for (int c=0;c<6;c++) M[c] = fij*(si[c] + sj[c]);
+    } else {
+      Real fij = Real(1.0)/(di*dj);
+      for (int c=0;c<6;c++) M[c] = fij*(si[c] - sj[c]);
+    }
+    for (int c=0;c<3;c++) M[c] += PIij;
+
+    Real g[3] = {GK*xij[0], GK*xij[1], GK*xij[2]};
+    f[3*b  ] = g[0]*M[0] + g[1]*M[3] + g[2]*M[5];
+    f[3*b+1] = g[0]*M[3] + g[1]*M[1] + g[2]*M[4];
+    f[3*b+2] = (par.dim == 2) ? 0.0 : g[0]*M[5] + g[1]*M[4] + g[2]*M[2];
+  }
+}
+
+#ifdef SPH_SIMD_X86
+#ifndef SPH_SINGLE_PRECISION
+
+// AVX2, 4 pairs per vector. Fields are gathered by particle index
+__attribute__((target("avx2")))
+inline void AccelBatch_AVX2(const ParticleSOA &soa, const AccelBatchPar &par,
+                            const size_t *pi, const size_t *pj, const int &n, double *f){
+  const __m256d one = _mm256_set1_pd(1.0), two = _mm256_set1_pd(2.0), half = _mm256_set1_pd(0.5);
+  const __m256d zero = _mm256_setzero_pd();
+  int nv = n - n%4;
+  for (int b=0; b<nv; b+=4){
+    __m256i i1 = _mm256_loadu_si256((const __m256i*)&pi[b]);
+    __m256i j1 = _mm256_loadu_si256((const __m256i*)&pj[b]);
+    __m256i i3 = _mm256_add_epi64(i1, _mm256_slli_epi64(i1,1));
+    __m256i j3 = _mm256_add_epi64(j1, _mm256_slli_epi64(j1,1));
+    __m256i i6 = _mm256_slli_epi64(i3,1), j6 = _mm256_slli_epi64(j3,1);
+
+    __m256d x[3], v[3];
+    for (int c=0;c<3;c++){
+      x[c] = _mm256_sub_pd(_mm256_i64gather_pd(soa.x+c,i3,8), _mm256_i64gather_pd(soa.x+c,j3,8));
+      v[c] = _mm256_sub_pd(_mm256_i64gather_pd(soa.v+c,i3,8), _mm256_i64gather_pd(soa.v+c,j3,8));
+    }
+    __m256d h  = _mm256_mul_pd(half, _mm256_add_pd(_mm256_i64gather_pd(soa.h,i1,8), _mm256_i64gather_pd(soa.h,j1,8)));
+    __m256d r2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x[0],x[0]), _mm256_mul_pd(x[1],x[1])), _mm256_mul_pd(x[2],x[2]));
+    __m256d q  = _mm256_div_pd(_mm256_sqrt_pd(r2), h);
+
+    //Kernel gradient factor
+    __m256d hD = _mm256_mul_pd(h,h);
+    if (par.dim == 3) hD = _mm256_mul_pd(hD,h);
+    __m256d t  = _mm256_div_pd(_mm256_div_pd(_mm256_set1_pd(par.C), _mm256_mul_pd(hD,h)), _mm256_mul_pd(q,h));
+    __m256d b2 = _mm256_sub_pd(two,q), p1, p2;
+    if (par.kt == 0){
+      p1 = _mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(-3.0),q), _mm256_mul_pd(_mm256_set1_pd(2.25),_mm256_mul_pd(q,q)));
+      p2 = _mm256_mul_pd(_mm256_set1_pd(-0.75), _mm256_mul_pd(b2,b2));
+    } else {
+      p1 = _mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(3.0),_mm256_mul_pd(q,q)), _mm256_set1_pd(6.0));
+      p2 = _mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(3.0),_mm256_mul_pd(b2,b2)), one);
+    }
+    __m256d piece = _mm256_blendv_pd(zero, p2, _mm256_cmp_pd(q,two,_CMP_LT_OQ));
+    piece = _mm256_blendv_pd(piece, p1, _mm256_cmp_pd(q,one,_CMP_LT_OQ));
+    __m256d GK = _mm256_mul_pd(t,piece);
+    GK = _mm256_blendv_pd(GK, zero, _mm256_cmp_pd(q,zero,_CMP_EQ_OQ));
+
+    //Artificial viscosity, only approaching pairs
+    __m256d di = _mm256_i64gather_pd(soa.rho,i1,8), dj = _mm256_i64gather_pd(soa.rho,j1,8);
+    __m256d vx = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(v[0],x[0]), _mm256_mul_pd(v[1],x[1])), _mm256_mul_pd(v[2],x[2]));
+    __m256d MU = _mm256_div_pd(_mm256_mul_pd(h,vx), _mm256_add_pd(r2, _mm256_mul_pd(_mm256_set1_pd(0.01),_mm256_mul_pd(h,h))));
+    __m256d Cij   = _mm256_mul_pd(half, _mm256_add_pd(_mm256_i64gather_pd(soa.cs,i1,8),    _mm256_i64gather_pd(soa.cs,j1,8)));
+    __m256d alpha = _mm256_mul_pd(half, _mm256_add_pd(_mm256_i64gather_pd(soa.alpha,i1,8), _mm256_i64gather_pd(soa.alpha,j1,8)));
+    __m256d beta  = _mm256_mul_pd(half, _mm256_add_pd(_mm256_i64gather_pd(soa.beta,i1,8),  _mm256_i64gather_pd(soa.beta,j1,8)));
+    __m256d PI = _mm256_div_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(alpha,Cij),MU), _mm256_mul_pd(beta,_mm256_mul_pd(MU,MU))),
+                               _mm256_mul_pd(half,_mm256_add_pd(di,dj)));
+    PI = _mm256_blendv_pd(zero, PI, _mm256_cmp_pd(vx,zero,_CMP_LT_OQ));
+
+    //Stress term
+    __m256d M[6];
+    if (par.grad_type == 0){
+      __m256d fi = _mm256_div_pd(one,_mm256_mul_pd(di,di)), fj = _mm256_div_pd(one,_mm256_mul_pd(dj,dj));
+      for (int c=0;c<6;c++)
+        M[c] = _mm256_add_pd(_mm256_mul_pd(fi,_mm256_i64gather_pd(soa.sigma+c,i6,8)), _mm256_mul_pd(fj,_mm256_i64gather_pd(soa.sigma+c,j6,8)));
+    } else {
+      __m256d fij = _mm256_div_pd(one,_mm256_mul_pd(di,dj));
+      for (int c=0;c<6;c++){
+        __m256d si = _mm256_i64gather_pd(soa.sigma+c,i6,8), sj = _mm256_i64gather_pd(soa.sigma+c,j6,8);
+        M[c] = _mm256_mul_pd(fij, par.grad_type == 1 ? _mm256_add_pd(si,sj) : _mm256_sub_pd(si,sj));
+      }
+    }
+    for (int c=0;c<3;c++) M[c] = _mm256_add_pd(M[c],PI);
+
+    __m256d g0 = _mm256_mul_pd(GK,x[0]), g1 = _mm256_mul_pd(GK,x[1]), g2 = _mm256_mul_pd(GK,x[2]);
+    double r[3][4];
+    _mm256_storeu_pd(r[0], _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(g0,M[0]),_mm256_mul_pd(g1,M[3])),_mm256_mul_pd(g2,M[5])));
+    _mm256_storeu_pd(r[1], _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(g0,M[3]),_mm256_mul_pd(g1,M[1])),_mm256_mul_pd(g2,M[4])));
+    _mm256_storeu_pd(r[2], _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(g0,M[5]),_mm256_mul_pd(g1,M[4])),_mm256_mul_pd(g2,M[2])));
+    for (int l=0;l<4;l++){
+      f[3*(b+l)  ] = r[0][l];
+      f[3*(b+l)+1] = r[1][l];
+      f[3*(b+l)+2] = (par.dim == 2) ? 0.0 : r[2][l];
+    }
+  }
+  if (nv < n) AccelBatch_Scalar<double>(soa, par, pi+nv, pj+nv, n-nv, f+3*nv);
+}
+
+// AVX-512, 8 pairs per vector
+__attribute__((target("avx512f")))
+inline void AccelBatch_AVX512(const ParticleSOA &soa, const AccelBatchPar &par,
+                              const size_t *pi, const size_t *pj, const int &n, double *f){
+  const __m512d one = _mm512_set1_pd(1.0), two = _mm512_set1_pd(2.0), half = _mm512_set1_pd(0.5);
+  const __m512d zero = _mm512_setzero_pd();
+  int nv = n - n%8;
+  for (int b=0; b<nv; b+=8){
+    __m512i i1 = _mm512_loadu_si512((const void*)&pi[b]);
+    __m512i j1 = _mm512_loadu_si512((const void*)&pj[b]);
+    __m512i i3 = _mm512_add_epi64(i1, _mm512_slli_epi64(i1,1));
+    __m512i j3 = _mm512_add_epi64(j1, _mm512_slli_epi64(j1,1));
+    __m512i i6 = _mm512_slli_epi64(i3,1), j6 = _mm512_slli_epi64(j3,1);
+
+    __m512d x[3], v[3];
+    for (int c=0;c<3;c++){
+      x[c] = _mm512_sub_pd(_mm512_i64gather_pd(i3,soa.x+c,8), _mm512_i64gather_pd(j3,soa.x+c,8));
+      v[c] = _mm512_sub_pd(_mm512_i64gather_pd(i3,soa.v+c,8), _mm512_i64gather_pd(j3,soa.v+c,8));
+    }
+    __m512d h  = _mm512_mul_pd(half, _mm512_add_pd(_mm512_i64gather_pd(i1,soa.h,8), _mm512_i64gather_pd(j1,soa.h,8)));
+    __m512d r2 = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(x[0],x[0]), _mm512_mul_pd(x[1],x[1])), _mm512_mul_pd(x[2],x[2]));
+    __m512d q  = _mm512_div_pd(_mm512_sqrt_pd(r2), h);
+
+    //Kernel gradient factor
+    __m512d hD = _mm512_mul_pd(h,h);
+    if (par.dim == 3) hD = _mm512_mul_pd(hD,h);
+    __m512d t  = _mm512_div_pd(_mm512_div_pd(_mm512_set1_pd(par.C), _mm512_mul_pd(hD,h)), _mm512_mul_pd(q,h));
+    __m512d b2 = _mm512_sub_pd(two,q), p1, p2;
+    if (par.kt == 0){
+      p1 = _mm512_add_pd(_mm512_mul_pd(_mm512_set1_pd(-3.0),q), _mm512_mul_pd(_mm512_set1_pd(2.25),_mm512_mul_pd(q,q)));
+      p2 = _mm512_mul_pd(_mm512_set1_pd(-0.75), _mm512_mul_pd(b2,b2));
+    } else {
+      p1 = _mm512_sub_pd(_mm512_mul_pd(_mm512_set1_pd(3.0),_mm512_mul_pd(q,q)), _mm512_set1_pd(6.0));
+      p2 = _mm512_sub_pd(_mm512_mul_pd(_mm512_set1_pd(3.0),_mm512_mul_pd(b2,b2)), one);
+    }
+    __m512d piece = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(q,two,_CMP_LT_OQ), zero, p2);
+    piece = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(q,one,_CMP_LT_OQ), piece, p1);
+    __m512d GK = _mm512_mul_pd(t,piece);
+    GK = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(q,zero,_CMP_EQ_OQ), GK, zero);
+
+    //Artificial viscosity, only approaching pairs
+    __m512d di = _mm512_i64gather_pd(i1,soa.rho,8), dj = _mm512_i64gather_pd(j1,soa.rho,8);
+    __m512d vx = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(v[0],x[0]), _mm512_mul_pd(v[1],x[1])), _mm512_mul_pd(v[2],x[2]));
+    __m512d MU = _mm512_div_pd(_mm512_mul_pd(h,vx), _mm512_add_pd(r2, _mm512_mul_pd(_mm512_set1_pd(0.01),_mm512_mul_pd(h,h))));
+    __m512d Cij   = _mm512_mul_pd(half, _mm512_add_pd(_mm512_i64gather_pd(i1,soa.cs,8),    _mm512_i64gather_pd(j1,soa.cs,8)));
+    __m512d alpha = _mm512_mul_pd(half, _mm512_add_pd(_mm512_i64gather_pd(i1,soa.alpha,8), _mm512_i64gather_pd(j1,soa.alpha,8)));
+    __m512d beta  = _mm512_mul_pd(half, _mm512_add_pd(_mm512_i64gather_pd(i1,soa.beta,8),  _mm512_i64gather_pd(j1,soa.beta,8)));
+    __m512d PI = _mm512_div_pd(_mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(alpha,Cij),MU), _mm512_mul_pd(beta,_mm512_mul_pd(MU,MU))),
+                               _mm512_mul_pd(half,_mm512_add_pd(di,dj)));
+    PI = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(vx,zero,_CMP_LT_OQ), zero, PI);
+
+    //Stress term
+    __m512d M[6];
+    if (par.grad_type == 0){
+      __m512d fi = _mm512_div_pd(one,_mm512_mul_pd(di,di)), fj = _mm512_div_pd(one,_mm512_mul_pd(dj,dj));
+      for (int c=0;c<6;c++)
+        M[c] = _mm512_add_pd(_mm512_mul_pd(fi,_mm512_i64gather_pd(i6,soa.sigma+c,8)), _mm512_mul_pd(fj,_mm512_i64gather_pd(j6,soa.sigma+c,8)));
+    } else {
+      __m512d fij = _mm512_div_pd(one,_mm512_mul_pd(di,dj));
+      for (int c=0;c<6;c++){
+        __m512d si = _mm512_i64gather_pd(i6,soa.sigma+c,8), sj = _mm512_i64gather_pd(j6,soa.sigma+c,8);
+        M[c] = _mm512_mul_pd(fij, par.grad_type == 1 ? _mm512_add_pd(si,sj) : _mm512_sub_pd(si,sj));
+      }
+    }
+    for (int c=0;c<3;c++) M[c] = _mm512_add_pd(M[c],PI);
+
+    __m512d g0 = _mm512_mul_pd(GK,x[0]), g1 = _mm512_mul_pd(GK,x[1]), g2 = _mm512_mul_pd(GK,x[2]);
+    double r[3][8];
+    _mm512_storeu_pd(r[0], _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(g0,M[0]),_mm512_mul_pd(g1,M[3])),_mm512_mul_pd(g2,M[5])));
+    _mm512_storeu_pd(r[1], _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(g0,M[3]),_mm512_mul_pd(g1,M[1])),_mm512_mul_pd(g2,M[4])));
+    _mm512_storeu_pd(r[2], _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(g0,M[5]),_mm512_mul_pd(g1,M[4])),_mm512_mul_pd(g2,M[2])));
+    for (int l=0;l<8;l++){
+      f[3*(b+l)  ] = r[0][l];
+      f[3*(b+l)+1] = r[1][l];
+      f[3*(b+l)+2] = (par.dim == 2) ? 0.0 : r[2][l];
+    }
+  }
+  if (nv < n) AccelBatch_Scalar<double>(soa, par, pi+nv, pj+nv, n-nv, f+3*nv);
+}
+
+#else // SPH_SINGLE_PRECISION
+
+// Float fields: AVX2, 8 pairs per vector. Indices gathered as 32 bit
+// (6*n must fit in int, up to 357M particles)
+__attribute__((target("avx2")))
+inline void AccelBatch_AVX2(const ParticleSOA &soa, const AccelBatchPar &par,
+                            const size_t *pi, const size_t *pj, const int &n, double *f){
+  const __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f), half = _mm256_set1_ps(0.5f);
+  const __m256 zero = _mm256_setzero_ps();
+  int nv = n - n%8;
+  for (int b=0; b<nv; b+=8){
+    int ii[8], jj[8];
+    for (int l=0;l<8;l++) {ii[l] = (int)pi[b+l]; jj[l] = (int)pj[b+l];}
+    __m256i i1 = _mm256_loadu_si256((const __m256i*)ii);
+    __m256i j1 = _mm256_loadu_si256((const __m256i*)jj);
+    __m256i i3 = _mm256_add_epi32(i1, _mm256_slli_epi32(i1,1));
+    __m256i j3 = _mm256_add_epi32(j1, _mm256_slli_epi32(j1,1));
+    __m256i i6 = _mm256_slli_epi32(i3,1), j6 = _mm256_slli_epi32(j3,1);
+
+    __m256 x[3], v[3];
+    for (int c=0;c<3;c++){
+      x[c] = _mm256_sub_ps(_mm256_i32gather_ps(soa.x+c,i3,4), _mm256_i32gather_ps(soa.x+c,j3,4));
+      v[c] = _mm256_sub_ps(_mm256_i32gather_ps(soa.v+c,i3,4), _mm256_i32gather_ps(soa.v+c,j3,4));
+    }
+    __m256 h  = _mm256_mul_ps(half, _mm256_add_ps(_mm256_i32gather_ps(soa.h,i1,4), _mm256_i32gather_ps(soa.h,j1,4)));
+    __m256 r2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x[0],x[0]), _mm256_mul_ps(x[1],x[1])), _mm256_mul_ps(x[2],x[2]));
+    __m256 q  = _mm256_div_ps(_mm256_sqrt_ps(r2), h);
+
+    //Kernel gradient factor
+    __m256 hD = _mm256_mul_ps(h,h);
+    if (par.dim == 3) hD = _mm256_mul_ps(hD,h);
+    __m256 t  = _mm256_div_ps(_mm256_div_ps(_mm256_set1_ps((float)par.C), _mm256_mul_ps(hD,h)), _mm256_mul_ps(q,h));
+    __m256 b2 = _mm256_sub_ps(two,q), p1, p2;
+    if (par.kt == 0){
+      p1 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(-3.0f),q), _mm256_mul_ps(_mm256_set1_ps(2.25f),_mm256_mul_ps(q,q)));
+      p2 = _mm256_mul_ps(_mm256_set1_ps(-0.75f), _mm256_mul_ps(b2,b2));
+    } else {
+      p1 = _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(3.0f),_mm256_mul_ps(q,q)), _mm256_set1_ps(6.0f));
+      p2 = _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(3.0f),_mm256_mul_ps(b2,b2)), one);
+    }
+    __m256 piece = _mm256_blendv_ps(zero, p2, _mm256_cmp_ps(q,two,_CMP_LT_OQ));
+    piece = _mm256_blendv_ps(piece, p1, _mm256_cmp_ps(q,one,_CMP_LT_OQ));
+    __m256 GK = _mm256_mul_ps(t,piece);
+    GK = _mm256_blendv_ps(GK, zero, _mm256_cmp_ps(q,zero,_CMP_EQ_OQ));
+
+    //Artificial viscosity, only approaching pairs
+    __m256 di = _mm256_i32gather_ps(soa.rho,i1,4), dj = _mm256_i32gather_ps(soa.rho,j1,4);
+    __m256 vx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(v[0],x[0]), _mm256_mul_ps(v[1],x[1])), _mm256_mul_ps(v[2],x[2]));
+    __m256 MU = _mm256_div_ps(_mm256_mul_ps(h,vx), _mm256_add_ps(r2, _mm256_mul_ps(_mm256_set1_ps(0.01f),_mm256_mul_ps(h,h))));
+    __m256 Cij   = _mm256_mul_ps(half, _mm256_add_ps(_mm256_i32gather_ps(soa.cs,i1,4),    _mm256_i32gather_ps(soa.cs,j1,4)));
+    __m256 alpha = _mm256_mul_ps(half, _mm256_add_ps(_mm256_i32gather_ps(soa.alpha,i1,4), _mm256_i32gather_ps(soa.alpha,j1,4)));
+    __m256 beta  = _mm256_mul_ps(half, _mm256_add_ps(_mm256_i32gather_ps(soa.beta,i1,4),  _mm256_i32gather_ps(soa.beta,j1,4)));
+    __m256 PI = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(alpha,Cij),MU), _mm256_mul_ps(beta,_mm256_mul_ps(MU,MU))),
+                              _mm256_mul_ps(half,_mm256_add_ps(di,dj)));
+    PI = _mm256_blendv_ps(zero, PI, _mm256_cmp_ps(vx,zero,_CMP_LT_OQ));
+
+    //Stress term
+    __m256 M[6];
+    if (par.grad_type == 0){
+      __m256 fi = _mm256_div_ps(one,_mm256_mul_ps(di,di)), fj = _mm256_div_ps(one,_mm256_mul_ps(dj,dj));
+      for (int c=0;c<6;c++)
+        M[c] = _mm256_add_ps(_mm256_mul_ps(fi,_mm256_i32gather_ps(soa.sigma+c,i6,4)), _mm256_mul_ps(fj,_mm256_i32gather_ps(soa.sigma+c,j6,4)));
+    } else {
+      __m256 fij = _mm256_div_ps(one,_mm256_mul_ps(di,dj));
+      for (int c=0;c<6;c++){
+        __m256 si = _mm256_i32gather_ps(soa.sigma+c,i6,4), sj = _mm256_i32gather_ps(soa.sigma+c,j6,4);
+        M[c] = _mm256_mul_ps(fij, par.grad_type == 1 ? _mm256_add_ps(si,sj) : _mm256_sub_ps(si,sj));
+      }
+    }
+    for (int c=0;c<3;c++) M[c] = _mm256_add_ps(M[c],PI);
+
+    __m256 g0 = _mm256_mul_ps(GK,x[0]), g1 = _mm256_mul_ps(GK,x[1]), g2 = _mm256_mul_ps(GK,x[2]);
+    float r[3][8];
+    _mm256_storeu_ps(r[0], _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(g0,M[0]),_mm256_mul_ps(g1,M[3])),_mm256_mul_ps(g2,M[5])));
+    _mm256_storeu_ps(r[1], _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(g0,M[3]),_mm256_mul_ps(g1,M[1])),_mm256_mul_ps(g2,M[4])));
+    _mm256_storeu_ps(r[2], _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(g0,M[5]),_mm256_mul_ps(g1,M[4])),_mm256_mul_ps(g2,M[2])));
+    for (int l=0;l<8;l++){
+      f[3*(b+l)  ] = r[0][l];
+      f[3*(b+l)+1] = r[1][l];
+      f[3*(b+l)+2] = (par.dim == 2) ? 0.0 : r[2][l];
+    }
+  }
+  if (nv < n) AccelBatch_Scalar<float>(soa, par, pi+nv, pj+nv, n-nv, f+3*nv);
+}
+
+// Float fields: AVX-512, 16 pairs per vector
+__attribute__((target("avx512f")))
+inline void AccelBatch_AVX512(const ParticleSOA &soa, const AccelBatchPar &par,
+                              const size_t *pi, const size_t *pj, const int &n, double *f){
+  const __m512 one = _mm512_set1_ps(1.0f), two = _mm512_set1_ps(2.0f), half = _mm512_set1_ps(0.5f);
+  const __m512 zero = _mm512_setzero_ps();
+  int nv = n - n%16;
+  for (int b=0; b<nv; b+=16){
+    //64 to 32 bit indices, two halves of 8
+    __m512i i1 = _mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvtepi64_epi32(_mm512_loadu_si512((const void*)&pi[b]))),
+                                    _mm512_cvtepi64_epi32(_mm512_loadu_si512((const void*)&pi[b+8])), 1);
+    __m512i j1 = _mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvtepi64_epi32(_mm512_loadu_si512((const void*)&pj[b]))),
+                                    _mm512_cvtepi64_epi32(_mm512_loadu_si512((const void*)&pj[b+8])), 1);
+    __m512i i3 = _mm512_add_epi32(i1, _mm512_slli_epi32(i1,1));
+    __m512i j3 = _mm512_add_epi32(j1, _mm512_slli_epi32(j1,1));
+    __m512i i6 = _mm512_slli_epi32(i3,1), j6 = _mm512_slli_epi32(j3,1);
+
+    __m512 x[3], v[3];
+    for (int c=0;c<3;c++){
+      x[c] = _mm512_sub_ps(_mm512_i32gather_ps(i3,soa.x+c,4), _mm512_i32gather_ps(j3,soa.x+c,4));
+      v[c] = _mm512_sub_ps(_mm512_i32gather_ps(i3,soa.v+c,4), _mm512_i32gather_ps(j3,soa.v+c,4));
+    }
+    __m512 h  = _mm512_mul_ps(half, _mm512_add_ps(_mm512_i32gather_ps(i1,soa.h,4), _mm512_i32gather_ps(j1,soa.h,4)));
+    __m512 r2 = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(x[0],x[0]), _mm512_mul_ps(x[1],x[1])), _mm512_mul_ps(x[2],x[2]));
+    __m512 q  = _mm512_div_ps(_mm512_sqrt_ps(r2), h);
+
+    //Kernel gradient factor
+    __m512 hD = _mm512_mul_ps(h,h);
+    if (par.dim == 3) hD = _mm512_mul_ps(hD,h);
+    __m512 t  = _mm512_div_ps(_mm512_div_ps(_mm512_set1_ps((float)par.C), _mm512_mul_ps(hD,h)), _mm512_mul_ps(q,h));
+    __m512 b2 = _mm512_sub_ps(two,q), p1, p2;
+    if (par.kt == 0){
+      p1 = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(-3.0f),q), _mm512_mul_ps(_mm512_set1_ps(2.25f),_mm512_mul_ps(q,q)));
+      p2 = _mm512_mul_ps(_mm512_set1_ps(-0.75f), _mm512_mul_ps(b2,b2));
+    } else {
+      p1 = _mm512_sub_ps(_mm512_mul_ps(_mm512_set1_ps(3.0f),_mm512_mul_ps(q,q)), _mm512_set1_ps(6.0f));
+      p2 = _mm512_sub_ps(_mm512_mul_ps(_mm512_set1_ps(3.0f),_mm512_mul_ps(b2,b2)), one);
+    }
+    __m512 piece = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(q,two,_CMP_LT_OQ), zero, p2);
+    piece = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(q,one,_CMP_LT_OQ), piece, p1);
+    __m512 GK = _mm512_mul_ps(t,piece);
+    GK = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(q,zero,_CMP_EQ_OQ), GK, zero);
+
+    //Artificial viscosity, only approaching pairs
+    __m512 di = _mm512_i32gather_ps(i1,soa.rho,4), dj = _mm512_i32gather_ps(j1,soa.rho,4);
+    __m512 vx = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(v[0],x[0]), _mm512_mul_ps(v[1],x[1])), _mm512_mul_ps(v[2],x[2]));
+    __m512 MU = _mm512_div_ps(_mm512_mul_ps(h,vx), _mm512_add_ps(r2, _mm512_mul_ps(_mm512_set1_ps(0.01f),_mm512_mul_ps(h,h))));
+    __m512 Cij   = _mm512_mul_ps(half, _mm512_add_ps(_mm512_i32gather_ps(i1,soa.cs,4),    _mm512_i32gather_ps(j1,soa.cs,4)));
+    __m512 alpha = _mm512_mul_ps(half, _mm512_add_ps(_mm512_i32gather_ps(i1,soa.alpha,4), _mm512_i32gather_ps(j1,soa.alpha,4)));
+    __m512 beta  = _mm512_mul_ps(half, _mm512_add_ps(_mm512_i32gather_ps(i1,soa.beta,4),  _mm512_i32gather_ps(j1,soa.beta,4)));
+    __m512 PI = _mm512_div_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(alpha,Cij),MU), _mm512_mul_ps(beta,_mm512_mul_ps(MU,MU))),
+                              _mm512_mul_ps(half,_mm512_add_ps(di,dj)));
+    PI = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(vx,zero,_CMP_LT_OQ), zero, PI);
+
+    //Stress term
+    __m512 M[6];
+    if (par.grad_type == 0){
+      __m512 fi = _mm512_div_ps(one,_mm512_mul_ps(di,di)), fj = _mm512_div_ps(one,_mm512_mul_ps(dj,dj));
+      for (int c=0;c<6;c++)
+        M[c] = _mm512_add_ps(_mm512_mul_ps(fi,_mm512_i32gather_ps(i6,soa.sigma+c,4)), _mm512_mul_ps(fj,_mm512_i32gather_ps(j6,soa.sigma+c,4)));
+    } else {
+      __m512 fij = _mm512_div_ps(one,_mm512_mul_ps(di,dj));
+      for (int c=0;c<6;c++){
+        __m512 si = _mm512_i32gather_ps(i6,soa.sigma+c,4), sj = _mm512_i32gather_ps(j6,soa.sigma+c,4);
+        M[c] = _mm512_mul_ps(fij, par.grad_type == 1 ? _mm512_add_ps(si,sj) : _mm512_sub_ps(si,sj));
+      }
+    }
+    for (int c=0;c<3;c++) M[c] = _mm512_add_ps(M[c],PI);
+
+    __m512 g0 = _mm512_mul_ps(GK,x[0]), g1 = _mm512_mul_ps(GK,x[1]), g2 = _mm512_mul_ps(GK,x[2]);
+    float r[3][16];
+    _mm512_storeu_ps(r[0], _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(g0,M[0]),_mm512_mul_ps(g1,M[3])),_mm512_mul_ps(g2,M[5])));
+    _mm512_storeu_ps(r[1], _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(g0,M[3]),_mm512_mul_ps(g1,M[1])),_mm512_mul_ps(g2,M[4])));
+    _mm512_storeu_ps(r[2], _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(g0,M[5]),_mm512_mul_ps(g1,M[4])),_mm512_mul_ps(g2,M[2])));
+    for (int l=0;l<16;l++){
+      f[3*(b+l)  ] = r[0][l];
+      f[3*(b+l)+1] = r[1][l];
+      f[3*(b+l)+2] = (par.dim == 2) ? 0.0 : r[2][l];
+    }
+  }
+  if (nv < n) AccelBatch_Scalar<float>(soa, par, pi+nv, pj+nv, n-nv, f+3*nv);
+}
+
+#endif // SPH_SINGLE_PRECISION
+#endif // SPH_SIMD_X86
+
+// Selected once (Domain::InitialChecks), from the CPU the binary runs on
+inline AccelBatchFn SelectAccelBatch(const char * &name){
+  #ifdef SPH_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))  {name = "AVX-512"; return AccelBatch_AVX512;}
+  if (__builtin_cpu_supports("avx2"))     {name = "AVX2";    return AccelBatch_AVX2;}
+  #endif
+  name = "scalar";
+  return AccelBatch_Scalar<sph_real>;
+}
+
+}; // namespace SPH
+
+#endif // SPH_PAIR_KERNEL_SIMD_H
@@ -25,6 +25,35 @@ using namespace std;
 
 namespace SPH {
 
+inline ObjectPool & ParticlePool(){
+	static ObjectPool pool(sizeof(Particle));
+	return pool;
+}
+
+inline void * Particle::operator new (size_t size){
+	if (size != sizeof(Particle)) return ::operator new(size);
+	return ParticlePool().Get();
+}
+
+inline void Particle::operator delete (void *p, size_t size){
+	if (p == NULL) return;
+	if (size != sizeof(Particle)) ::operator delete(p);
+	else ParticlePool().Put(p);
+}
+
+inline VerletHistory::VerletHistory(){
+	Densityb = 0.0;
+	set_to_zero(ShearStressb);
+	set_to_zero(Strainb);
+}
+
+inline LeapfrogHistory::LeapfrogHistory(){
+	Densitya = Densityb = 0.0;
+	set_to_zero(ShearStressa);	set_to_zero(ShearStressb);
+	set_to_zero(Straina);				set_to_zero(Strainb);
+	Ta = Tb = 0.0;
+}
+
 inline Particle::Particle(int Tag, Vec3_t const & x0, Vec3_t const & v0, double Mass0, double Density0, double h0,bool Fixed)
 {
 	ct = 0;
@@ -47,8 +76,6 @@ inline Particle::Particle(int Tag, Vec3_t const & x0, Vec3_t const & v0, double
     TIn		= 4.0;
     TIInitDist  = 0.0;
 
-    Densitya = 0.0;
-    Densityb = 0.0;
     Density = Density0;
     RefDensity = Density0;
 
@@ -63,7 +90,6 @@ inline Particle::Particle(int Tag, Vec3_t const & x0, Vec3_t const & v0, double
     Pressure=0.0;
     ID = Tag;
     CC[0]= CC[1] = CC[2] = 0;
-    LL=0;
     ZWab = 0.0;
     SumDen = 0.0;
     dDensity=0.0;
@@ -124,24 +150,19 @@ inline Particle::Particle(int Tag, Vec3_t const & x0, Vec3_t const & v0, double
   
   not_write_surf_ID = false;
   is_ghost = false;
+  inner_mirr_part = -1;
   mesh = -1;
   v_max = Vec3_t(1.e10,1.e10,1.e10);
 
-    set_to_zero(Strainb);
     set_to_zero(Strain);
-    set_to_zero(Sigmab);
     set_to_zero(Sigma);
 //    set_to_zero(FSISigma);
-    set_to_zero(Sigmaa);
     set_to_zero(ShearStress);
-    set_to_zero(ShearStressb);
     set_to_zero(TIR);
     set_to_zero(StrainRate);
     set_to_zero(RotationRate);
     omp_init_lock(&my_lock);
 		
-  for (int i=0;i<6;i++) strrate[i] = 0.;
-  for (int i=0;i<3;i++) rotrate[i] = 0 ;
   
   impose_vel = false; //For bonded contact
   
@@ -156,6 +177,21 @@ inline Particle::Particle(int Tag, Vec3_t const & x0, Vec3_t const & v0, double
   
 }
 
+inline VerletHistory & Particle::VerletHist(){
+	if (!hist_v) hist_v.reset(new VerletHistory());
+	return *hist_v;
+}
+
+inline LeapfrogHistory & Particle::LeapfrogHist(){
+	if (!hist_lf) hist_lf.reset(new LeapfrogHistory());
+	return *hist_lf;
+}
+
+inline Matrix & Particle::BMat(){
+	if (!m_B) m_B.reset(new Matrix(6,3));
+	return *m_B;
+}
+
 inline void Particle::Move(double dt, Vec3_t Domainsize, Vec3_t domainmax, Vec3_t domainmin, size_t Scheme, Mat3_t I)
 {
 	if (Scheme == 0)
@@ -188,6 +224,7 @@ inline void Particle::Move(double dt, Vec3_t Domainsize, Vec3_t domainmax, Vec3_
 
 inline void Particle::Move_MVerlet (Mat3_t I, double dt)
 {
+	VerletHistory &H = VerletHist();
 	if (FirstStep) {
 		ct = 30;
 		FirstStep = false;
@@ -200,17 +237,17 @@ inline void Particle::Move_MVerlet (Mat3_t I, double dt)
 	if (ct == 30) {
 		if (Shepard && ShepardCounter == ShepardStep) {
 			if (ZWab>0.6) {
-				Densityb	= SumDen/ZWab;
+				H.Densityb	= SumDen/ZWab;
 //				Densityb	= Density;
 				Density		= SumDen/ZWab;
 			}
 			else {
-				Densityb	= Density;
+				H.Densityb	= Density;
 				Density		+=dt*dDensity;
 			}
 		}
 		else {
-			Densityb		= Density;
+			H.Densityb		= Density;
 			Density			+=dt*dDensity;
 		}
 
@@ -220,22 +257,22 @@ inline void Particle::Move_MVerlet (Mat3_t I, double dt)
 		
 		if (Shepard && ShepardCounter == ShepardStep) {
 			if (ZWab>0.6) {
-				Densityb	= SumDen/ZWab;
+				H.Densityb	= SumDen/ZWab;
 //				Densityb	= Density;
 				Density		= SumDen/ZWab;
 			}
 			else
 			{
 				double dens	= Density;
-				Density		= Densityb + 2.0*dt*dDensity;
-				Densityb	= dens;
+				Density		= H.Densityb + 2.0*dt*dDensity;
+				H.Densityb	= dens;
 			}
 		}
 		else
 		{
 			double dens	= Density;
-			Density		= Densityb + 2.0*dt*dDensity;
-			Densityb	= dens;
+			Density		= H.Densityb + 2.0*dt*dDensity;
+			H.Densityb	= dens;
 		}
 
 		Vec3_t temp;
@@ -255,18 +292,17 @@ inline void Particle::Move_MVerlet (Mat3_t I, double dt)
 }
 
 inline void Particle::Mat2Euler(double dt) {
+	VerletHistory &H = VerletHist();
 	Pressure = EOS(PresEq, Cs, P0,Density, RefDensity);
 
 	// Jaumann rate terms
-	Mat3_t RotationRateT, Stress,SRT,RS;
-	Trans(RotationRate,RotationRateT);
-	Mult(ShearStress,RotationRateT,SRT);
-	Mult(RotationRate,ShearStress,RS);
+	Sym3_t Stress;
+	Sym3_t SRT_RS = Jaumann(ShearStress,RotationRate);	//S.RT + R.S
 
 	// Elastic prediction step (ShearStress_e n+1)
 	Stress			= ShearStress;
-	ShearStress	= dt*(2.0*G*(StrainRate-1.0/3.0*(StrainRate(0,0)+StrainRate(1,1)+StrainRate(2,2))*OrthoSys::I)+SRT+RS) + ShearStressb;
-	ShearStressb	= Stress;
+	ShearStress	= dt*(2.0*G*Deviator(StrainRate)+SRT_RS) + H.ShearStressb;
+	H.ShearStressb	= Stress;
 
 	if (Fail == 1) {
 		double J2	= 0.5*(ShearStress(0,0)*ShearStress(0,0) + 2.0*ShearStress(0,1)*ShearStress(1,0) +
@@ -283,11 +319,11 @@ inline void Particle::Mat2Euler(double dt) {
 		}
 	}
 
-	Sigma			= -Pressure * OrthoSys::I + ShearStress;	//Fraser, eq 3.32
+	Sigma			= -Pressure * SymIdentity() + ShearStress;	//Fraser, eq 3.32
 
 	Stress	= Strain;
-	Strain	= dt*StrainRate + Strainb;
-	Strainb	= Stress;
+	Strain	= dt*StrainRate + H.Strainb;
+	H.Strainb	= Stress;
 
 	if (Fail > 1) {
 		std::cout<<"Undefined failure criteria for solids"<<std::endl;
@@ -296,20 +332,19 @@ inline void Particle::Mat2Euler(double dt) {
 }
 
 inline void Particle::Mat2Verlet(double dt) {
+	VerletHistory &H = VerletHist();
 	Pressure = EOS(PresEq, Cs, P0,Density, RefDensity);
 
 	// Jaumann rate terms
-	Mat3_t RotationRateT, Stress,SRT,RS;
-	Trans(RotationRate,RotationRateT);
-	Mult(ShearStress,RotationRateT,SRT);
-	Mult(RotationRate,ShearStress,RS);
+	Sym3_t Stress;
+	Sym3_t SRT_RS = Jaumann(ShearStress,RotationRate);	//S.RT + R.S
 
 	double dep = 0.;
 
 	// Elastic prediction step (ShearStress_e n+1)
 	Stress			= ShearStress;
-	ShearStress		= dt*(2.0*G*(StrainRate-1.0/3.0*(StrainRate(0,0)+StrainRate(1,1)+StrainRate(2,2))*OrthoSys::I)+SRT+RS) + ShearStressb;
-	ShearStressb	= Stress;
+	ShearStress		= dt*(2.0*G*Deviator(StrainRate)+SRT_RS) + H.ShearStressb;
+	H.ShearStressb	= Stress;
 
 	if (Fail == 1) {
 		double J2	= 0.5*(ShearStress(0,0)*ShearStress(0,0) + 2.0*ShearStress(0,1)*ShearStress(1,0) +
@@ -325,11 +360,11 @@ inline void Particle::Mat2Verlet(double dt) {
 		}
 	}
 
-	Sigma			= -Pressure * OrthoSys::I + ShearStress;	//Fraser, eq 3.32
+	Sigma			= -Pressure * SymIdentity() + ShearStress;	//Fraser, eq 3.32
 
 	Stress	= Strain;
-	Strain	= 2.0*dt*StrainRate + Strainb;
-	Strainb	= Stress;
+	Strain	= 2.0*dt*StrainRate + H.Strainb;
+	H.Strainb	= Stress;
 
 
 	if (Fail > 1) {
@@ -427,13 +462,12 @@ inline void Particle::Mat2Verlet(double dt) {
 // }
 
 inline void Particle::Mat2MVerlet(double dt) {
+	VerletHistory &H = VerletHist();
 	Pressure = EOS(PresEq, Cs, P0,Density, RefDensity);
 
 	// Jaumann rate terms
-	Mat3_t RotationRateT, Stress,SRT,RS;
-	Trans(RotationRate,RotationRateT);
-	Mult(ShearStress,RotationRateT,SRT);
-	Mult(RotationRate,ShearStress,RS);
+	Sym3_t Stress;
+	Sym3_t SRT_RS = Jaumann(ShearStress,RotationRate);	//S.RT + R.S
 
 	double dep = 0.;
   double sig_trial;
@@ -441,10 +475,10 @@ inline void Particle::Mat2MVerlet(double dt) {
 	// Elastic prediction step (ShearStress_e n+1)
 	Stress			= ShearStress;
 	if (ct == 30)
-		ShearStress	= dt*(2.0*G*(StrainRate-1.0/3.0*(StrainRate(0,0)+StrainRate(1,1)+StrainRate(2,2))*OrthoSys::I)+SRT+RS) + ShearStress;
+		ShearStress	= dt*(2.0*G*Deviator(StrainRate)+SRT_RS) + ShearStress;
 	else
-		ShearStress	= 2.0*dt*(2.0*G*(StrainRate-1.0/3.0*(StrainRate(0,0)+StrainRate(1,1)+StrainRate(2,2))*OrthoSys::I)+SRT+RS) + ShearStressb;
-	ShearStressb	= Stress;
+		ShearStress	= 2.0*dt*(2.0*G*Deviator(StrainRate)+SRT_RS) + H.ShearStressb;
+	H.ShearStressb	= Stress;
 
 	if (Fail == 1) {
 		double J2	= 0.5*(ShearStress(0,0)*ShearStress(0,0) + 2.0*ShearStress(0,1)*ShearStress(1,0) +
@@ -462,7 +496,7 @@ inline void Particle::Mat2MVerlet(double dt) {
 		}
 	}
 
-	Sigma			= -Pressure * OrthoSys::I + ShearStress;	//Fraser, eq 3.32
+	Sigma			= -Pressure * SymIdentity() + ShearStress;	//Fraser, eq 3.32
 	
 	if ( dep > 0.0 ) {
 		double f = dep/Sigmay;
@@ -478,8 +512,8 @@ inline void Particle::Mat2MVerlet(double dt) {
 	if (ct == 30)
 		Strain	= dt*StrainRate + Strain;
 	else
-		Strain	= 2.0*dt*StrainRate + Strainb;
-	Strainb	= Stress;
+		Strain	= 2.0*dt*StrainRate + H.Strainb;
+	H.Strainb	= Stress;
 
 
 	if (Fail > 1)
@@ -548,13 +582,14 @@ inline void Particle::LimitVel(){
 //THIS IS THE KICK-DRIF-KICK
 inline void Particle::Move_Leapfrog(Mat3_t I, double dt)
 {
+	LeapfrogHistory &H = LeapfrogHist();
 	if (FirstStep) {
-		Densitya = Density - dt/2.0*dDensity;
+		H.Densitya = Density - dt/2.0*dDensity;
 		va = v - dt/2.0*a;
 	}
-	Densityb = Densitya;
-	Densitya += dt*dDensity;
-	Density = (Densitya+Densityb)/2.0;
+	H.Densityb = H.Densitya;
+	H.Densitya += dt*dDensity;
+	Density = (H.Densitya+H.Densityb)/2.0;
 	vb = va;
 	va += dt*a;
 	v = (va + vb)/2.0;
@@ -572,12 +607,13 @@ inline void Particle::Move_Leapfrog(Mat3_t I, double dt)
 //Not update Stress (In order to update ir later)
 inline void Particle::UpdateDensity_Leapfrog(double dt)
 {
+	LeapfrogHistory &H = LeapfrogHist();
 	if (FirstStep) {
-		Densitya = Density - dt/2.0*dDensity;
+		H.Densitya = Density - dt/2.0*dDensity;
 	}
-	Densityb = Densitya;
-	Densitya += dt*dDensity;
-	Density = (Densitya+Densityb)/2.0;
+	H.Densityb = H.Densitya;
+	H.Densitya += dt*dDensity;
+	Density = (H.Densitya+H.Densityb)/2.0;
 }
 
 inline void Particle::UpdateVelPos_Leapfrog(double dt)
@@ -598,12 +634,13 @@ inline void Particle::UpdateVelPos_Leapfrog(double dt)
 }
 
 void Particle::TempCalcLeapfrog	(double dt){
+	LeapfrogHistory &H = LeapfrogHist();
 	
 		if (ThermalFirstStep) {
 		//Densitya = T - dt/2.0*dDensity;
 		//va = v - dt/2.0*a;
 		//Tb=T;
-		Ta = T - dt/2.0*dTdt;
+		H.Ta = T - dt/2.0*dTdt;
 		
 		ThermalFirstStep = false;
 	}
@@ -614,9 +651,9 @@ void Particle::TempCalcLeapfrog	(double dt){
 	// va += dt*a;
 	// v = (va + vb)/2.0;
 	// x += dt*va;
-	Tb  = Ta;
-	Ta += dTdt * dt;
-	T = ( Ta + Tb ) / 2.;
+	H.Tb  = H.Ta;
+	H.Ta += dTdt * dt;
+	T = ( H.Ta + H.Tb ) / 2.;
 	
 }
 
@@ -714,20 +751,12 @@ inline void Particle::CalculateEquivalentStress () {
 // }
 
 inline void Particle::Mat2Leapfrog(double dt) {
+	LeapfrogHistory &H = LeapfrogHist();
 	
 	Pressure = EOS(PresEq, Cs, P0,Density, RefDensity);
 
 	// Jaumann rate terms
-	Mat3_t RotationRateT,SRT,RS;
-	#ifdef FLAT_TENSORS
-
-	//#else 
-	StrainRate 	  = FromFlatSym			        (strrate);
-	RotationRate 	= FromFlatAntiSymNullDiag	(rotrate);	
-	#endif
-	Trans(RotationRate,RotationRateT);
-	Mult(ShearStress,RotationRateT,SRT);
-	Mult(RotationRate,ShearStress,RS);
+	Sym3_t SRT_RS = Jaumann(ShearStress,RotationRate);	//S.RT + R.S
 	
 	double dep =0.;
 	double prev_sy;
@@ -735,9 +764,9 @@ inline void Particle::Mat2Leapfrog(double dt) {
 	
 	// Elastic prediction step (ShearStress_e n+1)
 	if (FirstStep)
-		ShearStressa	= -dt/2.0*(2.0*G*(StrainRate-1.0/3.0*(StrainRate(0,0)+StrainRate(1,1)+StrainRate(2,2))*OrthoSys::I)+SRT+RS) + ShearStress;
-	ShearStressb	= ShearStressa;
-	ShearStressa	= dt*(2.0*G*(StrainRate-1.0/3.0*(StrainRate(0,0)+StrainRate(1,1)+StrainRate(2,2))*OrthoSys::I)+SRT+RS) + ShearStressa;
+		H.ShearStressa	= -dt/2.0*(2.0*G*Deviator(StrainRate)+SRT_RS) + ShearStress;
+	H.ShearStressb	= H.ShearStressa;
+	H.ShearStressa	= dt*(2.0*G*Deviator(StrainRate)+SRT_RS) + H.ShearStressa;
   
 	//cout << "StrainRate"<<StrainRate<<endl;
                         
@@ -769,11 +798,11 @@ inline void Particle::Mat2Leapfrog(double dt) {
 			Sigmay = mat->CalcYieldStress(pl_strain,eff_strain_rate,T);
 		}			
 	if (Fail == 1) {
-		double J2	= 0.5*(ShearStressa(0,0)*ShearStressa(0,0) + 2.0*ShearStressa(0,1)*ShearStressa(1,0) +
-						2.0*ShearStressa(0,2)*ShearStressa(2,0) + ShearStressa(1,1)*ShearStressa(1,1) +
-						2.0*ShearStressa(1,2)*ShearStressa(2,1) + ShearStressa(2,2)*ShearStressa(2,2));
+		double J2	= 0.5*(H.ShearStressa(0,0)*H.ShearStressa(0,0) + 2.0*H.ShearStressa(0,1)*H.ShearStressa(1,0) +
+						2.0*H.ShearStressa(0,2)*H.ShearStressa(2,0) + H.ShearStressa(1,1)*H.ShearStressa(1,1) +
+						2.0*H.ShearStressa(1,2)*H.ShearStressa(2,1) + H.ShearStressa(2,2)*H.ShearStressa(2,2));
 		//Scale back, Fraser Eqn 3-53
-		ShearStressa= std::min((Sigmay/sqrt(3.0*J2)),1.0)*ShearStressa;
+		H.ShearStressa= std::min((Sigmay/sqrt(3.0*J2)),1.0)*H.ShearStressa;
 		//In case of Flow Stress Model, Initial sigma_y should be calculated
 		double sig_trial = sqrt(3.0*J2);
 		//cout << "Sigmay "<<Sigmay<<endl;
@@ -852,9 +881,9 @@ inline void Particle::Mat2Leapfrog(double dt) {
       //cout << "delta_pl_strain sigmay"<<delta_pl_strain<<", "<<Sigmay<<endl;
 		}//sig_trial > Sigmay
 	} //If fail
-	ShearStress	= 1.0/2.0*(ShearStressa+ShearStressb);
+	ShearStress	= 1.0/2.0*(H.ShearStressa+H.ShearStressb);
 	
-	Sigma = -Pressure * OrthoSys::I + ShearStress;	//Fraser, eq 3.32
+	Sigma = -Pressure * SymIdentity() + ShearStress;	//Fraser, eq 3.32
 	// dlambda = 3/2 dep /sigmay
 	if ( dep > 0.0 ) {
 		double f = dep/Sigmay;
@@ -877,10 +906,10 @@ inline void Particle::Mat2Leapfrog(double dt) {
 		update = false;
 
 	if (FirstStep)
-		Straina	= -dt/2.0*StrainRate + Strain;
-	Strainb	= Straina;
-	Straina	= dt*StrainRate + Straina;
-	Strain	= 1.0/2.0*(Straina+Strainb);
+		H.Straina	= -dt/2.0*StrainRate + Strain;
+	H.Strainb	= H.Straina;
+	H.Straina	= dt*StrainRate + H.Straina;
+	Strain	= 1.0/2.0*(H.Straina+H.Strainb);
 
 	
 	if (Fail > 1){
@@ -922,7 +951,7 @@ inline void Particle::translate(double dt, Vec3_t Domainsize, Vec3_t domainmax,
 inline void Particle::CalcPlasticWorkHeat(const double &dt){
 	
 	if (delta_pl_strain > 0.0) {
-		Mat3_t depdt = 1./dt*Strain_pl_incr;
+		Sym3_t depdt = 1./dt*Strain_pl_incr;
 		// Double inner product, Fraser 3-106
 		//cout <<"depdt"<<endl;
 		//cout << depdt<<endl;
@@ -952,7 +981,7 @@ inline void Particle::CalcIntEnergyEqn(){
 //THIS SHOULD BE CALLED AFTER CalcForces2233
 inline void Particle::CalcThermalExpStrainRate(){
 	
-	StrainRate	= StrainRate + th_exp*dTdt*OrthoSys::I;
+	StrainRate	= StrainRate + SymIdentity(th_exp*dTdt);
 	
 }
 
@@ -965,10 +994,8 @@ inline void Particle::CalcStressStrain(double dt) {
 	Pressure = EOS(PresEq, Cs, P0,rho, RefDensity);
 
 	// Jaumann rate terms
-	Mat3_t RotationRateT, Stress,SRT,RS;
-	Trans(RotationRate,RotationRateT);
-	Mult(ShearStress,RotationRateT,SRT);
-	Mult(RotationRate,ShearStress,RS);
+	Sym3_t Stress;
+	Sym3_t SRT_RS = Jaumann(ShearStress,RotationRate);	//S.RT + R.S
 
 	double dep = 0.;
   double sig_trial = 0.;
@@ -978,7 +1005,7 @@ inline void Particle::CalcStressStrain(double dt) {
 	// ShearStressb	= ShearStressa;
 	// ShearStressa	= dt*(2.0*G*(StrainRate-1.0/3.0*(StrainRate(0,0)+StrainRate(1,1)+StrainRate(2,2))*OrthoSys::I)+SRT+RS) + ShearStressa;
 	
-	ShearStress	= dt*(2.0*G*(StrainRate-1.0/3.0*(StrainRate(0,0)+StrainRate(1,1)+StrainRate(2,2))*OrthoSys::I)+SRT+RS) + ShearStress;
+	ShearStress	= dt*(2.0*G*Deviator(StrainRate)+SRT_RS) + ShearStress;
   
   eff_strain_rate = sqrt ( 	0.5*( (StrainRate(0,0)-StrainRate(1,1))*(StrainRate(0,0)-StrainRate(1,1)) +
                                 (StrainRate(1,1)-StrainRate(2,2))*(StrainRate(1,1)-StrainRate(2,2)) +
@@ -1035,7 +1062,7 @@ inline void Particle::CalcStressStrain(double dt) {
   }//Fail
 
 	//ShearStress	= 1.0/2.0*(ShearStressa+ShearStressb);
-	Sigma			= -Pressure * OrthoSys::I + ShearStress;	//Fraser, eq 3.32
+	Sigma			= -Pressure * SymIdentity() + ShearStress;	//Fraser, eq 3.32
 	
 	if ( dep > 0.0 ) {
 		double f = dep/Sigmay;
@@ -1068,11 +1095,12 @@ inline void Particle::CalcStressStrain(double dt) {
 
 /// IMPLICIT SOLVER
 inline void Particle::AddBMat(const Vec3_t &d_dx){
+  Matrix &B = BMat();
   for (int i=0;i<3;i++)
-    m_B.Add(i,i, d_dx(i));
-  m_B.Add(3,1, d_dx(2));        m_B.Add(3,2, d_dx(1));
-  m_B.Add(4,0, d_dx(2));        m_B.Add(4,1, d_dx(2));
-  m_B.Add(5,0, d_dx(2));        m_B.Add(5,1, d_dx(0)); 
+    B.Add(i,i, d_dx(i));
+  B.Add(3,1, d_dx(2));        B.Add(3,2, d_dx(1));
+  B.Add(4,0, d_dx(2));        B.Add(4,1, d_dx(2));
+  B.Add(5,0, d_dx(2));        B.Add(5,1, d_dx(0)); 
 
 }
 
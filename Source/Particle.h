@@ -36,17 +36,37 @@
 #define JOHNSON_COOK		2
 #define _GMT_	                           3
 
+#include <memory>
 #include "Matrix.h"  /////ONLY FOR IMPLICIT SOLVER
 
-//#define 	FLAT_TENSORS
-
 #include "Plane.h" //ONLY FOR GHOST
+#include "ParticlePool.h"
 
 enum Ghost_Type {Symmetric = 0, Periodic = 1, Mirror_XYZ = 2 };
 
 class Plane;    //For analytical contact 
 namespace SPH {
 
+	// Multistep integrator histories. Each integrator keeps only the fields it
+	// steps, allocated by Particle::VerletHist() / LeapfrogHist() on first use,
+	// so runs with other solvers do not carry them
+	struct VerletHistory {		///< n-1 values (Verlet, Modified Verlet, Euler)
+		double 	Densityb;	///< Density of the particle n-1
+		Sym3_t	ShearStressb;	///< Deviatoric shear stress tensor n-1
+		Sym3_t	Strainb;	///< Total Strain n-1
+		
+		VerletHistory();
+	};
+
+	struct LeapfrogHistory {	///< n+1/2 (a) and n-1/2 (b) values
+		double 	Densitya, Densityb;		///< Density
+		Sym3_t	ShearStressa, ShearStressb;	///< Deviatoric shear stress tensor
+		Sym3_t	Straina, Strainb;		///< Total Strain
+		double	Ta, Tb;				///< Temperature
+		
+		LeapfrogHistory();
+	};
+
 	class Particle
 	{
 	public:
@@ -97,8 +117,6 @@ namespace SPH {
     double ps_energy; //PER UNIT VOLUME
 
 		double	Density, Density_real;	///< Density of the particle n+1, Density_real is the real density used in Axisymm calcs
-		double 	Densitya;	///< Density of the particle n+1/2 (Leapfrog)
-		double 	Densityb;	///< Density of the particle n-1 (Modified Verlet)
 		double 	dDensity;	///< Rate of density change in time based on state equations n
     double  etaDens; //Desity in axi-symm problems
 		double 	RefDensity;	///< Reference Density of Particle
@@ -109,32 +127,27 @@ namespace SPH {
     double  friction_hfl; //Surface 
     double  cshearabs;   // Contact shear stress module, for comparison
     
-		Mat3_t	StrainRate;	///< Global shear Strain rate tensor n
-		Mat3_t	RotationRate;	///< Global rotation tensor n
+		Sym3_t	StrainRate;	///< Global shear Strain rate tensor n
+		Skew3_t	RotationRate;	///< Global rotation tensor n
 		double	ShearRate;	///< Global shear rate for fluids
 		double	SBar;		///< shear component for LES
     double  eff_strain_rate;
                 
-		double strrate[6], rotrate[3];	//Null Diagonal for rot rate
-		Mat3_t	ShearStress;	///< Deviatoric shear stress tensor (deviatoric part of the Cauchy stress tensor) n+1
-		Mat3_t	ShearStressa;	///< Deviatoric shear stress tensor (deviatoric part of the Cauchy stress tensor) n+1/2 (Leapfrog)
-		Mat3_t	ShearStressb;	///< Deviatoric shear stress tensor (deviatoric part of the Cauchy stress tensor) n-1 (Modified Verlet)
+		Sym3_t	ShearStress;	///< Deviatoric shear stress tensor (deviatoric part of the Cauchy stress tensor) n+1
 
-		Mat3_t	Sigma;		///< Cauchy stress tensor (Total Stress) n+1
+		Sym3_t	Sigma;		///< Cauchy stress tensor (Total Stress) n+1
 
-		Mat3_t	Sigmaa;		///< Cauchy stress tensor (Total Stress) n+1/2 (Leapfrog)
-		Mat3_t	Sigmab;		///< Cauchy stress tensor (Total Stress) n-1 (Modified Verlet)
+		std::unique_ptr <VerletHistory>		hist_v;		///< Empty until the integrator needs it, see VerletHist()
+		std::unique_ptr <LeapfrogHistory>	hist_lf;	///< Empty until the integrator needs it, see LeapfrogHist()
 		
 		double Sigma_eq;	//Von Mises
 		
 		////////////////// PLASTIC THINGS
-		Mat3_t	Strain;							///< Total Strain n+1
-		Mat3_t	Straina;					///< Total Strain n+1/2 (Leapfrog)
-		Mat3_t	Strainb;					///< Total Strain n-1 (Modified Verlet)
-		Mat3_t  Strain_pl;				//// Plastic Strain
-		Mat3_t  Strain_pl_incr;		//// Plastic Strain - INTERNAL, JUST FOR PLASTIC THERMAL HEAT GEN CALCULATION
+		Sym3_t	Strain;							///< Total Strain n+1
+		Sym3_t  Strain_pl;				//// Plastic Strain
+		Sym3_t  Strain_pl_incr;		//// Plastic Strain - INTERNAL, JUST FOR PLASTIC THERMAL HEAT GEN CALCULATION
     
-    Matrix  m_B;              //B matrix for strain (IMPLICIT SOLVER)
+    std::unique_ptr <Matrix> m_B;   //B matrix for strain (IMPLICIT SOLVER), empty if not used, see BMat()
 		
     Plane  *plane;
 		
@@ -169,8 +182,7 @@ namespace SPH {
 		double	V;		///< Volume of a particle
 
 		double 	h,hmin,hmax,hini;		///< Smoothing length of the particle
-		int    	LL;		///< Linked-List variable to show the next particle in the list of a cell
-		int    	CC[3];		///< Current cell No for the particle (linked-list)
+		int    	CC[3];		///< Current cell No for the particle (cell grid)
 		int		ct;		///< Correction step for the Modified Verlet Algorithm
 		double	SumKernel;	///< Summation of the kernel value for neighbour particles
 		bool	FirstStep;	///< to initialize the integration scheme
@@ -182,7 +194,6 @@ namespace SPH {
 		
 		//LUCIANO: THERMAL PROPERTIES
 		double T,k_T,cp_T,dTdt;			// Temperature, avoid permeability	
-		double Ta,Tb;						//Temperature (t-1) for leapfrog
 		double q_source;
 		double q_conv,T_inf,h_conv;				//Different heat source terms
     double q_cont_conv;
@@ -232,6 +243,17 @@ namespace SPH {
 			
 		// Constructor
 		Particle						(int Tag, Vec3_t const & x0, Vec3_t const & v0, double Mass0, double Density0, double h0, bool Fixed=false);
+		// A particle owns its histories, B matrix and lock, so it is not copied.
+		// It is only moved to other memory (Domain::PlaceParticles)
+		Particle						(const Particle &) = delete;
+		Particle & operator=			(const Particle &) = delete;
+		Particle						(Particle &&) = default;
+		
+		// Pool allocation (ParticlePool.h), particles created in sequence are contiguous
+		static void * operator new		(size_t size);
+		static void * operator new		(size_t size, void *place) {return place;}	//Placement, PlaceParticles
+		static void 	operator delete	(void *p, size_t size);
+		static void 	operator delete	(void *p, void *place) {}
 
 		// Methods
 		void Move						(double dt, Vec3_t Domainsize, Vec3_t domainmax, Vec3_t domainmin,size_t Scheme, Mat3_t I);	///< Update the important quantities of a particle
@@ -259,6 +281,10 @@ namespace SPH {
     
     //Implicit Solver
     inline void AddBMat(const Vec3_t &);
+    
+    inline VerletHistory   & VerletHist();	//Allocated (zeroed) on first call
+    inline LeapfrogHistory & LeapfrogHist();
+    inline Matrix          & BMat();			//Implicit B matrix (6x3), allocated on first call
 		
 		bool is_axisymm;  //FOR EOS CALC, should alter density
 
@@ -0,0 +1,91 @@
+#ifndef SPH_PARTICLE_POOL_H
+#define SPH_PARTICLE_POOL_H
+
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <new>
+#include <omp.h>
+
+namespace SPH {
+
+//////////////////////////////////////////////////////////////////////////////
+// Fixed size object pool (arena) used by Particle::operator new. Objects   //
+// are taken in order from blocks of POOL_BLOCK, so particles created one   //
+// after the other (AddBoxLength, etc.) are contiguous in memory and there  //
+// is one heap allocation per block instead of one per particle. Deleted    //
+// objects go to a free list and are reused. Trim releases the blocks with   //
+// no live objects (e.g. once Domain::PlaceParticles has moved them out).    //
+//////////////////////////////////////////////////////////////////////////////
+#define POOL_BLOCK 16384
+
+class ObjectPool {
+public:
+  ObjectPool(const size_t &size): m_size(size), m_used(POOL_BLOCK) {}
+
+  void * Get(){
+    void *p;
+    #pragma omp critical (object_pool)
+    {
+      if (!m_free.empty()) {
+        p = m_free.back(); 
+        m_free.pop_back();
+      } else {
+        if (m_used == POOL_BLOCK) {
+          m_blocks.push_back(static_cast<char*>(::operator new(POOL_BLOCK*m_size)));
+          m_used = 0;
+        }
+        p = m_blocks.back() + (m_used++)*m_size;
+      }
+    }
+    return p;
+  }
+
+  void Put(void *p){
+    #pragma omp critical (object_pool)
+    m_free.push_back(p);
+  }
+
+  //Releases every block whose objects are all in the free list
+  void Trim(){
+    #pragma omp critical (object_pool)
+    {
+      std::vector <char*> sorted(m_blocks);
+      std::sort(sorted.begin(), sorted.end());
+      std::vector <size_t> nfree(sorted.size(), 0);
+      for (size_t i=0;i<m_free.size();i++) nfree[Block(sorted, m_free[i])]++;
+
+      std::vector <bool> release(sorted.size(), false);
+      std::vector <char*> blocks;
+      for (size_t b=0;b<m_blocks.size();b++){
+        size_t s = Block(sorted, m_blocks[b]);
+        size_t used = (b == m_blocks.size()-1) ? m_used : POOL_BLOCK;
+        if (nfree[s] == used) release[s] = true;
+        else                  blocks.push_back(m_blocks[b]);
+      }
+      if (blocks.size() < m_blocks.size()) {
+        std::vector <void*> free_;
+        for (size_t i=0;i<m_free.size();i++)
+          if (!release[Block(sorted, m_free[i])]) free_.push_back(m_free[i]);
+        m_free.swap(free_);
+        if (release[Block(sorted, m_blocks.back())]) m_used = POOL_BLOCK; //Next Get opens a new block
+        for (size_t s=0;s<sorted.size();s++)
+          if (release[s]) ::operator delete(sorted[s]);
+        m_blocks.swap(blocks);
+      }
+    }
+  }
+
+private:
+  //Index in sorted of the block holding p
+  inline size_t Block(const std::vector <char*> &sorted, const void *p) const{
+    return std::upper_bound(sorted.begin(), sorted.end(), (char*)p) - sorted.begin() - 1;
+  }
+  size_t m_size, m_used;
+  std::vector <char*> m_blocks;
+  std::vector <void*> m_free;
+};
+
+}; // namespace SPH
+
+#endif //SPH_PARTICLE_POOL_H
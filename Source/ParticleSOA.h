@@ -0,0 +1,111 @@
+#ifndef SPH_PARTICLE_SOA_H
+#define SPH_PARTICLE_SOA_H
+
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#include "Precision.h"
+
+#define SOA_ALIGN   64  //CACHE LINE
+
+namespace SPH {
+
+//////////////////////////////////////////////////////////////////////////////
+// Structure of arrays with the fields read and written by the pair kernels //
+// (CalcAccel, CalcRateTensors and CalcDensInc). It is loaded once          //
+// (Domain::LoadSOA) and then the code that changes a field (integrators,  //
+// ghosts, velocity BCs) stores the new value with Domain::StoreSOA, so the //
+// kernels read it without a gather pass. Particle keeps the same values for //
+// contact, thermal and output. Vectors are stored as 3 consecutive values  //
+// per particle, symmetric tensors as 6 (FromFlatSym order: 00,11,22,01,12,02)
+// and antisymmetric ones as 3 (FromFlatAntiSymNullDiag order: 01,12,02).   //
+// Gathered fields are of type Real (sph_real, see Precision.h), positions  //
+// relative to x0; accumulators are always double.                          //
+//////////////////////////////////////////////////////////////////////////////
+//Field groups of Domain::StoreSOA
+enum SOA_Field {
+  SOA_POS    = 1,   //x
+  SOA_VEL    = 2,   //v
+  SOA_DENS   = 4,   //Density and sound speed
+  SOA_STRESS = 8,   //Sigma and tensile instability
+  SOA_H      = 16,
+  SOA_ALL    = 31
+};
+
+template <typename Real>
+struct ParticleSOA_T {
+  size_t  n;                  //Allocated particle count
+  double  x0[3];              //Local origin of x
+  Real    *x, *v;             //3 per particle
+  Real    *h, *rho, *mass;
+  Real    *cs;                //Sound speed, evaluated with the density
+  Real    *alpha, *beta;      //Artificial viscosity
+  Real    *sigma, *tir;       //6 per particle
+  Real    *ti, *tin, *tidist; //Tensile instability
+  double  *a;                 //Accumulators (locking sum), 3 per particle
+  double  *drho;              
+  double  *strrate;           //6 per particle
+  double  *rotrate;           //3 per particle
+
+  ParticleSOA_T():n(0){ SetNull(); x0[0] = x0[1] = x0[2] = 0.; }
+  ~ParticleSOA_T(){ Free(); }
+
+  inline void Resize(const size_t &np){
+    if (np == n) return;
+    Free();
+    if (np == 0) return;
+    n = np;
+    x       = Alloc<Real>(3*n);   v       = Alloc<Real>(3*n);   a       = Alloc<double>(3*n);
+    h       = Alloc<Real>(n);     rho     = Alloc<Real>(n);     mass    = Alloc<Real>(n);
+    cs      = Alloc<Real>(n);     alpha   = Alloc<Real>(n);     beta    = Alloc<Real>(n);
+    sigma   = Alloc<Real>(6*n);   tir     = Alloc<Real>(6*n);
+    ti      = Alloc<Real>(n);     tin     = Alloc<Real>(n);     tidist  = Alloc<Real>(n);
+    drho    = Alloc<double>(n);   strrate = Alloc<double>(6*n); rotrate = Alloc<double>(3*n);
+  }
+
+  inline void Free(){
+    Real **f[] = {&x,&v,&h,&rho,&mass,&cs,&alpha,&beta,&sigma,&tir,&ti,&tin,&tidist};
+    for (int i=0;i<13;i++) {FreeArray(*f[i]); *f[i] = NULL;}
+    double **d[] = {&a,&drho,&strrate,&rotrate};
+    for (int i=0;i<4;i++)  {FreeArray(*d[i]); *d[i] = NULL;}
+    n = 0;
+  }
+
+  private:
+  ParticleSOA_T(const ParticleSOA_T &);             //Not copyable, owns the arrays
+  ParticleSOA_T & operator= (const ParticleSOA_T &);
+
+  inline void SetNull(){
+    x = v = h = rho = mass = cs = alpha = beta = NULL;
+    sigma = tir = ti = tin = tidist = NULL;
+    a = drho = strrate = rotrate = NULL;
+  }
+
+  template <typename T>
+  static T * Alloc(const size_t &count){
+    void *p = NULL;
+    #ifdef _WIN32
+    p = _aligned_malloc(count*sizeof(T), SOA_ALIGN);
+    #else
+    if (posix_memalign(&p, SOA_ALIGN, count*sizeof(T)) != 0) p = NULL;
+    #endif
+    if (p == NULL) throw new Fatal("ParticleSOA: could not allocate aligned arrays.");
+    return static_cast<T*>(p);
+  }
+  
+  static void FreeArray(void *p){
+    if (!p) return;
+    #ifdef _WIN32
+    _aligned_free(p);
+    #else
+    free(p);
+    #endif
+  }
+};
+
+typedef ParticleSOA_T<sph_real> ParticleSOA;
+
+}; // namespace SPH
+
+#endif // SPH_PARTICLE_SOA_H
@@ -0,0 +1,20 @@
+#ifndef SPH_PRECISION_H
+#define SPH_PRECISION_H
+
+namespace SPH {
+
+//////////////////////////////////////////////////////////////////////////////
+// Precision policy of the pair kernel fields (ParticleSOA and the batched  //
+// kernels). SPH_SINGLE_PRECISION (CMake option SINGLE_PRECISION) stores     //
+// them as float, positions relative to a local origin. Particle state,     //
+// accumulators, energies and time are double in both builds.               //
+//////////////////////////////////////////////////////////////////////////////
+#ifdef SPH_SINGLE_PRECISION
+typedef float   sph_real;
+#else
+typedef double  sph_real;
+#endif
+
+}; // namespace SPH
+
+#endif // SPH_PRECISION_H
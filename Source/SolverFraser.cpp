@@ -39,6 +39,10 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
   ini_time_spent = 0.;	
 
 	InitialChecks();
+  if (nb_skin > 0. && model_damage){
+    cout << "WARNING: Verlet list (skin) neighbour search is not working with damage. Skin set to zero." <<endl;
+    nb_skin = 0.;
+  }
 	CellInitiate();
 	ListGenerate();
 	PrintInput(TheFileKey);
@@ -84,7 +88,8 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
 		cout << "dS, psi_cont, Contact Stiffness" << dS << ", " 
     << Particles[0]->Cs * Particles [0] ->Mass / dS << ", " << Particles [0] -> cont_stiff <<endl;
 		min_force_ts = deltat;
-		MainNeighbourSearch();
+		if (nb_skin > 0.) VerletNbUpdate(); //Pairs filtered with actual radius
+		else              MainNeighbourSearch();
     //CalcPairPosList();          //Only for h update
     //UpdateSmoothingLength();
 		SaveNeighbourData();				//Necesary to calulate surface! Using Particle->Nb (count), could be included in search
@@ -168,7 +173,7 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
     else 
       check_nb_every_time = false;
     
-		if (!model_damage) {
+		if (!model_damage && nb_skin == 0.) {
 		if (max > MIN_PS_FOR_NBSEARCH && !isyielding){ //First time yielding, data has not been cleared from first search
 			ClearNbData(); 
 			MainNeighbourSearch/*_Ext*/();
@@ -183,7 +188,24 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
 
 		if (model_damage && !isfirst) ts_nb_inc = 1; //NEVER SEARCH NBs
 		
-		if ( max > MIN_PS_FOR_NBSEARCH || isfirst || check_nb_every_time){	//TO MODIFY: CHANGE
+		if (nb_skin > 0.) { //Verlet list: searches only when particles moved more than skin allows
+      clock_beg = clock();
+      VerletNbUpdate();
+      CalcPairPosList();
+      if (h_update)
+        UpdateSmoothingLength();
+      SaveNeighbourData();
+      nb_time_spent+=(double)(clock() - clock_beg) / CLOCKS_PER_SEC;
+      
+      if (gradKernelCorr){
+        CalcGradCorrMatrix();	}
+        
+      if (contact) {
+        clock_beg = clock();
+        ContactNbUpdate(this);
+        contact_time_spent +=(double)(clock() - clock_beg) / CLOCKS_PER_SEC;
+      }
+    } else if ( max > MIN_PS_FOR_NBSEARCH || isfirst || check_nb_every_time){	//TO MODIFY: CHANGE
 			if ( ts_i == 0 ){
         
 				if (m_isNbDataCleared){
@@ -235,20 +257,27 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
 		//std::cout << "neighbour_time (chrono, clock): " << clock_time_spent << ", " << neighbour_time.count()<<std::endl;
     
     //cout << "Primary comp "<<endl;
-		GeneralBefore(*this);
+		CallGeneral(GeneralBefore);
 		PrimaryComputeAcceleration();
     //cout << "done "<<endl;
     clock_beg = clock();
     //If density is calculated AFTER displacements, it fails
+    bool fused = FusedKernels(); //Same x and v for density and rate tensors
+    if (fused) {
+      CalcDensRateTensorsFused();
+      DensReduction();
+    } else {
     CalcDensInc(); //TODO: USE SAME KERNEL?
     //#ifdef NONLOCK_SUM
     if (nonlock_sum) 
       DensReduction();
     //#endif
+    }
     #pragma omp parallel for schedule (static) num_threads(Nproc)
     for (int i=0; i<Particles.Size(); i++){
       //Particles[i]->UpdateDensity_Leapfrog(deltat);
       Particles[i]->Density += deltat*Particles[i]->dDensity;
+      StoreSOA(i, SOA_DENS);
     } 
     if (dom_bid_type == AxiSymmetric){
       for (int i=0; i<Particles.Size(); i++)
@@ -258,6 +287,7 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
 
     //cout << "rate tensor"<<endl;
 		clock_beg = clock();
+    if (!fused) 
     CalcRateTensors();  //With v and xn+1
 
     //#ifdef NONLOCK_SUM
@@ -268,6 +298,7 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
     for (int i=0; i<Particles.Size(); i++){
       //Particles[i]->Mat2Leapfrog(deltat); //Uses density  
       Particles[i]->CalcStressStrain(deltat); //Uses density  
+      StoreSOA(i, SOA_STRESS);
     } 
     stress_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;		
     
@@ -308,6 +339,7 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
       if      (contact_alg==Fraser)   CalcContactForces();
       if      (contact_alg==Wang)     CalcContactForcesWang();
       else if (contact_alg==Seo )     CalcContactForces2();
+      else if (contact_alg==SDF )     CalcContactForcesSDF();
      // else if (contact_alg==LSDyna )  CalcContactForcesLS();
     }
     contact_time_spent +=(double)(clock() - clock_beg) / CLOCKS_PER_SEC;
@@ -329,7 +361,7 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
     clock_beg = clock();  
     //BEFORE
     Vec3_t du;    
-    GeneralAfter(*this);//Reinforce BC vel   
+    CallGeneral(GeneralAfter);//Reinforce BC vel   
     //CorrectVelAcc(); //CYLINDRICAL SLICE, MOVED TO MOVEGHOST
     //cout << "moving ghost "<<endl;
     MoveGhost(); 
@@ -340,6 +372,7 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
       du = (Particles[i]->v + Particles[i]->VXSPH)*deltat + 0.5 * Particles[i]->a *deltat*deltat;
       Particles[i]->Displacement += du;
       Particles[i]->x += du;
+      StoreSOA(i, SOA_POS);
     }
     mov_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;  
     
@@ -352,12 +385,13 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
     #pragma omp parallel for schedule (static) num_threads(Nproc)
     for (int i=0; i<Particles.Size(); i++){
       Particles[i]->v += Particles[i]->a * deltat;
+      StoreSOA(i, SOA_VEL);
     }
 
     //CorrectVelAcc(); //CYLINDRICAL SLICE, MOVED TO MOVEGHOST
     MoveGhost();   
 
-    GeneralAfter(*this);//Reinforce BC vel   
+    CallGeneral(GeneralAfter);//Reinforce BC vel   
     mov_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;  
 
     #pragma omp parallel for schedule (static) num_threads(Nproc)
@@ -391,10 +425,11 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
       }
       //cout << "Updating contact particles"<<endl;
       UpdateContactParticles(); //Updates normal and velocities
+      if (bvh_contact) ContactBVHSearch(); //Cheap enough to follow the meshes every step
 		}
     contact_time_spent +=(double)(clock() - clock_beg) / CLOCKS_PER_SEC;
 		
-		if (max>MIN_PS_FOR_NBSEARCH){	//TODO: CHANGE TO FIND NEIGHBOURS
+		if (max>MIN_PS_FOR_NBSEARCH && nb_skin == 0.){	//TODO: CHANGE TO FIND NEIGHBOURS
 			if ( ts_i == (ts_nb_inc - 1) ){
 				ClearNbData();
 			}
@@ -508,6 +543,7 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
 	of.close(); //History 
   ofprop.close(); //Scalar prop
 	
+	FlushOutput(); //Pending asynchronous output
 	std::cout << "\n--------------Solving is finished---------------------------------------------------" << std::endl;
 
 }
@@ -182,7 +182,7 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
 			}		
 		//std::cout << "neighbour_time (chrono, clock): " << clock_time_spent << ", " << neighbour_time.count()<<std::endl;
 
-		GeneralBefore(*this);
+		CallGeneral(GeneralBefore);
 		PrimaryComputeAcceleration();
     
     clock_beg = clock();
@@ -196,6 +196,7 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
     for (size_t i=0; i<Particles.Size(); i++){
       //Particles[i]->UpdateDensity_Leapfrog(deltat);
       Particles[i]->Density += deltat*Particles[i]->dDensity;
+      StoreSOA(i, SOA_DENS);
     }    
     dens_time_spent+=(double)(clock() - clock_beg) / CLOCKS_PER_SEC;
 
@@ -210,6 +211,7 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
     for (size_t i=0; i<Particles.Size(); i++){
       //Particles[i]->Mat2Leapfrog(deltat); //Uses density  
       Particles[i]->CalcStressStrain(deltat); //Uses density  
+      StoreSOA(i, SOA_STRESS);
     } 
     stress_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;		
     
@@ -249,7 +251,7 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
     clock_beg = clock();  
     //BEFORE
     Vec3_t du;    
-    GeneralAfter(*this);//Reinforce BC vel   
+    CallGeneral(GeneralAfter);//Reinforce BC vel   
     //CorrectVelAcc();
     MoveGhost(); 
     #pragma omp parallel for schedule (static) private(du) num_threads(Nproc)
@@ -258,6 +260,7 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
       du = (Particles[i]->v + Particles[i]->VXSPH)*deltat + 0.5 * Particles[i]->a *deltat*deltat;
       Particles[i]->Displacement += du;
       Particles[i]->x += du;
+      StoreSOA(i, SOA_POS);
     }
     mov_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;  
     
@@ -270,11 +273,12 @@ inline void Domain::SolveDiffUpdateFraser (double tf, double dt, double dtOut, c
     #pragma omp parallel for schedule (static) num_threads(Nproc)
     for (size_t i=0; i<Particles.Size(); i++){
       Particles[i]->v += Particles[i]->a * deltat;
+      StoreSOA(i, SOA_VEL);
     }
     //CorrectVelAcc();
     MoveGhost();   
     
-    GeneralAfter(*this);//Reinforce BC vel   
+    CallGeneral(GeneralAfter);//Reinforce BC vel   
     mov_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;  
 
     #pragma omp parallel for schedule (static) num_threads(Nproc)
@@ -193,7 +193,7 @@ inline void Domain::SolveDiffUpdateKickDrift (double tf, double dt, double dtOut
 			}		
 		//std::cout << "neighbour_time (chrono, clock): " << clock_time_spent << ", " << neighbour_time.count()<<std::endl;
 		
-		GeneralBefore(*this);
+		CallGeneral(GeneralBefore);
 		PrimaryComputeAcceleration();
 
 		clock_beg = clock();
@@ -205,10 +205,13 @@ inline void Domain::SolveDiffUpdateKickDrift (double tf, double dt, double dtOut
     if (nonlock_sum)AccelReduction();
     //#endif
 		acc_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;
-    GeneralAfter(*this); //Fix free accel
+    CallGeneral(GeneralAfter); //Fix free accel
     
     clock_beg = clock(); 
-    if (contact) CalcContactForcesWang();
+    if (contact) {
+      if (contact_alg==SDF) CalcContactForcesSDF();
+      else                  CalcContactForcesWang();
+    }
     contact_time_spent +=(double)(clock() - clock_beg) / CLOCKS_PER_SEC;
     //if (contact) CalcContactForces2();
     
@@ -225,10 +228,11 @@ inline void Domain::SolveDiffUpdateKickDrift (double tf, double dt, double dtOut
     for (int i=0; i<Particles.Size(); i++){
       //Particles[i]->v += Particles[i]->a*deltat/2.*factor; ////ORIGINAL ALL WITH SAME DELTAT
       Particles[i]->v += Particles[i]->a*0.5*prev_deltat*factor;
+      StoreSOA(i, SOA_VEL);
       //Particles[i]->LimitVel();
     }
     MoveGhost();   
-    GeneralAfter(*this);//Reinforce BC vel   
+    CallGeneral(GeneralAfter);//Reinforce BC vel   
     mov_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;  
 
     
@@ -244,6 +248,7 @@ inline void Domain::SolveDiffUpdateKickDrift (double tf, double dt, double dtOut
     for (int i=0; i<Particles.Size(); i++){
       //Particles[i]->UpdateDensity_Leapfrog(deltat);
       Particles[i]->Density += deltat*Particles[i]->dDensity*factor;
+      StoreSOA(i, SOA_DENS);
     }    
     dens_time_spent+=(double)(clock() - clock_beg) / CLOCKS_PER_SEC;
     //BEFORE
@@ -256,15 +261,17 @@ inline void Domain::SolveDiffUpdateKickDrift (double tf, double dt, double dtOut
       du = (Particles[i]->v + Particles[i]->VXSPH)*deltat*factor;
       Particles[i]->Displacement += du;
       Particles[i]->x += du;
+      StoreSOA(i, SOA_POS);
     }
 
     #pragma omp parallel for schedule (static) num_threads(Nproc)
     for (int i=0; i<Particles.Size(); i++){
       Particles[i]->v += Particles[i]->a*deltat/2.*factor;
+      StoreSOA(i, SOA_VEL);
       //Particles[i]->LimitVel();
     }
     MoveGhost();
-    GeneralAfter(*this);
+    CallGeneral(GeneralAfter);
     mov_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;  
     
 		clock_beg = clock();
@@ -276,6 +283,7 @@ inline void Domain::SolveDiffUpdateKickDrift (double tf, double dt, double dtOut
     for (int i=0; i<Particles.Size(); i++){
       //Particles[i]->Mat2Leapfrog(deltat); //Uses density  
       Particles[i]->CalcStressStrain(deltat); //Uses density  
+      StoreSOA(i, SOA_STRESS);
     } 
     stress_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;
 
@@ -309,6 +317,7 @@ inline void Domain::SolveDiffUpdateKickDrift (double tf, double dt, double dtOut
       }
       //cout << "Updating contact particles"<<endl;
       UpdateContactParticles(); //Updates normal and velocities
+      if (bvh_contact) ContactBVHSearch(); //Cheap enough to follow the meshes every step
 		}
     contact_time_spent +=(double)(clock() - clock_beg) / CLOCKS_PER_SEC;
 		
@@ -396,6 +405,7 @@ inline void Domain::SolveDiffUpdateKickDrift (double tf, double dt, double dtOut
 	of.close(); //History 
   ofprop.close(); //Scalar prop
 	
+	FlushOutput(); //Pending asynchronous output
 	std::cout << "\n--------------Solving is finished---------------------------------------------------" << std::endl;
 
 }
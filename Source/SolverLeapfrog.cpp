@@ -45,6 +45,10 @@ inline void Domain::SolveDiffUpdateLeapFrog (double tf, double dt, double dtOut,
   
   cout << "Initial Checks"<<endl;
 	InitialChecks();
+  if (nb_skin > 0. && model_damage){
+    cout << "WARNING: Verlet list (skin) neighbour search is not working with damage. Skin set to zero." <<endl;
+    nb_skin = 0.;
+  }
    cout << "Cell  Inits"<<endl;
 	CellInitiate();
    cout << "List  Inits"<<endl;
@@ -93,7 +97,8 @@ inline void Domain::SolveDiffUpdateLeapFrog (double tf, double dt, double dtOut,
 		cout << "dS, psi_cont, Contact Stiffness" << dS << ", " 
     << Particles[0]->Cs * Particles [0] ->Mass / dS << ", " << Particles [0] -> cont_stiff <<endl;
 		min_force_ts = deltat;
-		MainNeighbourSearch();
+		if (nb_skin > 0.) VerletNbUpdate(); //Pairs filtered with actual radius
+		else              MainNeighbourSearch();
     //CalcPairPosList();          //Only for h update
     //UpdateSmoothingLength();
 		SaveNeighbourData();				//Necesary to calulate surface! Using Particle->Nb (count), could be included in search
@@ -157,7 +162,7 @@ inline void Domain::SolveDiffUpdateLeapFrog (double tf, double dt, double dtOut,
     else 
       check_nb_every_time = false;
 		
-		if (!model_damage) {
+		if (!model_damage && nb_skin == 0.) {
 		if (max > MIN_PS_FOR_NBSEARCH && !isyielding){ //First time yielding, data has not been cleared from first search
 			ClearNbData(); 
 			MainNeighbourSearch/*_Ext*/();
@@ -170,7 +175,24 @@ inline void Domain::SolveDiffUpdateLeapFrog (double tf, double dt, double dtOut,
 		
 		if (model_damage && !isfirst) ts_i = 1; //NEVER SEARCH NBs
 		
-		if ( max > MIN_PS_FOR_NBSEARCH || isfirst || check_nb_every_time){	//TO MODIFY: CHANGE
+		if (nb_skin > 0.) { //Verlet list: searches only when particles moved more than skin allows
+      clock_beg = clock();
+      VerletNbUpdate();
+      CalcPairPosList();
+      if (h_update)
+        UpdateSmoothingLength();
+      SaveNeighbourData();
+      nb_time_spent+=(double)(clock() - clock_beg) / CLOCKS_PER_SEC;
+      
+      if (gradKernelCorr){
+        CalcGradCorrMatrix();	}
+        
+      if (contact) {
+        clock_beg = clock();
+        ContactNbUpdate(this);
+        contact_time_spent +=(double)(clock() - clock_beg) / CLOCKS_PER_SEC;
+      }
+    } else if ( max > MIN_PS_FOR_NBSEARCH || isfirst || check_nb_every_time){	//TO MODIFY: CHANGE
 			if ( ts_i == 0 ){
 
 				if (m_isNbDataCleared){
@@ -212,7 +234,7 @@ inline void Domain::SolveDiffUpdateLeapFrog (double tf, double dt, double dtOut,
 				
 			}		
 		//std::cout << "neighbour_time (chrono, clock): " << clock_time_spent << ", " << neighbour_time.count()<<std::endl;
-		GeneralBefore(*this);
+		CallGeneral(GeneralBefore);
 		PrimaryComputeAcceleration();
 
 		clock_beg = clock();
@@ -225,7 +247,7 @@ inline void Domain::SolveDiffUpdateLeapFrog (double tf, double dt, double dtOut,
     if (nonlock_sum)AccelReduction();
     //#endif
 		acc_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;
-    GeneralAfter(*this); //Fix free accel
+    CallGeneral(GeneralAfter); //Fix free accel
 
 
     /////// TODO:MOVE TO THE END
@@ -235,6 +257,7 @@ inline void Domain::SolveDiffUpdateLeapFrog (double tf, double dt, double dtOut,
       if      (contact_alg==Fraser)   CalcContactForces();
       if      (contact_alg==Wang)     CalcContactForcesWang();
       else if (contact_alg==Seo )     CalcContactForces2();
+      else if (contact_alg==SDF )     CalcContactForcesSDF();
       else if (contact_alg==LSDyna )  CalcContactForcesLS();
     }
     contact_time_spent +=(double)(clock() - clock_beg) / CLOCKS_PER_SEC;
@@ -247,11 +270,13 @@ inline void Domain::SolveDiffUpdateLeapFrog (double tf, double dt, double dtOut,
         // Particles[i]->a += Particles[i]->contforce / Particles[i] -> Mass;
     
     if (isfirst) {
-      for (int i=0; i<Particles.Size(); i++)
+      for (int i=0; i<Particles.Size(); i++){
         Particles[i]->v -= Particles[i]->a*0.5*deltat;
+        StoreSOA(i, SOA_VEL);
+      }
     }
     MoveGhost();   
-    GeneralAfter(*this);//Reinforce BC vel   
+    CallGeneral(GeneralAfter);//Reinforce BC vel   
     mov_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;  
     
     prev_deltat=deltat;
@@ -267,10 +292,11 @@ inline void Domain::SolveDiffUpdateLeapFrog (double tf, double dt, double dtOut,
     for (int i=0; i<Particles.Size(); i++){
       //Particles[i]->v += Particles[i]->a*deltat/2.*factor; ////ORIGINAL ALL WITH SAME DELTAT
       Particles[i]->v += Particles[i]->a*0.5*(prev_deltat+deltat);
+      StoreSOA(i, SOA_VEL);
       //Particles[i]->LimitVel();
     }
     MoveGhost();   
-    GeneralAfter(*this);//Reinforce BC vel   
+    CallGeneral(GeneralAfter);//Reinforce BC vel   
     mov_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;  
 
     
@@ -286,6 +312,7 @@ inline void Domain::SolveDiffUpdateLeapFrog (double tf, double dt, double dtOut,
     for (int i=0; i<Particles.Size(); i++){
       //Particles[i]->UpdateDensity_Leapfrog(deltat);
       Particles[i]->Density += deltat*Particles[i]->dDensity;
+      StoreSOA(i, SOA_DENS);
     }    
     dens_time_spent+=(double)(clock() - clock_beg) / CLOCKS_PER_SEC;
     //BEFORE
@@ -298,6 +325,7 @@ inline void Domain::SolveDiffUpdateLeapFrog (double tf, double dt, double dtOut,
       du = (Particles[i]->v + Particles[i]->VXSPH)*deltat;
       Particles[i]->Displacement += du;
       Particles[i]->x += du;
+      StoreSOA(i, SOA_POS);
     }
 
 		clock_beg = clock();
@@ -309,6 +337,7 @@ inline void Domain::SolveDiffUpdateLeapFrog (double tf, double dt, double dtOut,
     for (int i=0; i<Particles.Size(); i++){
       //Particles[i]->Mat2Leapfrog(deltat); //Uses density  
       Particles[i]->CalcStressStrain(deltat); //Uses density  
+      StoreSOA(i, SOA_STRESS);
     } 
     stress_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;
 
@@ -341,10 +370,11 @@ inline void Domain::SolveDiffUpdateLeapFrog (double tf, double dt, double dtOut,
       }
       //cout << "Updating contact particles"<<endl;
       UpdateContactParticles(); //Updates normal and velocities
+      if (bvh_contact) ContactBVHSearch(); //Cheap enough to follow the meshes every step
 		}
     contact_time_spent +=(double)(clock() - clock_beg) / CLOCKS_PER_SEC;
 		
-		if (max>MIN_PS_FOR_NBSEARCH){	//TODO: CHANGE TO FIND NEIGHBOURS
+		if (max>MIN_PS_FOR_NBSEARCH && nb_skin == 0.){	//TODO: CHANGE TO FIND NEIGHBOURS
 			if ( ts_i == (ts_nb_inc - 1) ){
 				ClearNbData();
 			}
@@ -446,6 +476,7 @@ inline void Domain::SolveDiffUpdateLeapFrog (double tf, double dt, double dtOut,
 	of.close(); //History 
   ofprop.close(); //Scalar prop
 	
+	FlushOutput(); //Pending asynchronous output
 	std::cout << "\n--------------Solving is finished---------------------------------------------------" << std::endl;
 
 }
@@ -175,7 +175,7 @@ inline void Domain::SolveDiffUpdateVerlet (double tf, double dt, double dtOut, c
 			}		
 		//std::cout << "neighbour_time (chrono, clock): " << clock_time_spent << ", " << neighbour_time.count()<<std::endl;
 		
-		GeneralBefore(*this);
+		CallGeneral(GeneralBefore);
 		PrimaryComputeAcceleration();
 
     clock_beg = clock();  
@@ -187,6 +187,7 @@ inline void Domain::SolveDiffUpdateVerlet (double tf, double dt, double dtOut, c
       du = (Particles[i]->v + Particles[i]->VXSPH)*deltat + 0.5 * prev_acc[i]*deltat*deltat;
       Particles[i]->Displacement += du;
       Particles[i]->x += du;
+      StoreSOA(i, SOA_POS);
     }
     mov_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;  
     
@@ -199,7 +200,7 @@ inline void Domain::SolveDiffUpdateVerlet (double tf, double dt, double dtOut, c
     AccelReduction();
     #endif
 		acc_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;
-    GeneralAfter(*this); //Fix free accel
+    CallGeneral(GeneralAfter); //Fix free accel
     
     clock_beg = clock(); 
     if (contact) CalcContactForcesWang();
@@ -213,9 +214,10 @@ inline void Domain::SolveDiffUpdateVerlet (double tf, double dt, double dtOut, c
     #pragma omp parallel for schedule (static) num_threads(Nproc)
     for (size_t i=0; i<Particles.Size(); i++){
       Particles[i]->v += (Particles[i]->a + prev_acc[i])/2.0 * deltat;
+      StoreSOA(i, SOA_VEL);
     }
     MoveGhost();   
-    GeneralAfter(*this);//Reinforce BC vel   
+    CallGeneral(GeneralAfter);//Reinforce BC vel   
     mov_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;  
 
     #pragma omp parallel for schedule (static) num_threads(Nproc)
@@ -229,6 +231,7 @@ inline void Domain::SolveDiffUpdateVerlet (double tf, double dt, double dtOut, c
     for (size_t i=0; i<Particles.Size(); i++){
       //Particles[i]->UpdateDensity_Leapfrog(deltat);
       Particles[i]->Density += deltat*Particles[i]->dDensity*factor;
+      StoreSOA(i, SOA_DENS);
     }    
     dens_time_spent+=(double)(clock() - clock_beg) / CLOCKS_PER_SEC;
     
@@ -241,6 +244,7 @@ inline void Domain::SolveDiffUpdateVerlet (double tf, double dt, double dtOut, c
     for (size_t i=0; i<Particles.Size(); i++){
       //Particles[i]->Mat2Leapfrog(deltat); //Uses density  
       Particles[i]->CalcStressStrain(deltat); //Uses density  
+      StoreSOA(i, SOA_STRESS);
     } 
     stress_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;
 
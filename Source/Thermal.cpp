@@ -56,12 +56,13 @@ inline void Domain::CalcTempInc () {
 	std::vector < double> temp(Particles.Size());
 	
   std::vector < double> axiterm(Particles.Size());
+  bool pc = UsePairCache();
   
 	#pragma omp parallel for schedule (static) num_threads(Nproc) //LUCIANO: THIS IS DONE SAME AS PrimaryComputeAcceleration
 	for ( int k = 0; k < Nproc ; k++) {
 		Particle *P1,*P2;
 		Vec3_t xij;
-		double h,GK;
+		double h,GK,rij,K;
 		//TODO: DO THE LOCK PARALLEL THING
 		// Summing the smoothed pressure, velocity and stress for fixed particles from neighbour particles
 		//std::vector <double> temp()=0;
@@ -71,9 +72,12 @@ inline void Domain::CalcTempInc () {
 			//cout << "a: " << a << "p1: " << SMPairs[k][a].first << ", p2: "<< SMPairs[k][a].second<<endl;
 			P1	= Particles[SMPairs[k][a].first];
 			P2	= Particles[SMPairs[k][a].second];
+			if (pc) GetPairGeom(k, a, false, xij, rij, h, GK, K);
+			else {
 			xij	= P1->x - P2->x;
 			h	= (P1->h+P2->h)/2.0;
-			GK	= GradKernel(Dimension, KernelType, norm(xij)/h, h);	
+			GK	= m_kernel.gradW(norm(xij)/h, h);	
+			}
 			
 			
 			di = P1->Density; mi = P1->Mass;
@@ -222,13 +226,14 @@ inline void Domain::CalcTempIncSOA () {
 	double di=0.0,dj=0.0,mi=0.0,mj=0.0;
 	
 	std::vector < double> temp(Particles.Size());
+	bool pc = UsePairCache();
 	
 	//cout << "calc temp inc"<<endl;
 	#pragma omp parallel for schedule (static) num_threads(Nproc) //LUCIANO: THIS IS DONE SAME AS PrimaryComputeAcceleration
 	for ( int k = 0; k < Nproc ; k++) {
 		int P1,P2;
 		Vec3_t xij;
-		double h,GK;
+		double h,GK,rij,K;
 		//TODO: DO THE LOCK PARALLEL THING
 		// Summing the smoothed pressure, velocity and stress for fixed particles from neighbour particles
 		//std::vector <double> temp()=0;
@@ -238,9 +243,12 @@ inline void Domain::CalcTempIncSOA () {
 			//cout << "a: " << a << "p1: " << SMPairs[k][a].first << ", p2: "<< SMPairs[k][a].second<<endl;
 			P1	= SMPairs[k][a].first;
 			P2	= SMPairs[k][a].second;
-			xij	= *m_x[P1] - (*m_x[P2]);
+			if (pc) GetPairGeom(k, a, false, xij, rij, h, GK, K);
+			else {
+			xij	= Particles[P1]->x - Particles[P2]->x;
 			h	= (*m_h[P1] + (*m_h[P2]))/2.0;
-			GK	= GradKernel(Dimension, KernelType, norm(xij)/h, h);	
+			GK	= m_kernel.gradW(norm(xij)/h, h);	
+			}
 			
 			
 			di = *m_rho[P1]; mi = *m_mass[P1];
@@ -671,7 +679,7 @@ inline void Domain::ThermalSolve (double tf, double dt, double dtOut, char const
 		// std::cout << "Max temp: "<< max << std::endl;
     
 		acc_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;
-		GeneralAfter(*this);
+		CallGeneral(GeneralAfter);
 		// output
 		if (Time>=tout){
 			if (TheFileKey!=NULL) {
@@ -713,6 +721,7 @@ inline void Domain::ThermalSolve (double tf, double dt, double dtOut, char const
 	}
 	
 
+	FlushOutput(); //Pending asynchronous output
 	std::cout << "\n--------------Solving is finished---------------------------------------------------" << std::endl;
 
 }
@@ -842,6 +851,7 @@ inline void Domain::ThermalSolve_wo_init (double tf, double dt, double dtOut, ch
 	}
 	
 
+	FlushOutput(); //Pending asynchronous output
 	std::cout << "\n--------------Solving is finished---------------------------------------------------" << std::endl;
 
 }
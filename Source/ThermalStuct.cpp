@@ -130,7 +130,7 @@ inline void Domain::ThermalStructSolve (double tf, double dt, double dtOut, char
 		auto end_task = std::chrono::system_clock::now();
 		 neighbour_time = /*std::chrono::duration_cast<std::chrono::seconds>*/ (end_task- start_task);
 
-		GeneralBefore(*this);
+		CallGeneral(GeneralBefore);
 		clock_beg = clock();
 		PrimaryComputeAcceleration();
 		pr_acc_time_spent += (double)(clock() - clock_beg) / CLOCKS_PER_SEC;
@@ -143,7 +143,7 @@ inline void Domain::ThermalStructSolve (double tf, double dt, double dtOut, char
 		CalcTempInc();
 		CalcThermalExpStrainRate();	//Add Thermal expansion Strain Rate Term		
 		
-		GeneralAfter(*this);
+		CallGeneral(GeneralAfter);
 
 		if (auto_ts)
 			AdaptiveTimeStep();
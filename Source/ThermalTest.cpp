@@ -16,7 +16,7 @@ inline double Domain::CalcTempIncPair (Particle *P1, Particle *P2) {
 
   xij	= P1->x - P2->x;
   double h	= (P1->h+P2->h)/2.0;
-  double GK	= GradKernel(Dimension, KernelType, norm(xij)/h, h);	    
+  double GK	= m_kernel.gradW(norm(xij)/h, h);	    
   
   di = P1->Density; mi = P1->Mass;
   dj = P2->Density; mj = P2->Mass;
@@ -37,11 +37,11 @@ inline void Domain::CalcTempIncPP() {
     P1	= Particles[i]; 
     k = 1./(P1->Density * P1->cp_T);
     for (int n=0;n<ipair_SM[i];n++){      
-      P2 = Particles[Anei[i][n]];
+      P2 = Particles[Anei[Anei_start[i]+n]];
       P1->dTdt += CalcTempIncPair(P1,P2);
     }
     for (int n=0;n<jpair_SM[i];n++) {
-      P2 = Particles[Anei[i][MAX_NB_PER_PART-1-n]];
+      P2 = Particles[Anei[Anei_start[i]+ipair_SM[i]+n]];
       P1->dTdt += CalcTempIncPair(P1,P2);
     }
     P1->dTdt *= k; 
@@ -0,0 +1,71 @@
+#ifndef SPH_THREAD_ACCUM_H
+#define SPH_THREAD_ACCUM_H
+
+#include <vector>
+#include "matvec.h"
+
+namespace SPH {
+
+//////////////////////////////////////////////////////////////////////////////
+// Per thread scatter buffers for the lock free pair sum. Each thread adds   //
+// its pair contributions to its own copy of the accumulators and they are  //
+// then reduced over threads in a parallel loop over particles. Unlike the  //
+// table (Nishimura) reduction it works with every option: gradient         //
+// correction, damage, axisymmetry, XSPH and Shepard.                       //
+// Only the fields of the pass are allocated. Buffers are zero when they    //
+// are allocated and the reduction zeroes every entry it consumes, so no    //
+// thread has to clear its whole buffer before the pair loop.               //
+//////////////////////////////////////////////////////////////////////////////
+enum ThreadAccum_Field {
+  TA_ACCEL   = 1,
+  TA_DENSINC = 2,
+  TA_RATES   = 4,   //Strain and rotation rate
+  TA_VXSPH   = 8,
+  TA_ZWAB    = 16,
+  TA_SUMDEN  = 32,
+  TA_ALL     = 63
+};
+
+struct ThreadAccum {
+  std::vector <Vec3_t>  a, vxsph;
+  std::vector <double>  drho, zwab, sumden;
+  std::vector <Sym3_t>  strrate;
+  std::vector <Skew3_t> rotrate;
+
+  //Grows the buffers of the fields in the mask, new entries are zero
+  inline void Resize(const size_t &np, const int &fields){
+    if ((fields & TA_ACCEL)   && a.size()       < np) a.resize      (np, Vec3_t(0.,0.,0.));
+    if ((fields & TA_DENSINC) && drho.size()    < np) drho.resize   (np, 0.);
+    if ((fields & TA_RATES)   && strrate.size() < np) {
+      strrate.resize(np, Sym3_t(0.));
+      rotrate.resize(np, Skew3_t(0.));
+    }
+    if ((fields & TA_VXSPH)   && vxsph.size()   < np) vxsph.resize  (np, Vec3_t(0.,0.,0.));
+    if ((fields & TA_ZWAB)    && zwab.size()    < np) zwab.resize   (np, 0.);
+    if ((fields & TA_SUMDEN)  && sumden.size()  < np) sumden.resize (np, 0.);
+  }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Per thread contact totals. Contact loops add to the accumulator of their //
+// thread (or of their ContPairs list) instead of taking dom_lock for every //
+// contacting pair; MergeContactAccum sums them into the Domain totals.     //
+//////////////////////////////////////////////////////////////////////////////
+struct ContactAccum {
+  double force_sum, reaction_sum, work;
+  double min_ts;                        //Min positive contact force time step
+  std::vector <Vec3_t> mesh_force;      //Per mesh
+  std::vector <double> heat_cond;       //Per mesh
+
+  inline void Zero(const int &meshcount){
+    force_sum = reaction_sum = work = 0.;
+    min_ts = 1000.;
+    mesh_force.assign(meshcount, Vec3_t(0.,0.,0.));
+    heat_cond.assign(meshcount, 0.);
+  }
+  inline void MinTS(const double &dt){ if (dt > 0. && dt < min_ts) min_ts = dt; }
+};
+
+}; // namespace SPH
+
+#endif // SPH_THREAD_ACCUM_H
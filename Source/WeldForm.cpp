@@ -367,6 +367,22 @@ int main(int argc, char **argv) try {
     bool h_upd = false;
     double tensins = 0.3;
     int nb_upd_freq = 5;
+    double nb_skin = 0.;  //Verlet list skin radius
+    int reorder_freq = 0; //Morton reordering, every this nb searches
+    bool soa_kernels = false; //Structure of arrays pair kernels
+    bool lockfree_sum = false; //Per thread pair sum buffers instead of locks
+    bool gather_kernels = false; //Per particle pair kernels (full neighbour list)
+    int kernel_table = 0; //Kernel lookup table resolution (points per unit q), 0 is off
+    bool pair_cache = false; //Pair geometry cache shared by pair passes
+    bool simd_kernels = false; //Batched SIMD acceleration kernel (runtime CPU dispatch)
+    bool fused_kernels = false; //Density and rate tensors in one pair pass (Nishimura reduction)
+    bool colored_sum = false; //Pair passes in color sweeps, no particle locks
+    bool numa_first_touch = false; //Particles copied by the threads that use them
+    string thread_affinity = ""; //"compact" or "spread" (Linux)
+    bool async_output = false; //Output files written by a separate thread
+    bool bvh_contact = false; //Contact search over mesh element hierarchies
+    bool rigid_mesh_frame = false; //Meshes kept in body frame, only the rigid transform is updated
+    double sdf_cell = 0.; //SDF contact grid spacing (0: half the minimum h)
     bool kernel_grad_corr = false;
     int gradType = 0;
     readValue(config["artifViscAlpha"],alpha);
@@ -376,6 +392,22 @@ int main(int argc, char **argv) try {
     readValue(config["stressGradType"],gradType);
     readValue(config["smoothlenUpdate"],h_upd);
     readValue(config["nbsearchFreq"],nb_upd_freq);
+    readValue(config["nbSkin"],nb_skin);
+    readValue(config["reorderFreq"],reorder_freq);
+    readValue(config["soaKernels"],soa_kernels);
+    readValue(config["lockFreeSum"],lockfree_sum);
+    readValue(config["gatherKernels"],gather_kernels);
+    readValue(config["kernelTable"],kernel_table);
+    readValue(config["pairCache"],pair_cache);
+    readValue(config["fusedKernels"],fused_kernels);
+    readValue(config["simdKernels"],simd_kernels);
+    readValue(config["coloredSum"],colored_sum);
+    readValue(config["numaFirstTouch"],numa_first_touch);
+    readValue(config["threadAffinity"],thread_affinity);
+    readValue(config["asyncOutput"],async_output);
+    readValue(config["bvhContact"],bvh_contact);
+    readValue(config["rigidMeshFrame"],rigid_mesh_frame);
+    readValue(config["sdfCell"],sdf_cell);
     dom.auto_ts = auto_ts[0];
     dom.auto_ts_acc = auto_ts[1];
     dom.auto_ts_cont = auto_ts[2];
@@ -690,6 +722,15 @@ int main(int argc, char **argv) try {
         
         readValue(contact_[0]["penaltyFactor"], 	penaltyfac); 
         
+        double sdf_radius = 0.; //Analytic cylinder distance field (SDF contact), initial position
+        readValue(rigbodies[rb]["sdfCylinderRadius"], sdf_radius);
+        if (sdf_radius > 0. && cont_alg == "SDF") { //Sets the mesh body frame
+          Vec3_t sdf_center = start, sdf_axis(0.,0.,1.);
+          readVector(rigbodies[rb]["sdfCylinderCenter"], sdf_center);
+          readVector(rigbodies[rb]["sdfCylinderAxis"],   sdf_axis);
+          dom.SetContactSDFCylinder(mesh_count, sdf_center, sdf_axis, sdf_radius);
+        }
+        
         mesh_count ++;
 
         // readValue(rigbodies[0]["contAlgorithm"],cont_alg);
@@ -700,6 +741,9 @@ int main(int argc, char **argv) try {
         } else if (cont_alg == "LSDyna") {
           dom.contact_alg = LSDyna;
           cout << "LS_Dyna"<<endl;
+        } else if (cont_alg == "SDF") {
+          dom.contact_alg = SDF;
+          cout << "SDF (rigid body frame, tool distance fields)"<<endl;
         } else if (cont_alg == "Fraser") { /////FRASER NOT WORKING
           // dom.contact_alg = Fraser;
           cout << "Wang. ATTENTION: Fraser  algorithm does not working"<<endl;
@@ -880,6 +924,48 @@ int main(int argc, char **argv) try {
     //Generate Domain
     dom.gradKernelCorr = kernel_grad_corr;
     dom.ts_nb_inc = nb_upd_freq;
+    dom.nb_skin = nb_skin;
+    if (nb_skin > 0.)
+      cout << "Verlet list neighbour search, skin radius: "<<nb_skin<<endl;
+    dom.reorder_nb_inc = reorder_freq;
+    if (reorder_freq > 0)
+      cout << "Particles reordered (Morton) every "<<reorder_freq<< " neighbour searches"<<endl;
+    dom.soa_kernels = soa_kernels;
+    dom.lockfree_sum = lockfree_sum;
+    if (lockfree_sum)
+      cout << "Lock free pair sum (per thread buffers)"<<endl;
+    dom.gather_kernels = gather_kernels;
+    if (gather_kernels)
+      cout << "Gather (per particle) pair kernels"<<endl;
+    dom.kernel_table_res = kernel_table;
+    if (kernel_table > 0)
+      cout << "Kernel lookup table, "<<kernel_table<< " points per unit q"<<endl;
+    dom.pair_cache = pair_cache;
+    if (pair_cache)
+      cout << "Pair geometry cache"<<endl;
+    dom.simd_kernels = simd_kernels;
+    dom.fused_kernels = fused_kernels;
+    if (fused_kernels)
+      cout << "Fused density and rate tensors pair pass (Fraser solver, reduction sum)"<<endl;
+    dom.colored_sum = colored_sum;
+    if (colored_sum)
+      cout << "Colored pair sweeps (locks only if not colored)"<<endl;
+    dom.numa_first_touch = numa_first_touch;
+    if (numa_first_touch)
+      cout << "NUMA first touch particle placement"<<endl;
+    dom.thread_affinity = thread_affinity;
+    dom.async_output = async_output;
+    if (async_output)
+      cout << "Asynchronous output (HDF5, XMF and CSV written by the output thread)"<<endl;
+    dom.bvh_contact = bvh_contact;
+    dom.sdf_cell = sdf_cell;
+    if (bvh_contact)
+      cout << "BVH contact search (contact particles out of the cell grid)"<<endl;
+    if (rigid_mesh_frame) {
+      for (int m=0;m<dom.trimesh.size();m++)
+        if (!dom.trimesh[m]->rigid_frame) dom.trimesh[m]->SetRigidFrame(); //SDF cylinders already set it
+      cout << "Rigid body frame meshes"<<(bvh_contact ? "" : " (all elements updated each step without bvhContact)")<<endl;
+    }
     
     if (dom.Particles.Size()>0){
     for (size_t a=0; a<dom.Particles.Size(); a++){
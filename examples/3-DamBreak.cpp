@@ -95,7 +95,7 @@ int main(int argc, char **argv) try
     if (dom.Particles[a]->ID==1)
     {
       dom.Particles[a]->Density	  = Rho*pow((1+7.0*g*(H-yb)/(Cs*Cs)),(1.0/7.0));
-      dom.Particles[a]->Densityb	= Rho*pow((1+7.0*g*(H-yb)/(Cs*Cs)),(1.0/7.0));
+      dom.Particles[a]->VerletHist().Densityb	= Rho*pow((1+7.0*g*(H-yb)/(Cs*Cs)),(1.0/7.0));
     }
 
   }
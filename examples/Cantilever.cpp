@@ -129,7 +129,7 @@ int main(int argc, char **argv) try
     		if ( y >= (Ly/2. - dx ) && x >= (Lx/2. -Lx/40.) )
     			dom.Particles[a]->ID=3;
     	}
-      		dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
+      		dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType	
       dom.auto_ts=false; 
 //		dom.WriteXDMF("maz");
 //		dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
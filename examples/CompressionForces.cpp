@@ -153,7 +153,7 @@ int main(int argc, char **argv) try
     	}
 			cout << "Contact Force Particles: "<<forcepart_count<<endl;
 		dom.WriteXDMF("maz");
-		dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
+		dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType	
 		dom.BC.InOutFlow = 0;
 
     //dom.Solve_orig_Ext(/*tf*/0.00205,/*dt*/timestep,/*dtOut*/0.001,"test06",999);
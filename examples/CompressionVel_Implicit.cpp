@@ -157,7 +157,7 @@ int main(int argc, char **argv) try
     	}
 			cout << "Contact Force Particles: "<<forcepart_count<<endl;
 		dom.WriteXDMF("maz");
-		dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
+		dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType	
 		dom.BC.InOutFlow = 0;
 
     //dom.Solve_orig_Ext(/*tf*/0.00205,/*dt*/timestep,/*dtOut*/0.001,"test06",999);
@@ -171,7 +171,7 @@ int main(int argc, char **argv) try
     cout << "particle b mat"<<endl;
     for (size_t i=0; i<dom.Particles.Size(); i++)	//Like in Domain::Move
     {
-      cout << dom.Particles[i]->m_B(5,2)<<endl;
+      cout << dom.Particles[i]->BMat()(5,2)<<endl;
     }
     
 		return 0;
@@ -141,7 +141,7 @@ int main(int argc, char **argv) try
     			dom.Particles[a]->ID=3;
     	}
 		dom.WriteXDMF("maz");
-		dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
+		dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType	
 		dom.BC.InOutFlow = 0;
 		
 		dom.auto_ts = false;
@@ -133,7 +133,7 @@ int main() try{
     
 	}
   	
-	dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
+	dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType	
 	dom.BC.InOutFlow = 0;
   dom.auto_ts = false;
 
@@ -148,7 +148,7 @@ int main() try{
 	}
   cout << top<< " Top particles, "<<bottom << " bottom particles"<<endl; 
   	
-	dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
+	dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType	
 	dom.BC.InOutFlow = 0;
   dom.auto_ts = false;
   //timestep=1.e-8;
@@ -208,7 +208,7 @@ int main(int argc, char **argv) try
 
       }
 		dom.WriteXDMF("maz");
-		dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
+		dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType	
 		dom.BC.InOutFlow = 0;
     // timestep = (1.0*h/(Cs+VMAX)); 
     // dom.CFL = 1.0;
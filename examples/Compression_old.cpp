@@ -143,7 +143,7 @@ int main(int argc, char **argv) try
 			}
     	}
 		dom.WriteXDMF("maz");
-		dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
+		dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType	
 		dom.BC.InOutFlow = 0;
 
     	dom.Solve(/*tf*/0.001005,/*dt*/timestep,/*dtOut*/0.001,"test06",999);
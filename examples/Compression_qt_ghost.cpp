@@ -210,7 +210,7 @@ int main(int argc, char **argv) try
 
       }
 		dom.WriteXDMF("maz");
-		dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
+		dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType	
 		dom.BC.InOutFlow = 0;
 
   timestep = (0.4*h/(Cs+VMAX)); //Standard modified Verlet do not accept such step
@@ -158,7 +158,7 @@ int main(int argc, char **argv) try
     			// dom.Particles[a]->NoSlip=true;
     	}
 		dom.WriteXDMF("maz");
-		dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
+		dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType	
 		dom.BC.InOutFlow = 0;
 
     	dom.Solve(/*tf*/0.00501,/*dt*/timestep,/*dtOut*/0.001,"test06",999);
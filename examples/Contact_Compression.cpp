@@ -193,7 +193,7 @@ int main(){
   dom.fric_type = Fr_Dyn;
 
 	
-	dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
+	dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType	
 	dom.BC.InOutFlow = 0;
 
 
@@ -156,7 +156,7 @@ int main(){
 	dom.PFAC = 0.8;
 	dom.DFAC = 0.2;
 	
-	dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
+	dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType	
 	dom.BC.InOutFlow = 0;
 
 	
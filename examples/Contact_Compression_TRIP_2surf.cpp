@@ -244,7 +244,7 @@ int main() try{
   cout << top<< " Top particles, "<<bottom << " side1 particles, "<<center << " side 2 particles" <<endl; 
   cout << "center bottom: " << center_bottom << ", center top: "<<center_top<<endl;
   	
-	dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
+	dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType	
 	dom.BC.InOutFlow = 0;
   dom.auto_ts = false;
   //timestep=1.e-8;
@@ -147,7 +147,7 @@ int main(){
 	dom.DFAC = 0.2;
 	dom.update_contact_surface = false;
 	
-	dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
+	dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType	
 	dom.BC.InOutFlow = 0;
 
 	
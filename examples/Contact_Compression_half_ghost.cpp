@@ -215,7 +215,7 @@ int main(int argc, char **argv) try
 	dom.update_contact_surface = false;
 
   dom.WriteXDMF("maz");
-  dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
+  dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType	
   dom.BC.InOutFlow = 0;
 
 	//ALWAYS AFTER SPH PARTICLES
@@ -150,7 +150,7 @@ int main(){
 	dom.PFAC = 0.5;
 	dom.DFAC = 0.0;
 	
-	dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
+	dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType	
 	dom.BC.InOutFlow = 0;
 
 	
@@ -144,7 +144,7 @@ int main(int argc, char **argv) try
 
       cout << "Conv  count "<<bottom_count<<endl;
 		dom.WriteXDMF("maz");
-		dom.m_kernel = SPH::iKernel(dom.Dimension,h);	
+		dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType	
 		dom.BC.InOutFlow = 0;
 
     of = std::ofstream ("cf.csv", std::ios::out);
@@ -81,14 +81,8 @@ inline void MyListGenerate (SPH::Domain *dom)
 							else std::cout<<"Leaving i>=CellNo"<<std::endl;
 			}
       cout << "cell "<<i<<", part"<<a<<endl;
-			temp = dom->HOC[i][0][0];
-			dom->HOC[i][0][0] = a;
-			dom->Particles[a]->LL = temp;
-			dom->Particles[a]->CC[0] = i;
-			dom->Particles[a]->CC[1] = 0;
-			dom->Particles[a]->CC[2] = 0;
-			if (!dom->Particles[a]->IsFree) dom->FixedParticles.Push(a);
     }
+    dom->ListGenerate(); //Cell sort
 }
 
 int main(int argc, char **argv) try
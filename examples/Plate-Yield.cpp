@@ -142,7 +142,7 @@ int main(int argc, char **argv) try
 		
     cout << "left_part " <<left_part<<endl;
     cout << "right_part " <<right_part<<endl;
-		dom.m_kernel = SPH::iKernel(dom.Dimension,h);
+		dom.m_kernel.Set(dom.Dimension, 0);	//Reselected at InitialChecks from KernelType
 
 	
 //    	dom.WriteXDMF("maz");
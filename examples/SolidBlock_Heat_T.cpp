@@ -122,7 +122,7 @@ int main(int argc, char **argv) try
       for (int j=0;j<4;j++){
     for (int i=0;i<4;i++)
 
-          cout <<dom.HOC[i][j][k]<<", ";
+          cout <<dom.cell_count[dom.CellIdx(i,j,k)]<<", ";
         cout << endl;
       }
 //		dom.ThermalSolve(/*tf*/10.,/*dt*/timestep,/*dtOut*/0.1,"test06",999);
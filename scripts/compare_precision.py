@@ -0,0 +1,68 @@
+# Regression comparison of two WeldForm runs, e.g. double and single precision
+# (SINGLE_PRECISION) builds on the same input:
+#
+#   mkdir dbl sgl
+#   cd dbl && ../build_double/WeldForm ../examples/input/Compression_fast_short.json && cd ..
+#   cd sgl && ../build_single/WeldForm ../examples/input/Compression_fast_short.json && cd ..
+#   python compare_precision.py dbl sgl
+#
+# Compares every particle CSV output (Domain::WriteCSV) present in both 
+# directories, column by column, relative to the column maximum of the 
+# reference run. Prints max/RMS per field and returns 1 if any checked field
+# max exceeds the tolerance.
+
+import sys
+import os
+import glob
+
+CHECKED = ['X', 'Y', 'Z', 'Sigma_eq', 'Pl_Strain', 'vx', 'vy', 'vz', 'p']
+
+def read_csv(path):
+  with open(path, 'r') as f:
+    lines = f.readlines()
+  head = [c.strip() for c in lines[0].split(',')]
+  cols = {}
+  for h in head:
+    cols[h] = []
+  for line in lines[1:]:
+    vals = line.split(',')
+    if len(vals) < len(head):
+      continue
+    for h, v in zip(head, vals):
+      cols[h].append(float(v))
+  return cols
+
+def compare(ref, test):
+  diff = {}
+  for h in CHECKED:
+    if h not in ref or h not in test or len(ref[h]) != len(test[h]):
+      continue
+    scale = max([abs(v) for v in ref[h]] + [1.0e-30])
+    d = [abs(a - b) for a, b in zip(ref[h], test[h])]
+    rms = (sum([e * e for e in d]) / max(len(d), 1)) ** 0.5
+    diff[h] = (max(d + [0.0]) / scale, rms / scale)
+  return diff
+
+def main():
+  if len(sys.argv) < 3:
+    print('Usage: compare_precision.py <reference_dir> <test_dir> [tolerance]')
+    return 2
+  tol = float(sys.argv[3]) if len(sys.argv) > 3 else 1.0e-3
+  files = sorted(glob.glob(os.path.join(sys.argv[1], '*.csv')))
+  worst, worst_rms = 0.0, 0.0
+  for fr in files:
+    ft = os.path.join(sys.argv[2], os.path.basename(fr))
+    if not os.path.exists(ft):
+      continue
+    ref, test = read_csv(fr), read_csv(ft)
+    if 'X' not in ref:   #Not a particle output
+      continue
+    diff = compare(ref, test)
+    print(os.path.basename(fr) + ': ' + ', '.join(['%s %.3e/%.3e' % (h, diff[h][0], diff[h][1]) for h in CHECKED if h in diff]))
+    worst = max([worst] + [e[0] for e in diff.values()])
+    worst_rms = max([worst_rms] + [e[1] for e in diff.values()])
+  print('Max relative difference: %.3e, max RMS: %.3e (tolerance %.1e)' % (worst, worst_rms, tol))
+  return 1 if worst > tol else 0
+
+if __name__ == '__main__':
+  sys.exit(main())